@@ -0,0 +1,28 @@
+#ifndef YC_STUB_BUFFER_H_
+#define YC_STUB_BUFFER_H_
+
+// ========  HEADER FILE FOR THE MAX STUB: BUFFERS  ========
+// Named buffers of interleaved float samples. Locking the samples never waits: it fails while a read or a resize
+// changes them, and the change waits until the samples are unlocked. Every reference to a buffer is notified
+// with "buffer_modified" after a read or a resize.
+
+#include "ext.h"
+
+typedef t_object t_buffer_obj;
+typedef t_object t_buffer_ref;
+
+t_buffer_ref* buffer_ref_new        (t_object* owner, t_symbol* name);
+void          buffer_ref_set        (t_buffer_ref* ref, t_symbol* name);
+t_buffer_obj* buffer_ref_getobject  (t_buffer_ref* ref);
+t_max_err     buffer_ref_notify     (t_buffer_ref* ref, t_symbol* s, t_symbol* msg, void* sender, void* data);
+
+float*        buffer_locksamples    (t_buffer_obj* b);
+void          buffer_unlocksamples  (t_buffer_obj* b);
+void          buffer_setdirty       (t_buffer_obj* b);
+t_atom_long   buffer_getframecount  (t_buffer_obj* b);
+t_atom_long   buffer_getchannelcount (t_buffer_obj* b);
+double        buffer_getmillisamplerate (t_buffer_obj* b);
+
+// ========  END OF HEADER FILE  ========
+
+#endif
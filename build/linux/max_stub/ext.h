@@ -0,0 +1,136 @@
+#ifndef YC_STUB_EXT_H_
+#define YC_STUB_EXT_H_
+
+// ======== DESCRIPTION ======== //
+// Stand-in for the Max SDK headers, to build the engine headless on Linux: the types, atoms, symbols, classes,
+// outlets, clocks and queue elements used by the object, implemented in max_stub.c. Not the SDK: only what
+// the sources call, with the same names and behavior. The drivers use max_stub.h on top of it.
+
+// ========  HEADER FILE FOR THE MAX STUB  ========
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+// ====  TYPES  ====
+
+typedef int8_t    t_int8;
+typedef int16_t   t_int16;
+typedef int32_t   t_int32;
+typedef int64_t   t_int64;
+typedef uint8_t   t_uint8;
+typedef uint16_t  t_uint16;
+typedef uint32_t  t_uint32;
+typedef uint64_t  t_uint64;
+typedef uintptr_t t_ptr_uint;
+typedef intptr_t  t_ptr_int;
+typedef t_ptr_int t_atom_long;
+typedef double    t_atom_float;
+typedef long      t_max_err;
+typedef unsigned char t_bool;
+typedef float     t_float;
+typedef double    t_double;
+
+#define true  1
+#define false 0
+
+#define MAX_ERR_NONE      0
+#define MAX_ERR_GENERIC   -1
+
+#define C74_EXPORT
+
+#define PI      3.14159265358979323846
+#define TWOPI   6.28318530717958647692
+
+// ====  ATOMS AND SYMBOLS  ====
+
+#define A_NOTHING 0
+#define A_LONG    1
+#define A_FLOAT   2
+#define A_SYM     3
+#define A_GIMME   8
+#define A_CANT    9
+
+typedef struct _symbol { char* s_name; void* s_thing; } t_symbol;
+
+typedef struct _atom {
+  short a_type;
+  union { t_atom_long w_long; double w_float; t_symbol* w_sym; } a_w;
+} t_atom;
+
+t_symbol*   gensym          (const char* name);
+void        atom_setlong    (t_atom* a, t_atom_long l);
+void        atom_setfloat   (t_atom* a, double f);
+void        atom_setsym     (t_atom* a, t_symbol* s);
+t_atom_long atom_getlong    (const t_atom* a);
+double      atom_getfloat   (const t_atom* a);
+t_symbol*   atom_getsym     (const t_atom* a);
+long        atom_gettype    (const t_atom* a);
+
+// ====  OBJECTS AND CLASSES  ====
+// The first member of every object points to its class, which holds the methods looked up by name
+
+typedef struct _object { void* o_messlist; } t_object;
+typedef struct _class t_class;
+typedef void* (*method)(void*, ...);
+
+#define CLASS_BOX gensym("box")
+
+#define ASSIST_INLET  1
+#define ASSIST_OUTLET 2
+
+t_class*  class_new       (const char* name, method mnew, method mfree, long size, method mmenu, short type, ...);
+void      class_addmethod (t_class* c, method m, const char* name, ...);
+t_max_err class_register  (t_symbol* name_space, t_class* c);
+void*     object_alloc    (t_class* c);
+void      object_free     (void* x);
+t_symbol* object_classname (void* x);
+void*     object_method   (void* x, t_symbol* s, ...);
+void      object_post     (t_object* x, const char* fmt, ...);
+
+// ====  OUTLETS  ====
+
+void* outlet_new      (void* x, const char* type);
+void* bangout         (void* x);
+void* listout         (void* x);
+void* outlet_bang     (void* o);
+void* outlet_list     (void* o, t_symbol* s, short argc, t_atom* argv);
+void* outlet_anything (void* o, t_symbol* s, short argc, t_atom* argv);
+
+// ====  MEMORY  ====
+
+void* sysmem_newptr       (long size);
+void* sysmem_newptrclear  (long size);
+void* sysmem_resizeptr    (void* ptr, long size);
+void  sysmem_freeptr      (void* ptr);
+
+// ====  SCHEDULER  ====
+// Clocks, queue elements and deferred calls run on the thread calling stub_idle, which stands for the main thread
+
+typedef void t_clock;
+typedef void t_qelem;
+
+t_clock*  clock_new   (void* x, method fn);
+void      clock_fdelay (t_clock* c, double ms);
+void      clock_delay (t_clock* c, long ms);
+void      clock_unset (t_clock* c);
+t_qelem*  qelem_new   (void* x, method fn);
+void      qelem_set   (t_qelem* q);
+void      qelem_unset (t_qelem* q);
+void      qelem_free  (t_qelem* q);
+void      defer_low   (void* x, method fn, t_symbol* s, short argc, t_atom* argv);
+double    systimer_gettime (void);
+
+// ====  PATHS  ====
+
+#define MAX_PATH_CHARS    2048
+#define PATH_STYLE_NATIVE 4
+#define PATH_TYPE_BOOT    3
+
+short path_nameconform (const char* src, char* dst, long style, long type);
+
+// ========  END OF HEADER FILE  ========
+
+#endif
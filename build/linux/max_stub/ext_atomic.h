@@ -0,0 +1,19 @@
+#ifndef YC_STUB_EXT_ATOMIC_H_
+#define YC_STUB_EXT_ATOMIC_H_
+
+// ========  HEADER FILE FOR THE MAX STUB: ATOMIC OPERATIONS  ========
+// Sequentially consistent read-modify-write operations, returning the new value like the SDK
+
+#include "ext.h"
+
+typedef volatile t_int32 t_int32_atomic;
+
+#define ATOMIC_INCREMENT(p)             __atomic_add_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define ATOMIC_DECREMENT(p)             __atomic_sub_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define ATOMIC_INCREMENT_BARRIER(p)     __atomic_add_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define ATOMIC_DECREMENT_BARRIER(p)     __atomic_sub_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define ATOMIC_COMPARE_SWAP32(o, n, p)  __sync_bool_compare_and_swap((p), (o), (n))
+
+// ========  END OF HEADER FILE  ========
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef YC_STUB_EXT_OBEX_H_
+#define YC_STUB_EXT_OBEX_H_
+
+// ========  HEADER FILE FOR THE MAX STUB: OBJECT METHODS  ========
+
+#include "ext.h"
+
+// Call a method by name: typed with atoms, with one integer, or directly with a known signature.
+// The direct call is only used to get the name of a buffer.
+t_max_err object_method_typed (void* x, t_symbol* s, long argc, t_atom* argv, t_atom* rv);
+t_max_err object_method_long  (void* x, t_symbol* s, t_atom_long l, t_atom* rv);
+void*     stub_method_direct  (void* x, t_symbol* s);
+
+#define object_method_direct(rt, sig, x, s, ...) ((rt)stub_method_direct((void*)(x), (s)))
+
+// Parse a string into atoms, allocated with sysmem_newptr when *av is NULL
+t_max_err atom_setparse (long* ac, t_atom** av, const char* str);
+
+// ========  END OF HEADER FILE  ========
+
+#endif
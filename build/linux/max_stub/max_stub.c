@@ -0,0 +1,882 @@
+#include "max_stub.h"
+#include "ext_atomic.h"
+#include "wav.h"
+
+#include <stdarg.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <ctype.h>
+
+// ========  MAX STUB  ========
+// One process-wide state: the symbol table, the classes, the buffers and their references, the objects
+// with their DSP state, and the main thread tasks. Every list is protected by one recursive mutex, so that
+// a notification or a task can call back into the stub.
+
+#define STUB_METHODS_MAX  128   // Methods per class
+#define STUB_SYM_BINS     1024  // Bins of the symbol table
+#define STUB_OUTLETS_MAX  8     // Outlets per object
+
+// ====  STRUCTURE DECLARATIONS  ====
+
+typedef struct _stub_method {
+
+  t_symbol* sym;
+  method    fn;
+  short     type;       // A_NOTHING, A_LONG, A_FLOAT, A_SYM, A_GIMME or A_CANT
+
+} t_stub_method;
+
+struct _class {
+
+  t_symbol*     sym;
+  method        mnew;
+  method        mfree;
+  long          size;
+  t_stub_method methods[STUB_METHODS_MAX];
+  t_int16       n_methods;
+
+};
+
+typedef struct _stub_sym {
+
+  t_symbol          sym;
+  struct _stub_sym* next;
+
+} t_stub_sym;
+
+// Audio thread side of an object: its perform routine, added by its dsp64 method, and whether its DSP runs
+typedef void (*t_stub_perform)(t_object* x, t_object* dsp64, double** ins, t_int16 numins, double** outs,
+  t_int16 numouts, t_int32 sampleframes, t_int32 flags, void* userparam);
+
+typedef struct _stub_obj {
+
+  t_object*         x;
+  t_stub_perform    perform;
+  t_int32_atomic    dsp_on;
+  struct _stub_obj* next;
+
+} t_stub_obj;
+
+typedef struct _stub_outlet {
+
+  t_object  ob;
+  t_object* owner;
+
+} t_stub_outlet;
+
+typedef struct _stub_buffer {
+
+  t_object              ob;
+  t_symbol*             name;
+  float*                data;
+  long                  n_chn;      // The metadata is read and written atomically, as it is read without locking
+  long                  n_frm;
+  double                sr;
+  t_int32_atomic        readers;    // Number of threads with the samples locked
+  t_int32_atomic        writing;    // Set while a read or a resize waits for the readers or changes the samples
+  pthread_mutex_t       write_lock; // One change at a time, recursive as a resize keeps it around the change
+  struct _stub_buffer*  next;
+
+} t_stub_buffer;
+
+typedef struct _stub_ref {
+
+  t_object          ob;
+  t_object*         owner;
+  t_symbol*         name;
+  struct _stub_ref* next;
+
+} t_stub_ref;
+
+typedef struct _stub_task {
+
+  t_object            ob;
+  void*               x;
+  method              fn;
+  t_int32_atomic      set;      // Queue element: set and not run yet
+  double              due;      // Clock: time to run at, negative when unset
+  struct _stub_task*  next;
+
+} t_stub_task;
+
+typedef struct _stub_defer {
+
+  void*               x;
+  method              fn;
+  t_symbol*           s;
+  short               argc;
+  t_atom*             argv;
+  struct _stub_defer* next;
+
+} t_stub_defer;
+
+// ====  STATE  ====
+
+static pthread_mutex_t  stub_mutex;
+static pthread_once_t   stub_once = PTHREAD_ONCE_INIT;
+static t_stub_sym*      stub_syms[STUB_SYM_BINS];
+static t_class*         stub_classes[8];
+static t_int16          stub_n_classes = 0;
+static t_class          stub_class_buffer, stub_class_ref, stub_class_outlet, stub_class_clock, stub_class_qelem, stub_class_dsp;
+static t_stub_obj*      stub_objs = NULL;
+static t_stub_buffer*   stub_buffers = NULL;
+static t_stub_ref*      stub_refs = NULL;
+static t_stub_task*     stub_tasks = NULL;
+static t_stub_defer*    stub_defer_head = NULL;
+static t_stub_defer*    stub_defer_tail = NULL;
+static double           stub_sr = 44100;
+static t_stub_outlet_hook stub_out_fn = NULL;
+static void*            stub_out_ctx = NULL;
+static t_stub_post_hook stub_post_fn = NULL;
+static void*            stub_post_ctx = NULL;
+static t_stub_obj*      stub_dsp_compiling = NULL;
+
+static void stub_setup(void) {
+
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&stub_mutex, &attr);
+  pthread_mutexattr_destroy(&attr);
+}
+
+static void stub_lock(void)   { pthread_once(&stub_once, stub_setup); pthread_mutex_lock(&stub_mutex); }
+static void stub_unlock(void) { pthread_mutex_unlock(&stub_mutex); }
+
+static t_class* stub_classof(void* x) { return (x ? (t_class*)((t_object*)x)->o_messlist : NULL); }
+
+// ========  SYMBOLS AND ATOMS  ========
+
+t_symbol* gensym(const char* name) {
+
+  t_uint32 h = 5381;
+  for (const char* c = name; *c; c++) { h = h * 33 + (t_uint8)*c; }
+  h %= STUB_SYM_BINS;
+
+  stub_lock();
+
+  t_stub_sym* sym = stub_syms[h];
+  while (sym && strcmp(sym->sym.s_name, name)) { sym = sym->next; }
+
+  if (sym == NULL) {
+    sym = (t_stub_sym*)calloc(1, sizeof(t_stub_sym));
+    sym->sym.s_name = strdup(name);
+    sym->next = stub_syms[h];
+    stub_syms[h] = sym;
+  }
+
+  stub_unlock();
+  return &sym->sym;
+}
+
+void atom_setlong(t_atom* a, t_atom_long l)  { a->a_type = A_LONG;  a->a_w.w_long = l; }
+void atom_setfloat(t_atom* a, double f)      { a->a_type = A_FLOAT; a->a_w.w_float = f; }
+void atom_setsym(t_atom* a, t_symbol* s)     { a->a_type = A_SYM;   a->a_w.w_sym = s; }
+long atom_gettype(const t_atom* a)           { return a->a_type; }
+
+t_atom_long atom_getlong(const t_atom* a) {
+  return ((a->a_type == A_LONG) ? a->a_w.w_long : ((a->a_type == A_FLOAT) ? (t_atom_long)a->a_w.w_float : 0));
+}
+
+double atom_getfloat(const t_atom* a) {
+  return ((a->a_type == A_FLOAT) ? a->a_w.w_float : ((a->a_type == A_LONG) ? (double)a->a_w.w_long : 0));
+}
+
+t_symbol* atom_getsym(const t_atom* a) { return ((a->a_type == A_SYM) ? a->a_w.w_sym : gensym("")); }
+
+// ====  PROCEDURE: ATOM_SETPARSE  ====
+// Split on white space: integers, floats, and symbols for anything else, with double quotes grouping words
+
+t_max_err atom_setparse(long* ac, t_atom** av, const char* str) {
+
+  long    n = 0, cap = 16;
+  t_atom* atoms = (t_atom*)sysmem_newptr(cap * sizeof(t_atom));
+  char    word[MAX_PATH_CHARS];
+  char*   end;
+
+  while (*str) {
+
+    while (*str && isspace((t_uint8)*str)) { str++; }
+    if (*str == 0) { break; }
+
+    long len = 0;
+    t_bool quoted = (*str == '"');
+    if (quoted) { str++; }
+    while (*str && (quoted ? (*str != '"') : !isspace((t_uint8)*str)) && (len < MAX_PATH_CHARS - 1)) { word[len++] = *str++; }
+    if (quoted && *str) { str++; }
+    word[len] = 0;
+
+    if (n == cap) { cap *= 2; atoms = (t_atom*)sysmem_resizeptr(atoms, cap * sizeof(t_atom)); }
+
+    long   l = strtol(word, &end, 10);
+    if (!quoted && len && (*end == 0)) { atom_setlong(atoms + n++, l); continue; }
+
+    double f = strtod(word, &end);
+    if (!quoted && len && (*end == 0)) { atom_setfloat(atoms + n++, f); continue; }
+
+    atom_setsym(atoms + n++, gensym(word));
+  }
+
+  *ac = n;
+  *av = atoms;
+  return MAX_ERR_NONE;
+}
+
+// ========  MEMORY, POSTS, PATHS AND TIME  ========
+
+void* sysmem_newptr(long size)                { return malloc(size ? size : 1); }
+void* sysmem_newptrclear(long size)           { return calloc(1, size ? size : 1); }
+void* sysmem_resizeptr(void* ptr, long size)  { return realloc(ptr, size ? size : 1); }
+void  sysmem_freeptr(void* ptr)               { free(ptr); }
+
+void object_post(t_object* x, const char* fmt, ...) {
+
+  char    str[4096];
+  va_list args;
+
+  va_start(args, fmt);
+  vsnprintf(str, sizeof(str), fmt, args);
+  va_end(args);
+
+  if (stub_post_fn) { stub_post_fn(stub_post_ctx, x, str); }
+  else { printf("%s:  %s\n", ((stub_classof(x) && stub_classof(x)->sym) ? stub_classof(x)->sym->s_name : "max"), str); }
+}
+
+short path_nameconform(const char* src, char* dst, long style, long type) {
+
+  strncpy(dst, src, MAX_PATH_CHARS - 1);
+  dst[MAX_PATH_CHARS - 1] = 0;
+  return 0;
+}
+
+double systimer_gettime(void) {
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000. + ts.tv_nsec * 1e-6;
+}
+
+// ========  CLASSES AND OBJECTS  ========
+
+t_class* class_new(const char* name, method mnew, method mfree, long size, method mmenu, short type, ...) {
+
+  t_class* c = (t_class*)calloc(1, sizeof(t_class));
+
+  c->sym   = gensym(name);
+  c->mnew  = mnew;
+  c->mfree = mfree;
+  c->size  = size;
+
+  return c;
+}
+
+void class_addmethod(t_class* c, method m, const char* name, ...) {
+
+  va_list args;
+  short   type;
+
+  va_start(args, name);
+  type = (short)va_arg(args, int);
+  va_end(args);
+
+  if (c->n_methods == STUB_METHODS_MAX) { fprintf(stderr, "max_stub:  Too many methods in class %s\n", c->sym->s_name); exit(1); }
+
+  c->methods[c->n_methods].sym  = gensym(name);
+  c->methods[c->n_methods].fn   = m;
+  c->methods[c->n_methods].type = type;
+  c->n_methods++;
+}
+
+t_max_err class_register(t_symbol* name_space, t_class* c) {
+
+  stub_lock();
+  stub_classes[stub_n_classes++] = c;
+  stub_unlock();
+  return MAX_ERR_NONE;
+}
+
+static method stub_getmethod(t_class* c, t_symbol* s, short* type) {
+
+  if (c == NULL) { return NULL; }
+
+  for (t_int16 i = 0; i < c->n_methods; i++) {
+    if (c->methods[i].sym == s) { if (type) { *type = c->methods[i].type; } return c->methods[i].fn; }
+  }
+
+  return NULL;
+}
+
+void* object_alloc(t_class* c) {
+
+  t_object* x = (t_object*)calloc(1, c->size);
+  x->o_messlist = c;
+  return x;
+}
+
+t_symbol* object_classname(void* x) { return (stub_classof(x) ? stub_classof(x)->sym : gensym("")); }
+
+// ====  METHOD: OBJECT_FREE  ====
+// Free an object of the stub, or call the free method of an object of a registered class and free it
+
+void object_free(void* x) {
+
+  t_class* c = stub_classof(x);
+
+  if (x == NULL) { return; }
+
+  stub_lock();
+
+  if ((c == &stub_class_clock) || (c == &stub_class_qelem)) {
+    for (t_stub_task** t = &stub_tasks; *t; t = &(*t)->next) { if (*t == x) { *t = ((t_stub_task*)x)->next; break; } }
+  }
+  else if (c == &stub_class_ref) {
+    for (t_stub_ref** r = &stub_refs; *r; r = &(*r)->next) { if (*r == x) { *r = ((t_stub_ref*)x)->next; break; } }
+  }
+  else if ((c != &stub_class_outlet) && (c != &stub_class_buffer)) {
+    for (t_stub_obj** o = &stub_objs; *o; o = &(*o)->next) { if ((*o)->x == x) { t_stub_obj* f = *o; *o = f->next; free(f); break; } }
+  }
+
+  stub_unlock();
+
+  if (c == &stub_class_buffer) { return; }
+  if (c && c->mfree && (c->size > 0)) { ((void (*)(void*))c->mfree)(x); }
+
+  free(x);
+}
+
+// ====  METHOD: OBJECT_METHOD  ====
+// Only dsp_add64, sent by the dsp64 method to the DSP chain being compiled
+
+void* object_method(void* x, t_symbol* s, ...) {
+
+  if ((stub_classof(x) == &stub_class_dsp) && (s == gensym("dsp_add64")) && stub_dsp_compiling) {
+    va_list args;
+    va_start(args, s);
+    va_arg(args, void*);
+    stub_dsp_compiling->perform = va_arg(args, t_stub_perform);
+    va_end(args);
+  }
+
+  return NULL;
+}
+
+void* stub_method_direct(void* x, t_symbol* s) {
+
+  if ((stub_classof(x) == &stub_class_buffer) && (s == gensym("getname"))) { return ((t_stub_buffer*)x)->name; }
+  return NULL;
+}
+
+// ====  PROCEDURE: STUB_DISPATCH  ====
+// Call a method of an object with atoms, converted to the arguments of its type
+
+static t_max_err stub_dispatch(t_object* x, t_symbol* s, long argc, t_atom* argv) {
+
+  short  type = A_NOTHING;
+  method fn = stub_getmethod(stub_classof(x), s, &type);
+
+  if ((fn == NULL) || (type == A_CANT)) {
+    object_post(x, "doesn't understand \"%s\"", s->s_name);
+    return MAX_ERR_GENERIC;
+  }
+
+  switch (type) {
+  case A_GIMME: ((void (*)(void*, t_symbol*, t_int16, t_atom*))fn)(x, s, (t_int16)argc, argv); break;
+  case A_LONG:  ((void (*)(void*, t_atom_long))fn)(x, (argc ? atom_getlong(argv) : 0)); break;
+  case A_FLOAT: ((void (*)(void*, double))fn)(x, (argc ? atom_getfloat(argv) : 0)); break;
+  case A_SYM:   ((void (*)(void*, t_symbol*))fn)(x, (argc ? atom_getsym(argv) : gensym(""))); break;
+  default:      ((void (*)(void*))fn)(x); break;
+  }
+
+  return MAX_ERR_NONE;
+}
+
+// ========  OUTLETS  ========
+
+static void* stub_outlet(void* x) {
+
+  t_stub_outlet* o = (t_stub_outlet*)calloc(1, sizeof(t_stub_outlet));
+  o->ob.o_messlist = &stub_class_outlet;
+  o->owner = (t_object*)x;
+  return o;
+}
+
+void* outlet_new(void* x, const char* type) { return stub_outlet(x); }
+void* bangout(void* x)                      { return stub_outlet(x); }
+void* listout(void* x)                      { return stub_outlet(x); }
+
+void* outlet_anything(void* o, t_symbol* s, short argc, t_atom* argv) {
+  if (stub_out_fn) { stub_out_fn(stub_out_ctx, ((t_stub_outlet*)o)->owner, o, s, argc, argv); }
+  return NULL;
+}
+
+void* outlet_bang(void* o)                                      { return outlet_anything(o, gensym("bang"), 0, NULL); }
+void* outlet_list(void* o, t_symbol* s, short argc, t_atom* argv) { return outlet_anything(o, gensym("list"), argc, argv); }
+
+// ========  SCHEDULER  ========
+
+static t_stub_task* stub_task_new(t_class* c, void* x, method fn) {
+
+  t_stub_task* t = (t_stub_task*)calloc(1, sizeof(t_stub_task));
+
+  t->ob.o_messlist = c;
+  t->x   = x;
+  t->fn  = fn;
+  t->due = -1;
+
+  stub_lock();
+  t->next = stub_tasks;
+  stub_tasks = t;
+  stub_unlock();
+
+  return t;
+}
+
+t_clock* clock_new(void* x, method fn)  { return stub_task_new(&stub_class_clock, x, fn); }
+t_qelem* qelem_new(void* x, method fn)  { return stub_task_new(&stub_class_qelem, x, fn); }
+
+void clock_fdelay(t_clock* c, double ms) { stub_lock(); ((t_stub_task*)c)->due = systimer_gettime() + ms; stub_unlock(); }
+void clock_delay(t_clock* c, long ms)    { clock_fdelay(c, (double)ms); }
+void clock_unset(t_clock* c)             { stub_lock(); ((t_stub_task*)c)->due = -1; stub_unlock(); }
+
+// Setting a queue element is lock-free: it is called from the audio thread
+void qelem_set(t_qelem* q)    { __atomic_store_n(&((t_stub_task*)q)->set, 1, __ATOMIC_RELEASE); }
+void qelem_unset(t_qelem* q)  { __atomic_store_n(&((t_stub_task*)q)->set, 0, __ATOMIC_RELEASE); }
+void qelem_free(t_qelem* q)   { object_free(q); }
+
+void defer_low(void* x, method fn, t_symbol* s, short argc, t_atom* argv) {
+
+  t_stub_defer* d = (t_stub_defer*)calloc(1, sizeof(t_stub_defer));
+
+  d->x    = x;
+  d->fn   = fn;
+  d->s    = s;
+  d->argc = argc;
+  d->argv = (t_atom*)sysmem_newptr((argc ? argc : 1) * sizeof(t_atom));
+  if (argc) { memcpy(d->argv, argv, argc * sizeof(t_atom)); }
+
+  stub_lock();
+  if (stub_defer_tail) { stub_defer_tail->next = d; } else { stub_defer_head = d; }
+  stub_defer_tail = d;
+  stub_unlock();
+}
+
+// ====  PROCEDURE: STUB_IDLE  ====
+// One pass of the main thread: the clocks that are due, the queue elements that are set, and the calls deferred
+// before the pass. Tasks added by the pass run at the next one.
+
+void stub_idle(void) {
+
+  double now = systimer_gettime();
+
+  // Clocks and queue elements, one at a time, as the task may free or add tasks
+  t_bool ran = true;
+
+  while (ran) {
+
+    ran = false;
+    stub_lock();
+
+    for (t_stub_task* t = stub_tasks; t; t = t->next) {
+
+      t_bool due = (((t->ob.o_messlist == &stub_class_clock) && (t->due >= 0) && (t->due <= now))
+        || ((t->ob.o_messlist == &stub_class_qelem) && __atomic_load_n(&t->set, __ATOMIC_ACQUIRE)));
+
+      if (due) {
+        if (t->ob.o_messlist == &stub_class_clock) { t->due = -1; }
+        else { __atomic_store_n(&t->set, 0, __ATOMIC_RELEASE); }
+        ((void (*)(void*))t->fn)(t->x);
+        ran = true;
+        break;
+      }
+    }
+
+    stub_unlock();
+  }
+
+  // Deferred calls
+  stub_lock();
+  t_stub_defer* d = stub_defer_head;
+  stub_defer_head = stub_defer_tail = NULL;
+  stub_unlock();
+
+  while (d) {
+    t_stub_defer* next = d->next;
+    ((void (*)(void*, t_symbol*, t_int16, t_atom*))d->fn)(d->x, d->s, d->argc, d->argv);
+    sysmem_freeptr(d->argv);
+    free(d);
+    d = next;
+  }
+}
+
+// ====  PROCEDURE: STUB_IDLE_PENDING  ====
+// RETURNS: true if a deferred call or a queue element is waiting, or a clock is set
+
+t_bool stub_idle_pending(void) {
+
+  t_bool pending;
+
+  stub_lock();
+  pending = (stub_defer_head != NULL);
+  for (t_stub_task* t = stub_tasks; t && !pending; t = t->next) {
+    pending = ((t->due >= 0) || __atomic_load_n(&t->set, __ATOMIC_ACQUIRE));
+  }
+  stub_unlock();
+
+  return pending;
+}
+
+// ========  DSP  ========
+
+static t_stub_obj* stub_obj(t_object* x) {
+
+  t_stub_obj* o;
+
+  stub_lock();
+  for (o = stub_objs; o && (o->x != x); o = o->next) { }
+  stub_unlock();
+
+  return o;
+}
+
+void   dsp_setup(t_pxobject* x, long n_in)  { }
+void   dsp_free(t_pxobject* x)              { }
+void   class_dspinit(t_class* c)            { }
+double sys_getsr(void)                      { return stub_sr; }
+
+short sys_getdspobjdspstate(t_object* x) {
+  t_stub_obj* o = stub_obj(x);
+  return (o ? (short)__atomic_load_n(&o->dsp_on, __ATOMIC_ACQUIRE) : 0);
+}
+
+short sys_getdspstate(void) {
+
+  short on = 0;
+
+  stub_lock();
+  for (t_stub_obj* o = stub_objs; o; o = o->next) { on |= (short)__atomic_load_n(&o->dsp_on, __ATOMIC_ACQUIRE); }
+  stub_unlock();
+
+  return on;
+}
+
+// ====  PROCEDURE: STUB_DSP_START  ====
+// Compile the DSP chain of the object, one signal inlet and one signal outlet connected, then turn its DSP on.
+// With a vector size of 0 the chain is compiled without turning the DSP on, for the offline methods.
+
+void stub_dsp_start(t_object* x, double samplerate, long vec_len) {
+
+  t_stub_obj* o = stub_obj(x);
+  t_object    dsp64 = { &stub_class_dsp };
+  t_int16     count[2] = { 1, 1 };
+  method      fn = stub_getmethod(stub_classof(x), gensym("dsp64"), NULL);
+
+  if ((o == NULL) || (fn == NULL)) { return; }
+
+  stub_sr = samplerate;
+
+  stub_lock();
+  stub_dsp_compiling = o;
+  ((void (*)(t_object*, t_object*, t_int16*, double, t_int32, t_int32))fn)(x, &dsp64, count, samplerate,
+    (t_int32)(vec_len ? vec_len : 64), 0);
+  stub_dsp_compiling = NULL;
+  stub_unlock();
+
+  if (vec_len) { __atomic_store_n(&o->dsp_on, 1, __ATOMIC_RELEASE); }
+}
+
+void stub_dsp_stop(t_object* x) {
+
+  t_stub_obj* o = stub_obj(x);
+  method      fn = stub_getmethod(stub_classof(x), gensym("dspstate"), NULL);
+
+  if (o == NULL) { return; }
+
+  __atomic_store_n(&o->dsp_on, 0, __ATOMIC_RELEASE);
+  if (fn) { ((void (*)(t_object*, t_atom_long))fn)(x, 0); }
+}
+
+// ====  PROCEDURE: STUB_PERFORM  ====
+// One vector cycle of the perform routine, from the audio thread
+
+void stub_perform(t_object* x, double* in, double* out, long vec_len) {
+
+  t_stub_obj* o = stub_obj(x);
+
+  if ((o == NULL) || (o->perform == NULL)) { return; }
+
+  o->perform(x, NULL, &in, 1, &out, 1, (t_int32)vec_len, 0, NULL);
+}
+
+// ========  BUFFERS  ========
+
+static t_stub_buffer* stub_buffer_find(t_symbol* name) {
+
+  t_stub_buffer* b;
+
+  stub_lock();
+  for (b = stub_buffers; b && (b->name != name); b = b->next) { }
+  stub_unlock();
+
+  return b;
+}
+
+// ====  PROCEDURE: STUB_BUFFER_NOTIFY  ====
+// Send a notification to the owner of every reference to the buffer, like buffer~ does after a change
+
+static void stub_buffer_notify(t_stub_buffer* b, t_symbol* msg) {
+
+  stub_lock();
+
+  for (t_stub_ref* r = stub_refs; r; r = r->next) {
+    method fn = stub_getmethod(stub_classof(r->owner), gensym("notify"), NULL);
+    if ((r->name == b->name) && fn) {
+      ((t_max_err (*)(t_object*, t_symbol*, t_symbol*, void*, void*))fn)(r->owner, b->name, msg, b, b);
+    }
+  }
+
+  stub_unlock();
+}
+
+t_buffer_obj* stub_buffer_new(const char* name, long n_chn, long n_frm, double samplerate) {
+
+  t_stub_buffer* b = stub_buffer_find(gensym(name));
+  if (b) { return &b->ob; }
+
+  b = (t_stub_buffer*)calloc(1, sizeof(t_stub_buffer));
+
+  b->ob.o_messlist = &stub_class_buffer;
+  b->name  = gensym(name);
+  b->n_chn = (n_chn > 0 ? n_chn : 1);
+  b->n_frm = n_frm;
+  b->sr    = samplerate;
+  b->data  = (float*)calloc((n_frm ? n_frm : 1) * b->n_chn, sizeof(float));
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&b->write_lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+
+  stub_lock();
+  b->next = stub_buffers;
+  stub_buffers = b;
+  stub_unlock();
+
+  return &b->ob;
+}
+
+// ====  PROCEDURES: STUB_BUFFER_BEGIN / END  ====
+// Start a change of the samples: from then on locking the samples fails, and the change waits until the threads
+// that have them locked unlock them. Readers never wait, so the audio thread cannot be blocked by a change.
+
+static void stub_buffer_begin(t_stub_buffer* b) {
+
+  pthread_mutex_lock(&b->write_lock);
+  __atomic_store_n(&b->writing, 1, __ATOMIC_SEQ_CST);
+  while (__atomic_load_n(&b->readers, __ATOMIC_SEQ_CST)) { sched_yield(); }
+}
+
+static void stub_buffer_end(t_stub_buffer* b) {
+
+  __atomic_store_n(&b->writing, 0, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&b->write_lock);
+}
+
+// ====  PROCEDURE: STUB_BUFFER_SET  ====
+// Replace the samples of a buffer once no one has them locked, then notify the references
+
+static void stub_buffer_set(t_stub_buffer* b, float* data, long n_chn, long n_frm, double samplerate) {
+
+  stub_buffer_begin(b);
+  free(b->data);
+  b->data = data;
+  __atomic_store_n(&b->n_chn, n_chn, __ATOMIC_RELAXED);
+  __atomic_store_n(&b->n_frm, n_frm, __ATOMIC_RELAXED);
+  __atomic_store(&b->sr, &samplerate, __ATOMIC_RELAXED);
+  stub_buffer_end(b);
+
+  stub_buffer_notify(b, gensym("buffer_modified"));
+}
+
+t_max_err stub_buffer_read(t_buffer_obj* buff, const char* path) {
+
+  t_stub_buffer* b = (t_stub_buffer*)buff;
+  long   n_chn, n_frm;
+  double sr;
+  float* wav = wav_read(path, &n_chn, &n_frm, &sr);
+
+  if (wav == NULL) { object_post(NULL, "buffer~ %s:  Unable to read \"%s\"", b->name->s_name, path); return MAX_ERR_GENERIC; }
+
+  // The samples are owned by the buffer, allocated with malloc like the ones it creates
+  float* data = (float*)malloc((n_frm ? n_frm : 1) * n_chn * sizeof(float));
+  memcpy(data, wav, n_frm * n_chn * sizeof(float));
+  sysmem_freeptr(wav);
+
+  stub_buffer_set(b, data, n_chn, n_frm, sr);
+  return MAX_ERR_NONE;
+}
+
+t_max_err stub_buffer_write(t_buffer_obj* buff, const char* path, short bits) {
+
+  t_stub_buffer* b = (t_stub_buffer*)buff;
+  t_max_err      err;
+
+  stub_buffer_begin(b);
+  err = wav_write(path, b->data, b->n_chn, b->n_frm, b->sr, bits);
+  stub_buffer_end(b);
+
+  return err;
+}
+
+t_buffer_ref* buffer_ref_new(t_object* owner, t_symbol* name) {
+
+  t_stub_ref* r = (t_stub_ref*)calloc(1, sizeof(t_stub_ref));
+
+  r->ob.o_messlist = &stub_class_ref;
+  r->owner = owner;
+  r->name  = name;
+
+  stub_lock();
+  r->next = stub_refs;
+  stub_refs = r;
+  stub_unlock();
+
+  return &r->ob;
+}
+
+void buffer_ref_set(t_buffer_ref* ref, t_symbol* name)  { stub_lock(); ((t_stub_ref*)ref)->name = name; stub_unlock(); }
+
+t_buffer_obj* buffer_ref_getobject(t_buffer_ref* ref) {
+
+  if (ref == NULL) { return NULL; }
+
+  t_stub_buffer* b = stub_buffer_find(((t_stub_ref*)ref)->name);
+  return (b ? &b->ob : NULL);
+}
+
+t_max_err buffer_ref_notify(t_buffer_ref* ref, t_symbol* s, t_symbol* msg, void* sender, void* data) { return MAX_ERR_NONE; }
+
+// Locking counts the thread as a reader. It fails during a change, like it does in Max, and for an empty buffer.
+float* buffer_locksamples(t_buffer_obj* buff) {
+
+  t_stub_buffer* b = (t_stub_buffer*)buff;
+
+  __atomic_add_fetch(&b->readers, 1, __ATOMIC_SEQ_CST);
+
+  if (__atomic_load_n(&b->writing, __ATOMIC_SEQ_CST) || (__atomic_load_n(&b->n_frm, __ATOMIC_RELAXED) == 0)) {
+    __atomic_sub_fetch(&b->readers, 1, __ATOMIC_RELEASE);
+    return NULL;
+  }
+
+  return b->data;
+}
+
+void buffer_unlocksamples(t_buffer_obj* buff) { __atomic_sub_fetch(&((t_stub_buffer*)buff)->readers, 1, __ATOMIC_RELEASE); }
+void buffer_setdirty(t_buffer_obj* buff)      { }
+
+t_atom_long buffer_getframecount(t_buffer_obj* buff)      { return __atomic_load_n(&((t_stub_buffer*)buff)->n_frm, __ATOMIC_RELAXED); }
+t_atom_long buffer_getchannelcount(t_buffer_obj* buff)    { return __atomic_load_n(&((t_stub_buffer*)buff)->n_chn, __ATOMIC_RELAXED); }
+double      buffer_getmillisamplerate(t_buffer_obj* buff) { double sr; __atomic_load(&((t_stub_buffer*)buff)->sr, &sr, __ATOMIC_RELAXED); return sr * 0.001; }
+
+// ====  METHODS OF THE BUFFERS AND OF THE OBJECTS  ====
+// Buffers understand "read" with the path first, and "sizeinsamps". Other objects get their methods called.
+
+t_max_err object_method_typed(void* x, t_symbol* s, long argc, t_atom* argv, t_atom* rv) {
+
+  if (stub_classof(x) == &stub_class_buffer) {
+    if ((s == gensym("read")) && argc && (atom_gettype(argv) == A_SYM)) { return stub_buffer_read(x, atom_getsym(argv)->s_name); }
+    return MAX_ERR_GENERIC;
+  }
+
+  return stub_dispatch((t_object*)x, s, argc, argv);
+}
+
+t_max_err object_method_long(void* x, t_symbol* s, t_atom_long l, t_atom* rv) {
+
+  t_stub_buffer* b = (t_stub_buffer*)x;
+
+  if ((stub_classof(x) != &stub_class_buffer) || (s != gensym("sizeinsamps")) || (l < 0)) {
+    t_atom a;
+    atom_setlong(&a, l);
+    return object_method_typed(x, s, 1, &a, rv);
+  }
+
+  // The samples are kept, up to the new size: only the thread changing the buffer writes them
+  pthread_mutex_lock(&b->write_lock);
+  long n_chn = b->n_chn, n_frm = b->n_frm;
+  float* data = (float*)calloc((l ? l : 1) * n_chn, sizeof(float));
+  memcpy(data, b->data, ((n_frm < l) ? n_frm : l) * n_chn * sizeof(float));
+  stub_buffer_set(b, data, n_chn, l, b->sr);
+  pthread_mutex_unlock(&b->write_lock);
+
+  return MAX_ERR_NONE;
+}
+
+// ========  DRIVERS  ========
+
+void stub_init(double samplerate, int (*class_main)(void)) {
+
+  stub_lock();
+
+  stub_sr = samplerate;
+  stub_class_buffer.sym = gensym("buffer~");
+  stub_class_ref.sym    = gensym("buffer_ref");
+  stub_class_outlet.sym = gensym("outlet");
+  stub_class_clock.sym  = gensym("clock");
+  stub_class_qelem.sym  = gensym("qelem");
+  stub_class_dsp.sym    = gensym("dsp64");
+
+  stub_unlock();
+
+  class_main();
+}
+
+// ====  PROCEDURE: STUB_NEW  ====
+// Create an object of a registered class with its arguments
+// RETURNS: The object, or NULL if the class is unknown or its new method failed
+
+t_object* stub_new(const char* class_name, long argc, t_atom* argv) {
+
+  t_class* c = NULL;
+  t_symbol* s = gensym(class_name);
+
+  stub_lock();
+  for (t_int16 i = 0; i < stub_n_classes; i++) { if (stub_classes[i]->sym == s) { c = stub_classes[i]; } }
+  stub_unlock();
+
+  if (c == NULL) { return NULL; }
+
+  t_object* x = ((t_object* (*)(t_symbol*, t_int16, t_atom*))c->mnew)(s, (t_int16)argc, argv);
+  if (x == NULL) { return NULL; }
+
+  t_stub_obj* o = (t_stub_obj*)calloc(1, sizeof(t_stub_obj));
+  o->x = x;
+
+  stub_lock();
+  o->next = stub_objs;
+  stub_objs = o;
+  stub_unlock();
+
+  return x;
+}
+
+t_max_err stub_send(t_object* x, const char* msg, long argc, t_atom* argv) { return stub_dispatch(x, gensym(msg), argc, argv); }
+
+// ====  PROCEDURE: STUB_SEND_LINE  ====
+// Send a message written like in a message box: the selector followed by its arguments
+
+t_max_err stub_send_line(t_object* x, const char* line) {
+
+  long      ac = 0;
+  t_atom*   av = NULL;
+  t_max_err err = MAX_ERR_GENERIC;
+
+  atom_setparse(&ac, &av, line);
+  if (ac && (atom_gettype(av) == A_SYM)) { err = stub_dispatch(x, atom_getsym(av), ac - 1, av + 1); }
+  sysmem_freeptr(av);
+
+  return err;
+}
+
+void stub_outlet_hook(t_stub_outlet_hook fn, void* ctx) { stub_out_fn = fn; stub_out_ctx = ctx; }
+void stub_post_hook(t_stub_post_hook fn, void* ctx)     { stub_post_fn = fn; stub_post_ctx = ctx; }
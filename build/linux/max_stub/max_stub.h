@@ -0,0 +1,46 @@
+#ifndef YC_MAX_STUB_H_
+#define YC_MAX_STUB_H_
+
+// ======== DESCRIPTION ======== //
+// Driver side of the Max stub: create the object, send it messages, run its DSP chain and its main thread tasks,
+// create buffers and read the outlets and posts. Everything else is the SDK surface declared in ext.h.
+
+// ========  HEADER FILE FOR THE MAX STUB DRIVERS  ========
+
+#include "ext.h"
+#include "ext_obex.h"
+#include "z_dsp.h"
+#include "buffer.h"
+
+// ====  HOOKS  ====
+
+// Called for every message sent out of an outlet, with "bang" and "list" for bangs and lists
+typedef void (*t_stub_outlet_hook)(void* ctx, t_object* x, void* outlet, t_symbol* s, long argc, t_atom* argv);
+
+// Called for every post, instead of printing it when set
+typedef void (*t_stub_post_hook)(void* ctx, t_object* x, const char* str);
+
+// ====  PROCEDURE DECLARATIONS  ====
+
+void          stub_init         (double samplerate, int (*class_main)(void));
+t_object*     stub_new          (const char* class_name, long argc, t_atom* argv);
+t_max_err     stub_send         (t_object* x, const char* msg, long argc, t_atom* argv);
+t_max_err     stub_send_line    (t_object* x, const char* line);
+
+void          stub_dsp_start    (t_object* x, double samplerate, long vec_len);
+void          stub_dsp_stop     (t_object* x);
+void          stub_perform      (t_object* x, double* in, double* out, long vec_len);
+
+void          stub_idle         (void);
+t_bool        stub_idle_pending (void);
+
+t_buffer_obj* stub_buffer_new   (const char* name, long n_chn, long n_frm, double samplerate);
+t_max_err     stub_buffer_read  (t_buffer_obj* b, const char* path);
+t_max_err     stub_buffer_write (t_buffer_obj* b, const char* path, short bits);
+
+void          stub_outlet_hook  (t_stub_outlet_hook fn, void* ctx);
+void          stub_post_hook    (t_stub_post_hook fn, void* ctx);
+
+// ========  END OF HEADER FILE  ========
+
+#endif
@@ -0,0 +1,133 @@
+#include "wav.h"
+
+// ========  WAV FILES  ========
+
+#define WAV_FMT_PCM         1
+#define WAV_FMT_FLOAT       3
+#define WAV_FMT_EXTENSIBLE  0xFFFE
+
+static t_uint32 wav_u32(const t_uint8* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((t_uint32)p[3] << 24); }
+static t_uint16 wav_u16(const t_uint8* p) { return (t_uint16)(p[0] | (p[1] << 8)); }
+
+static void wav_put32(t_uint8* p, t_uint32 v) { p[0] = v & 0xFF; p[1] = (v >> 8) & 0xFF; p[2] = (v >> 16) & 0xFF; p[3] = v >> 24; }
+static void wav_put16(t_uint8* p, t_uint16 v) { p[0] = v & 0xFF; p[1] = v >> 8; }
+
+// ====  PROCEDURE: WAV_READ  ====
+// Read a whole file into interleaved floats
+// RETURNS: The samples, to free with sysmem_freeptr, or NULL if the file cannot be read or its format is not supported
+
+float* wav_read(const char* path, long* n_chn, long* n_frm, double* samplerate) {
+
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) { return NULL; }
+
+  t_uint8  hdr[12], chunk[8], fmt[40];
+  t_uint16 format = 0, chn = 0, bits = 0;
+  t_uint32 sr = 0, size;
+  float*   data = NULL;
+
+  if ((fread(hdr, 1, 12, file) != 12) || memcmp(hdr, "RIFF", 4) || memcmp(hdr + 8, "WAVE", 4)) { fclose(file); return NULL; }
+
+  // Walk the chunks until the samples, after the format
+  while (fread(chunk, 1, 8, file) == 8) {
+
+    size = wav_u32(chunk + 4);
+
+    if (!memcmp(chunk, "fmt ", 4)) {
+      if ((size < 16) || (fread(fmt, 1, (size < 40) ? size : 40, file) != ((size < 40) ? size : 40))) { break; }
+      if (size > 40) { fseek(file, size - 40, SEEK_CUR); }
+      format = wav_u16(fmt);
+      chn    = wav_u16(fmt + 2);
+      sr     = wav_u32(fmt + 4);
+      bits   = wav_u16(fmt + 14);
+      if ((format == WAV_FMT_EXTENSIBLE) && (size >= 26)) { format = wav_u16(fmt + 24); }
+    }
+
+    else if (!memcmp(chunk, "data", 4)) {
+
+      if ((chn == 0) || ((format != WAV_FMT_PCM) && (format != WAV_FMT_FLOAT))
+        || ((format == WAV_FMT_PCM) && (bits != 16) && (bits != 24) && (bits != 32))
+        || ((format == WAV_FMT_FLOAT) && (bits != 32))) { break; }
+
+      t_int32  bytes = bits / 8;
+      long     n = size / (bytes * chn);
+      t_uint8* raw = (t_uint8*)sysmem_newptr(n * chn * bytes);
+      data = (float*)sysmem_newptr((n ? n : 1) * chn * sizeof(float));
+
+      if ((raw == NULL) || (data == NULL) || (fread(raw, bytes, n * chn, file) != (size_t)(n * chn))) {
+        if (raw) { sysmem_freeptr(raw); }
+        if (data) { sysmem_freeptr(data); }
+        data = NULL;
+        break;
+      }
+
+      for (long i = 0; i < n * chn; i++) {
+        t_uint8* p = raw + i * bytes;
+        if (format == WAV_FMT_FLOAT) { t_uint32 u = wav_u32(p); memcpy(data + i, &u, 4); }
+        else if (bits == 16) { data[i] = (t_int16)wav_u16(p) / 32768.f; }
+        else if (bits == 24) { data[i] = (float)((t_int32)((p[0] << 8) | (p[1] << 16) | ((t_uint32)p[2] << 24)) >> 8) / 8388608.f; }
+        else { data[i] = (float)((t_int32)wav_u32(p) / 2147483648.); }
+      }
+
+      sysmem_freeptr(raw);
+
+      *n_chn = chn;
+      *n_frm = n;
+      *samplerate = sr;
+      break;
+    }
+
+    else { fseek(file, size + (size & 1), SEEK_CUR); }
+  }
+
+  fclose(file);
+  return data;
+}
+
+// ====  PROCEDURE: WAV_WRITE  ====
+// Write interleaved floats as 16 or 24 bit integers, clipped, or as 32 bit floats
+// RETURNS: MAX_ERR_NONE, or MAX_ERR_GENERIC if the file cannot be written
+
+t_max_err wav_write(const char* path, const float* data, long n_chn, long n_frm, double samplerate, short bits) {
+
+  if ((bits != 16) && (bits != 24) && (bits != 32)) { return MAX_ERR_GENERIC; }
+
+  FILE* file = fopen(path, "wb");
+  if (file == NULL) { return MAX_ERR_GENERIC; }
+
+  t_int32  bytes = bits / 8;
+  t_uint32 size = (t_uint32)(n_frm * n_chn * bytes);
+  t_uint8  hdr[44];
+
+  memcpy(hdr, "RIFF", 4);     wav_put32(hdr + 4, 36 + size);
+  memcpy(hdr + 8, "WAVEfmt ", 8);
+  wav_put32(hdr + 16, 16);
+  wav_put16(hdr + 20, (bits == 32) ? WAV_FMT_FLOAT : WAV_FMT_PCM);
+  wav_put16(hdr + 22, (t_uint16)n_chn);
+  wav_put32(hdr + 24, (t_uint32)samplerate);
+  wav_put32(hdr + 28, (t_uint32)(samplerate * n_chn * bytes));
+  wav_put16(hdr + 32, (t_uint16)(n_chn * bytes));
+  wav_put16(hdr + 34, (t_uint16)bits);
+  memcpy(hdr + 36, "data", 4); wav_put32(hdr + 40, size);
+
+  t_bool ok = (fwrite(hdr, 1, 44, file) == 44);
+  t_uint8 p[4];
+  double  smp;
+
+  for (long i = 0; ok && (i < n_frm * n_chn); i++) {
+
+    smp = data[i];
+    if (bits == 32) { memcpy(p, data + i, 4); }
+    else {
+      if (smp > 1) { smp = 1; }
+      if (smp < -1) { smp = -1; }
+      t_int32 v = (t_int32)lrint(smp * ((bits == 16) ? 32767 : 8388607));
+      wav_put32(p, (t_uint32)v);
+    }
+
+    ok = (fwrite(p, 1, bytes, file) == (size_t)bytes);
+  }
+
+  fclose(file);
+  return (ok ? MAX_ERR_NONE : MAX_ERR_GENERIC);
+}
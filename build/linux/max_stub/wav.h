@@ -0,0 +1,19 @@
+#ifndef YC_STUB_WAV_H_
+#define YC_STUB_WAV_H_
+
+// ======== DESCRIPTION ======== //
+// Minimal RIFF WAVE reader and writer for the headless drivers: 16 and 24 bit integer and 32 bit float samples,
+// any number of channels, including the extensible format. Samples are interleaved floats in memory.
+
+// ========  HEADER FILE FOR THE WAV FILES  ========
+
+#include "ext.h"
+
+// ====  PROCEDURE DECLARATIONS  ====
+
+float*    wav_read  (const char* path, long* n_chn, long* n_frm, double* samplerate);
+t_max_err wav_write (const char* path, const float* data, long n_chn, long n_frm, double samplerate, short bits);
+
+// ========  END OF HEADER FILE  ========
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef YC_STUB_Z_DSP_H_
+#define YC_STUB_Z_DSP_H_
+
+// ========  HEADER FILE FOR THE MAX STUB: MSP  ========
+
+#include "ext.h"
+
+typedef struct _pxobject { t_object z_ob; long z_misc; } t_pxobject;
+
+#define Z_NO_INPLACE 1
+
+void  dsp_setup       (t_pxobject* x, long n_in);
+void  dsp_free        (t_pxobject* x);
+void  class_dspinit   (t_class* c);
+short sys_getdspstate (void);
+short sys_getdspobjdspstate (t_object* x);
+double sys_getsr      (void);
+
+// ========  END OF HEADER FILE  ========
+
+#endif
@@ -0,0 +1,348 @@
+// ======== DESCRIPTION ======== //
+// Headless profiling run: renders a few representative scenarios offline, one object each, and reports next to the
+// timings the hardware counters of the render read with perf_event_open: cycles, instructions, L1 data read misses,
+// last level cache misses and branch misses, the instructions per cycle, and the misses and cycles per grain-sample,
+// a grain-sample being one sample of one grain, as counted by the load accounting of the object.
+// The counters the kernel does not give, in a virtual machine or with a restrictive perf_event_paranoid, show as n/a.
+//
+// Usage:  granular_perf [-s samplerate] [-v vector size] [-d ms] [-b file.wav] [-p] [scenario]...
+//   -d ms         Duration of each render, 10000 ms by default
+//   -b file.wav   Source of all the scenarios instead of the generated ones
+//   -p            Print the posts of the objects
+//   scenario      sparse, dense, transposed or cloud, all of them by default
+
+#include "max_stub.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <stddef.h>
+#include <unistd.h>
+
+#define PERF_CNT_N    8       // Counters read around each render
+
+int granular_main(void);
+
+// ====  SCENARIOS  ====
+// Sources of src_sec seconds, one per seeder. With begin_ms, the score moves the beginning of every seeder to a
+// random position every begin_ms, for a cloud of grains spread over the whole source.
+
+typedef struct _perf_scenario {
+
+  const char* name;
+  t_int16     n_seeders;
+  double      src_sec;
+  const char* seeder;       // Arguments of set_seeder after the index
+  double      shift_oct;    // Shift added per seeder, alternating up and down
+  double      begin_ms;
+
+} t_perf_scenario;
+
+static const t_perf_scenario perf_scenarios[] = {
+  { "sparse",     1,  4, "0.5 0.2 80 0 1 1 0 1",       0,    0 },
+  { "dense",      8,  4, "0.1 0.2 60 0 0.25 1 0.2 8",  0,    0 },
+  { "transposed", 4,  4, "0.2 0.2 60 0 0.5 1 0.2 4",   0.7,  0 },
+  { "cloud",      8,  60, "0.1 0.5 40 0 0.25 0 0.5 8", 0,    10 },
+};
+
+#define PERF_SCENARIOS_N  (sizeof(perf_scenarios) / sizeof(t_perf_scenario))
+
+// ====  COUNTERS  ====
+
+typedef struct _perf_cnt {
+
+  const char* name;
+  t_uint32    type;
+  t_uint64    config;
+  int         fd;           // -1 when not available
+  t_uint64    value;
+
+} t_perf_cnt;
+
+enum { CNT_CYCLES, CNT_INSTR, CNT_L1D, CNT_LLC, CNT_BRANCH, CNT_TASK_CLOCK, CNT_FAULTS, CNT_SWITCHES };
+
+static t_perf_cnt perf_cnts[PERF_CNT_N] = {
+  { "cycles",       PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { "L1D misses",   PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                          | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+  { "LLC misses",   PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+  { "branch misses",PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+  { "task clock ns",PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+  { "page faults",  PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+  { "switches",     PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+};
+
+// ====  PROCEDURE: PERF_OPEN  ====
+// Open the counters of the calling thread, disabled, user space only
+
+void perf_open(void) {
+
+  struct perf_event_attr attr;
+
+  for (t_int16 c = 0; c < PERF_CNT_N; c++) {
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = perf_cnts[c].type;
+    attr.config         = perf_cnts[c].config;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+
+    perf_cnts[c].fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+}
+
+// ====  PROCEDURE: PERF_START / PERF_STOP  ====
+
+void perf_start(void) {
+
+  for (t_int16 c = 0; c < PERF_CNT_N; c++) {
+    if (perf_cnts[c].fd < 0) { continue; }
+    ioctl(perf_cnts[c].fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(perf_cnts[c].fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+}
+
+void perf_stop(void) {
+
+  for (t_int16 c = 0; c < PERF_CNT_N; c++) {
+    if (perf_cnts[c].fd < 0) { continue; }
+    ioctl(perf_cnts[c].fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(perf_cnts[c].fd, &perf_cnts[c].value, sizeof(t_uint64)) != sizeof(t_uint64)) { perf_cnts[c].value = 0; }
+  }
+}
+
+// ====  PROCEDURE: PERF_PRINT  ====
+// Print a counter, and its value per unit when per is not 0
+
+void perf_print(t_int16 c, double per, const char* per_name) {
+
+  if (perf_cnts[c].fd < 0) { printf("  %-14s %14s\n", perf_cnts[c].name, "n/a"); return; }
+
+  printf("  %-14s %14llu", perf_cnts[c].name, (unsigned long long)perf_cnts[c].value);
+  if (per > 0) { printf("   %10.4f per %s", perf_cnts[c].value / per, per_name); }
+  printf("\n");
+}
+
+// ====  CAPTURE OF THE OUTLETS AND POSTS  ====
+
+typedef struct _perf_capture {
+
+  t_uint64  grains;
+  t_uint64  smp;
+  t_int32   err_cnt;
+  t_bool    verbose;
+
+} t_perf_capture;
+
+// ====  PROCEDURE: PERF_OUTLET  ====
+// Sum the grains and grain-samples of all the seeders in the seeder_load message
+
+void perf_outlet(void* ctx, t_object* x, void* outlet, t_symbol* s, long argc, t_atom* argv) {
+
+  t_perf_capture* cap = (t_perf_capture*)ctx;
+
+  if (s != gensym("seeder_load")) { return; }
+
+  for (long a = 1; a + 4 < argc; a += 5) {
+    cap->grains += (t_uint64)atom_getlong(argv + a + 2);
+    cap->smp    += (t_uint64)atom_getlong(argv + a + 3);
+  }
+}
+
+void perf_post(void* ctx, t_object* x, const char* str) {
+
+  t_perf_capture* cap = (t_perf_capture*)ctx;
+
+  if (strstr(str, "ERROR")) { cap->err_cnt++; }
+  if (cap->verbose || strstr(str, "ERROR")) { printf("  post:  %s\n", str); }
+}
+
+// ====  PROCEDURE: PERF_SOURCE  ====
+// Fill a buffer with partials and noise under a slow amplitude modulation, so that every region of it sounds
+
+void perf_source(t_buffer_obj* buff, double samplerate, double freq) {
+
+  float*      smp = buffer_locksamples(buff);
+  t_atom_long n   = buffer_getframecount(buff);
+
+  for (t_atom_long i = 0; i < n; i++) {
+    double t = i / samplerate;
+    smp[i] = (float)((0.6 + 0.4 * sin(TWOPI * 0.3 * t)) * (0.3 * sin(TWOPI * freq * t)
+      + 0.15 * sin(TWOPI * 2.01 * freq * t) + 0.05 * (2.0 * rand() / RAND_MAX - 1)));
+  }
+
+  buffer_unlocksamples(buff);
+}
+
+// ====  PROCEDURE: PERF_SCORE  ====
+// Write the score of the random beginnings of a scenario
+// RETURNS: true if the score was written
+
+t_bool perf_score(const t_perf_scenario* scn, double ms, const char* path) {
+
+  FILE* file = fopen(path, "w");
+  if (file == NULL) { return false; }
+
+  for (double t = 0; t < ms; t += scn->begin_ms) {
+    for (t_int16 i = 0; i < scn->n_seeders; i++) { fprintf(file, "%.3f, begin %i %.5f;\n", t, i, (double)rand() / RAND_MAX); }
+  }
+
+  return (fclose(file) == 0);
+}
+
+// ====  PROCEDURE: PERF_RUN  ====
+// Set up the object of a scenario, render it with the counters on, and print the report
+// RETURNS: true if the object posted no error
+
+t_bool perf_run(const t_perf_scenario* scn, double samplerate, long vec_len, double ms, const char* file,
+  t_perf_capture* cap) {
+
+  char   line[MAX_PATH_CHARS + 64];
+  char   score[MAX_PATH_CHARS];
+  t_atom av[2];
+
+  atom_setlong(av, scn->n_seeders);
+  atom_setlong(av + 1, 1024);
+
+  t_object* x = stub_new("y.granular~", 2, av);
+  if (x == NULL) { return false; }
+
+  // The object seeds the random generator with the time when created: the same sources and scores on every run
+  srand(1);
+
+  memset(cap, 0, offsetof(t_perf_capture, verbose));
+
+  for (t_int16 i = 0; i < scn->n_seeders; i++) {
+
+    snprintf(line, sizeof(line), "perf_%s_%i", scn->name, i);
+    t_buffer_obj* buff = stub_buffer_new(line, 1, (t_atom_long)(scn->src_sec * samplerate), samplerate);
+
+    if (file && (stub_buffer_read(buff, file) != MAX_ERR_NONE)) { object_free(x); return false; }
+    if (!file) { perf_source(buff, samplerate, 110. * (i + 1)); }
+
+    snprintf(line, sizeof(line), "buffer %i perf_%s_%i", i, scn->name, i);
+    stub_send_line(x, line);
+    snprintf(line, sizeof(line), "set_seeder %i %s", i, scn->seeder);
+    stub_send_line(x, line);
+    snprintf(line, sizeof(line), "shift %i %f", i, ((i % 2) ? -1 : 1) * scn->shift_oct * (1 + i / 2));
+    stub_send_line(x, line);
+    snprintf(line, sizeof(line), "seeder_on %i", i);
+    stub_send_line(x, line);
+  }
+
+  stub_send_line(x, "autogain 0.25 4");
+  stub_send_line(x, "load 1");
+
+  stub_dsp_start(x, samplerate, vec_len);
+  stub_dsp_stop(x);
+
+  snprintf(line, sizeof(line), "perf_%s_out", scn->name);
+  stub_buffer_new(line, 1, 0, samplerate);
+
+  if (scn->begin_ms > 0) {
+    snprintf(score, sizeof(score), "/tmp/granular_perf_%i_%s.txt", (t_int32)getpid(), scn->name);
+    if (!perf_score(scn, ms, score)) { object_free(x); return false; }
+    snprintf(line, sizeof(line), "render perf_%s_out %f score \"%s\"", scn->name, ms, score);
+  }
+  else {
+    snprintf(line, sizeof(line), "render perf_%s_out %f", scn->name, ms);
+  }
+
+  // The counters cover the render only, the setup and the sources being made before
+  double time_begin = systimer_gettime();
+  perf_start();
+  stub_send_line(x, line);
+  perf_stop();
+  double time_ms = systimer_gettime() - time_begin;
+
+  if (scn->begin_ms > 0) { remove(score); }
+
+  stub_send_line(x, "get_seeder_load");
+  object_free(x);
+
+  double gs = (double)cap->smp;
+
+  printf("%s:  %i seeders, sources of %.0f s - %.0f ms rendered in %.1f ms - Realtime factor: %.1f\n", scn->name,
+    scn->n_seeders, (file ? 0 : scn->src_sec), ms, time_ms, ((time_ms > 0) ? ms / time_ms : 0));
+  printf("  %-14s %14llu   %10.3f added per vector cycle\n", "grains", (unsigned long long)cap->grains,
+    cap->grains / (ms * samplerate / 1000. / vec_len));
+  printf("  %-14s %14llu   %10.4f ns per grain-sample\n", "grain-samples", (unsigned long long)cap->smp,
+    ((gs > 0) ? 1e6 * time_ms / gs : 0));
+
+  perf_print(CNT_CYCLES, gs, "grain-sample");
+  perf_print(CNT_INSTR, gs, "grain-sample");
+
+  if ((perf_cnts[CNT_CYCLES].fd >= 0) && (perf_cnts[CNT_INSTR].fd >= 0) && perf_cnts[CNT_CYCLES].value) {
+    printf("  %-14s %14.3f\n", "IPC", (double)perf_cnts[CNT_INSTR].value / perf_cnts[CNT_CYCLES].value);
+  }
+  else {
+    printf("  %-14s %14s\n", "IPC", "n/a");
+  }
+
+  perf_print(CNT_L1D, gs, "grain-sample");
+  perf_print(CNT_LLC, gs, "grain-sample");
+  perf_print(CNT_BRANCH, gs, "grain-sample");
+  perf_print(CNT_TASK_CLOCK, 0, NULL);
+  perf_print(CNT_FAULTS, 0, NULL);
+  perf_print(CNT_SWITCHES, 0, NULL);
+
+  return (cap->err_cnt == 0);
+}
+
+void perf_usage(void) {
+
+  fprintf(stderr, "Usage:  granular_perf [-s samplerate] [-v vector size] [-d ms] [-b file.wav] [-p] [scenario]...\n");
+}
+
+int main(int argc, char** argv) {
+
+  double  samplerate = 44100;
+  long    vec_len = 64;
+  double  ms = 10000;
+  char*   file = NULL;
+  int     opt;
+  t_bool  ok = true;
+
+  t_perf_capture cap = { 0, 0, 0, false };
+
+  while ((opt = getopt(argc, argv, "s:v:d:b:p")) != -1) {
+    switch (opt) {
+    case 's': samplerate = atof(optarg); break;
+    case 'v': vec_len = atol(optarg); break;
+    case 'd': ms = atof(optarg); break;
+    case 'b': file = optarg; break;
+    case 'p': cap.verbose = true; break;
+    default: perf_usage(); return 2;
+    }
+  }
+
+  if ((ms <= 0) || (vec_len < 1)) { perf_usage(); return 2; }
+
+  stub_init(samplerate, granular_main);
+  stub_outlet_hook(perf_outlet, &cap);
+  stub_post_hook(perf_post, &cap);
+
+  perf_open();
+
+  if (perf_cnts[CNT_CYCLES].fd < 0) {
+    printf("granular_perf:  No hardware counters, the misses and cycles show as n/a\n");
+  }
+
+  for (t_int16 s = 0; s < (t_int16)PERF_SCENARIOS_N; s++) {
+
+    t_bool chosen = (optind >= argc);
+    for (int a = optind; a < argc; a++) { if (!strcmp(argv[a], perf_scenarios[s].name)) { chosen = true; } }
+
+    if (chosen && !perf_run(perf_scenarios + s, samplerate, vec_len, ms, file, &cap)) {
+      fprintf(stderr, "granular_perf:  Scenario %s failed\n", perf_scenarios[s].name);
+      ok = false;
+    }
+  }
+
+  for (t_int16 c = 0; c < PERF_CNT_N; c++) { if (perf_cnts[c].fd >= 0) { close(perf_cnts[c].fd); } }
+
+  return (ok ? 0 : 1);
+}
@@ -0,0 +1,225 @@
+// ======== DESCRIPTION ======== //
+// Headless offline renderer: loads WAV files into named buffers, and renders jobs in parallel, one object and one
+// thread per job, each job writing a WAV file. A job is an output file, optionally followed by a render score.
+// The setup messages are sent to the object of every job before its render, like a loadbang in a patch.
+//
+// Usage:  granular_render [options] -d ms out.wav[:score.txt]...
+//   -d ms            Duration of each render in ms
+//   -b name=file     Load a WAV file into a buffer, shared by all the jobs. Can be repeated.
+//   -m "message"     Setup message sent to each object, for instance "buffer 0 src". Can be repeated.
+//   -j threads       Number of jobs rendered at the same time, the number of cores by default
+//   -s samplerate    44100 by default
+//   -v vector size   64 by default
+//   -n seeders       Maximum number of seeders of each object, 16 by default
+//   -g grains        Maximum number of grains of each object, 1024 by default
+//   -t bits          Bits of the output files: 16, 24, or 32 for floats, 24 by default
+//   -r seed          Seed of the random generator, other than 0, set again for each job
+//
+// A render is a sequence of vector cycles that each depend on the state left by the previous one, so one job
+// renders on one core: the cores are used by rendering several jobs at the same time. The random generator is
+// shared, so the output of a job only repeats from run to run with one thread.
+
+#include "max_stub.h"
+#include "ext_atomic.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+#define RENDER_JOBS_MAX   256
+#define RENDER_FILES_MAX  64
+#define RENDER_MESS_MAX   256
+
+int granular_main(void);
+
+// ====  STRUCTURE DECLARATIONS  ====
+
+typedef struct _render_job {
+
+  t_int32     index;
+  char*       out_path;
+  char*       score_path;     // NULL without score
+  t_object*       x;
+  t_int32_atomic  err_cnt;    // Errors posted by the object of the job
+
+} t_render_job;
+
+typedef struct _render {
+
+  double          samplerate;
+  long            vec_len;
+  long            n_seeders;
+  long            n_grains;
+  double          ms;
+  short           bits;
+  long            seed;         // Seed of the random generator, 0 for none
+  char*           mess[RENDER_MESS_MAX];
+  long            n_mess;
+  t_render_job    jobs[RENDER_JOBS_MAX];
+  long            n_jobs;
+  t_int32_atomic  next;         // Next job to render
+  t_int32_atomic  failed;       // Number of jobs that failed
+
+} t_render;
+
+// ====  PROCEDURE: RENDER_POST  ====
+// Print the posts with the output file of the job they come from, and count its errors. Called from the threads
+// of all the jobs.
+
+void render_post(void* ctx, t_object* x, const char* str) {
+
+  t_render* r = (t_render*)ctx;
+
+  for (long j = 0; j < r->n_jobs; j++) {
+    if (__atomic_load_n(&r->jobs[j].x, __ATOMIC_ACQUIRE) == x) {
+      if (strstr(str, "ERROR")) { ATOMIC_INCREMENT(&r->jobs[j].err_cnt); }
+      printf("%s:  %s\n", r->jobs[j].out_path, str);
+      return;
+    }
+  }
+
+  printf("granular_render:  %s\n", str);
+}
+
+// ====  PROCEDURE: RENDER_JOB  ====
+// Create the object of a job, send the setup messages, render into the output buffer of the job and write it
+// RETURNS: true if the object posted no error and the output file was written
+
+t_bool render_job(t_render* r, t_render_job* job) {
+
+  char   name[32], line[MAX_PATH_CHARS + 64];
+  t_atom av[2];
+
+  atom_setlong(av, r->n_seeders);
+  atom_setlong(av + 1, r->n_grains);
+
+  t_object* x = stub_new("y.granular~", 2, av);
+  if (x == NULL) { return false; }
+  __atomic_store_n(&job->x, x, __ATOMIC_RELEASE);
+
+  // The object seeds the random generator with the time when created
+  if (r->seed) { srand((unsigned)r->seed); }
+
+  for (long m = 0; m < r->n_mess; m++) {
+    if (stub_send_line(x, r->mess[m]) != MAX_ERR_NONE) { return false; }
+  }
+
+  // The DSP is turned on once to set the samplerate and vector size: the render runs with it off
+  stub_dsp_start(x, r->samplerate, r->vec_len);
+  stub_dsp_stop(x);
+
+  snprintf(name, sizeof(name), "render~%i", job->index);
+  t_buffer_obj* buff = stub_buffer_new(name, 1, 0, r->samplerate);
+
+  if (job->score_path) { snprintf(line, sizeof(line), "render %s %f score \"%s\"", name, r->ms, job->score_path); }
+  else { snprintf(line, sizeof(line), "render %s %f", name, r->ms); }
+
+  stub_send_line(x, line);
+
+  // The render method reports its errors in posts
+  if (job->err_cnt) { return false; }
+
+  return (stub_buffer_write(buff, job->out_path, r->bits) == MAX_ERR_NONE);
+}
+
+// ====  PROCEDURE: RENDER_THREAD  ====
+// Take the jobs in turn until there are none left
+
+void* render_thread(void* arg) {
+
+  t_render* r = (t_render*)arg;
+  t_int32   j;
+
+  while ((j = ATOMIC_INCREMENT(&r->next) - 1) < r->n_jobs) {
+
+    t_render_job* job = r->jobs + j;
+
+    if (!render_job(r, job)) { ATOMIC_INCREMENT(&r->failed); fprintf(stderr, "granular_render:  Job %s failed\n", job->out_path); }
+  }
+
+  return NULL;
+}
+
+void render_usage(void) {
+
+  fprintf(stderr, "Usage:  granular_render [-b name=file.wav]... [-m \"message\"]... [-j threads] [-s samplerate]"
+    " [-v vector size] [-n seeders] [-g grains] [-t bits] [-r seed] -d ms out.wav[:score.txt]...\n");
+}
+
+int main(int argc, char** argv) {
+
+  static t_render r;
+  char*  files[RENDER_FILES_MAX];
+  long   n_files = 0;
+  long   n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int    opt;
+
+  r.samplerate = 44100;
+  r.vec_len    = 64;
+  r.n_seeders  = 16;
+  r.n_grains   = 1024;
+  r.bits       = 24;
+
+  while ((opt = getopt(argc, argv, "d:b:m:j:s:v:n:g:t:r:")) != -1) {
+    switch (opt) {
+    case 'd': r.ms = atof(optarg); break;
+    case 'b': if (n_files < RENDER_FILES_MAX) { files[n_files++] = optarg; } break;
+    case 'm': if (r.n_mess < RENDER_MESS_MAX) { r.mess[r.n_mess++] = optarg; } break;
+    case 'j': n_threads = atol(optarg); break;
+    case 's': r.samplerate = atof(optarg); break;
+    case 'v': r.vec_len = atol(optarg); break;
+    case 'n': r.n_seeders = atol(optarg); break;
+    case 'g': r.n_grains = atol(optarg); break;
+    case 't': r.bits = (short)atol(optarg); break;
+    case 'r': r.seed = atol(optarg); break;
+    default: render_usage(); return 2;
+    }
+  }
+
+  if ((r.ms <= 0) || (optind >= argc) || (argc - optind > RENDER_JOBS_MAX) || (n_threads < 1) || (r.vec_len < 1)
+    || ((r.bits != 16) && (r.bits != 24) && (r.bits != 32))) {
+    render_usage();
+    return 2;
+  }
+
+  stub_init(r.samplerate, granular_main);
+  stub_post_hook(render_post, &r);
+
+  // Load the sources
+  for (long f = 0; f < n_files; f++) {
+
+    char* eq = strchr(files[f], '=');
+    if (eq == NULL) { render_usage(); return 2; }
+
+    *eq = 0;
+    if (stub_buffer_read(stub_buffer_new(files[f], 1, 0, r.samplerate), eq + 1) != MAX_ERR_NONE) { return 2; }
+  }
+
+  // The jobs
+  for (int a = optind; a < argc; a++) {
+
+    t_render_job* job = r.jobs + r.n_jobs;
+    char*         colon = strchr(argv[a], ':');
+
+    job->index      = (t_int32)r.n_jobs++;
+    job->out_path   = argv[a];
+    job->score_path = (colon ? colon + 1 : NULL);
+    if (colon) { *colon = 0; }
+  }
+
+  if (n_threads > r.n_jobs) { n_threads = r.n_jobs; }
+
+  pthread_t threads[RENDER_JOBS_MAX];
+  double    time_begin = systimer_gettime();
+
+  for (long t = 0; t < n_threads; t++) { pthread_create(threads + t, NULL, render_thread, &r); }
+  for (long t = 0; t < n_threads; t++) { pthread_join(threads[t], NULL); }
+
+  double time_ms = systimer_gettime() - time_begin;
+
+  printf("granular_render:  %li jobs of %.0f ms on %li threads in %.1f ms - Realtime factor: %.1f\n", r.n_jobs, r.ms,
+    n_threads, time_ms, ((time_ms > 0) ? r.n_jobs * r.ms / time_ms : 0));
+
+  for (long j = 0; j < r.n_jobs; j++) { if (r.jobs[j].x) { object_free(r.jobs[j].x); } }
+
+  return (r.failed ? 1 : 0);
+}
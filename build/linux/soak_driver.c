@@ -0,0 +1,134 @@
+// ======== DESCRIPTION ======== //
+// Headless soak run: sets up seeders on generated or given sources, runs the soak method of the object for a
+// simulated duration, and exits with an error if any of its checks failed: grain count, begin bounds, play position
+// drift, output range, memory, or a vector cycle over the render budget. The summary is posted as in Max.
+//
+// Usage:  granular_soak [-s samplerate] [-v vector size] [-n seeders] [-b file.wav]... seconds [seed] [budget]
+
+#include "max_stub.h"
+
+#include <unistd.h>
+
+#define SOAK_SEEDERS  4       // Seeders on during the run, by default
+
+int granular_main(void);
+
+// ====  RESULT OF THE RUN  ====
+
+typedef struct _soak_result {
+
+  t_bool  done;
+  t_bool  passed;
+
+} t_soak_result;
+
+// ====  PROCEDURE: SOAK_OUTLET  ====
+// Catch the "soak <passed>" message sent at the end of the run
+
+void soak_outlet(void* ctx, t_object* x, void* outlet, t_symbol* s, long argc, t_atom* argv) {
+
+  t_soak_result* result = (t_soak_result*)ctx;
+
+  if ((s == gensym("soak")) && (argc == 1)) {
+    result->passed = (atom_getlong(argv) != 0);
+    result->done   = true;
+  }
+}
+
+// ====  PROCEDURE: SOAK_SOURCE  ====
+// Fill a buffer with a few partials and some noise, so that the normalization and the envelopes see real content
+
+void soak_source(t_buffer_obj* buff, double samplerate, double freq) {
+
+  float*      smp = buffer_locksamples(buff);
+  t_atom_long n   = buffer_getframecount(buff);
+
+  for (t_atom_long i = 0; i < n; i++) {
+    double t = i / samplerate;
+    smp[i] = (float)(0.3 * sin(TWOPI * freq * t) + 0.15 * sin(TWOPI * 2.01 * freq * t)
+      + 0.05 * (2.0 * rand() / RAND_MAX - 1));
+  }
+
+  buffer_unlocksamples(buff);
+}
+
+int main(int argc, char** argv) {
+
+  double  samplerate = 44100;
+  long    vec_len = 64;
+  long    n_seeders = SOAK_SEEDERS;
+  char*   files[16];
+  long    n_files = 0;
+  char    line[MAX_PATH_CHARS + 64];
+  int     opt;
+
+  while ((opt = getopt(argc, argv, "s:v:n:b:")) != -1) {
+    switch (opt) {
+    case 's': samplerate = atof(optarg); break;
+    case 'v': vec_len = atol(optarg); break;
+    case 'n': n_seeders = atol(optarg); break;
+    case 'b': if (n_files < 16) { files[n_files++] = optarg; } break;
+    default:
+      fprintf(stderr, "Usage:  granular_soak [-s samplerate] [-v vector size] [-n seeders] [-b file.wav]... seconds [seed] [budget]\n");
+      return 2;
+    }
+  }
+
+  if (optind >= argc) {
+    fprintf(stderr, "Usage:  granular_soak [-s samplerate] [-v vector size] [-n seeders] [-b file.wav]... seconds [seed] [budget]\n");
+    return 2;
+  }
+
+  stub_init(samplerate, granular_main);
+
+  t_soak_result result = { false, false };
+  stub_outlet_hook(soak_outlet, &result);
+
+  t_atom av[2];
+  atom_setlong(av, n_seeders);
+  atom_setlong(av + 1, 512);
+
+  t_object* x = stub_new("y.granular~", 2, av);
+  if (x == NULL) { fprintf(stderr, "granular_soak:  Unable to create the object\n"); return 2; }
+
+  // One source per seeder: the given files in turn, or generated ones
+  static const char* envs[] = { "hann", "tukey", "expodec", "blackman" };
+
+  for (long i = 0; i < n_seeders; i++) {
+
+    snprintf(line, sizeof(line), "soak%li", i);
+    t_buffer_obj* buff = stub_buffer_new(line, 1, (t_atom_long)(4 * samplerate), samplerate);
+
+    if (n_files && (stub_buffer_read(buff, files[i % n_files]) != MAX_ERR_NONE)) { return 2; }
+    if (!n_files) { soak_source(buff, samplerate, 110. * (i + 1)); }
+
+    snprintf(line, sizeof(line), "buffer %li soak%li", i, i);
+    stub_send_line(x, line);
+    snprintf(line, sizeof(line), "envelope %li %s", i, envs[i % 4]);
+    stub_send_line(x, line);
+    snprintf(line, sizeof(line), "set_seeder %li 0.3 0.2 60 0 0.5 1 0.2 4", i);
+    stub_send_line(x, line);
+    snprintf(line, sizeof(line), "seeder_on %li", i);
+    stub_send_line(x, line);
+  }
+
+  // The random changes of the run reach dense overlaps: the automatic gain keeps the output within range, as in a patch
+  stub_send_line(x, "autogain 0.25 4");
+
+  // The DSP is turned on once to set the samplerate and vector size, the soak runs with it off
+  stub_dsp_start(x, samplerate, vec_len);
+  stub_dsp_stop(x);
+
+  snprintf(line, sizeof(line), "soak %s %s %s", argv[optind], ((optind + 1 < argc) ? argv[optind + 1] : "1"),
+    ((optind + 2 < argc) ? argv[optind + 2] : "1."));
+
+  if (stub_send_line(x, line) != MAX_ERR_NONE) { return 2; }
+
+  // The run goes on in slices from a queue element
+  while (!result.done && stub_idle_pending()) { stub_idle(); }
+
+  object_free(x);
+
+  if (!result.done) { fprintf(stderr, "granular_soak:  The run did not start\n"); return 2; }
+  return (result.passed ? 0 : 1);
+}
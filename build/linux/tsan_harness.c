@@ -0,0 +1,196 @@
+// ======== DESCRIPTION ======== //
+// Thread harness for the lock-free handoffs between the message thread and the audio thread, built with
+// -fsanitize=thread. The audio thread runs the perform routine back to back. The main thread, which stands for
+// both the message thread and the low priority queue, sends random set_seeder, envelope, file, poly, seeder_on,
+// seeder_off and get_seeder_load messages and runs the deferred tasks. Any data race is reported by the sanitizer,
+// which then exits with an error.
+//
+// Usage:  granular_tsan [seconds] [seed]
+
+#include "max_stub.h"
+#include "ext_atomic.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+#define SEEDERS_N   4       // Seeders used by the harness
+#define BUFF_N      2       // Source buffers
+#define SR          44100
+#define VEC_LEN     64
+
+int granular_main(void);
+
+// ====  STATE SHARED WITH THE AUDIO THREAD  ====
+
+typedef struct _harness {
+
+  t_object*       x;
+  t_int32_atomic  running;
+  t_int32_atomic  cycles;
+
+} t_harness;
+
+static t_int32_atomic post_cnt = 0;
+static t_int32_atomic err_cnt  = 0;
+static t_bool verbose = false;
+
+// ====  PROCEDURE: HARNESS_POST  ====
+// Count the posts, the errors being the ones the object writes with its error prefix. Called from both threads.
+
+void harness_post(void* ctx, t_object* x, const char* str) {
+
+  ATOMIC_INCREMENT(&post_cnt);
+  if (strstr(str, "ERROR") || strstr(str, "Unable")) { ATOMIC_INCREMENT(&err_cnt); }
+  if (verbose) { fprintf(stderr, "post:  %s\n", str); }
+}
+
+// ====  PROCEDURE: HARNESS_AUDIO  ====
+// The audio thread: vector cycles until stopped
+
+void* harness_audio(void* arg) {
+
+  t_harness* h = (t_harness*)arg;
+  double     in[VEC_LEN] = { 0 };
+  double     out[VEC_LEN];
+
+  while (__atomic_load_n(&h->running, __ATOMIC_ACQUIRE)) {
+    stub_perform(h->x, in, out, VEC_LEN);
+    __atomic_add_fetch(&h->cycles, 1, __ATOMIC_RELAXED);
+  }
+
+  return NULL;
+}
+
+// ====  PROCEDURE: HARNESS_SOURCE  ====
+// Fill a buffer with a decaying chirp, and write it to a file for the file messages
+
+void harness_source(t_buffer_obj* buff, const char* path, double freq) {
+
+  float*      smp = buffer_locksamples(buff);
+  t_atom_long n   = buffer_getframecount(buff);
+
+  for (t_atom_long i = 0; i < n; i++) {
+    smp[i] = (float)(0.5 * exp(-2. * i / n) * sin(TWOPI * freq * i / SR * (1 + (double)i / n)));
+  }
+
+  buffer_unlocksamples(buff);
+  stub_buffer_write(buff, path, 16);
+}
+
+// ====  PROCEDURE: HARNESS_MESSAGE  ====
+// Send one random message among the ones that hand a change to the audio thread
+
+void harness_message(t_object* x, t_uint32* seed, char paths[BUFF_N][MAX_PATH_CHARS]) {
+
+  static const char* envs[] = { "hann", "tukey", "expodec", "rectangular", "blackman", "trapezoidal" };
+  char    line[MAX_PATH_CHARS + 64];
+  t_int32 index = rand_r(seed) % SEEDERS_N;
+
+  switch (rand_r(seed) % 8) {
+
+  case 0:
+  case 1:
+    snprintf(line, sizeof(line), "set_seeder %i %f %f %f %f %f %f %f %i", index,
+      0.1 + 0.4 * rand_r(seed) / RAND_MAX, 100. * rand_r(seed) / RAND_MAX, 5 + 80. * rand_r(seed) / RAND_MAX,
+      -12 + 24. * rand_r(seed) / RAND_MAX, 2 + 30. * rand_r(seed) / RAND_MAX, 0.5 + 1. * rand_r(seed) / RAND_MAX,
+      0.5 * rand_r(seed) / RAND_MAX, 1 + rand_r(seed) % 8);
+    break;
+
+  case 2:
+    snprintf(line, sizeof(line), "envelope %i %s", index, envs[rand_r(seed) % 6]);
+    break;
+
+  case 3: {
+    t_int32 b = rand_r(seed) % BUFF_N;
+    snprintf(line, sizeof(line), "file %i src%i.wav \"%s\"", index, b, paths[b]);
+    break; }
+
+  case 4:
+    snprintf(line, sizeof(line), "poly %i %i", index, 1 + rand_r(seed) % 8);
+    break;
+
+  case 5:
+    snprintf(line, sizeof(line), "seeder_on %i", index);
+    break;
+
+  case 6:
+    snprintf(line, sizeof(line), "get_seeder_load");
+    break;
+
+  default:
+    snprintf(line, sizeof(line), "seeder_off %i", index);
+    break;
+  }
+
+  stub_send_line(x, line);
+}
+
+int main(int argc, char** argv) {
+
+  double   seconds = ((argc > 1) ? atof(argv[1]) : 5);
+  t_uint32 seed    = ((argc > 2) ? (t_uint32)atol(argv[2]) : 1);
+  char     paths[BUFF_N][MAX_PATH_CHARS];
+  char     line[64];
+  t_atom   av[2];
+
+  verbose = (getenv("HARNESS_VERBOSE") != NULL);
+
+  stub_init(SR, granular_main);
+  stub_post_hook(harness_post, NULL);
+
+  // Source buffers, and their files for the file messages
+  for (t_int16 b = 0; b < BUFF_N; b++) {
+    snprintf(line, sizeof(line), "src%i", b);
+    snprintf(paths[b], MAX_PATH_CHARS, "/tmp/granular_tsan_%i_%i.wav", (t_int32)getpid(), b);
+    harness_source(stub_buffer_new(line, 1, 2 * SR, SR), paths[b], 220. * (b + 1));
+  }
+
+  atom_setlong(av, SEEDERS_N);
+  atom_setlong(av + 1, 256);
+
+  t_harness h = { stub_new("y.granular~", 2, av), 1, 0 };
+  if (h.x == NULL) { fprintf(stderr, "granular_tsan:  Unable to create the object\n"); return 1; }
+
+  for (t_int16 i = 0; i < SEEDERS_N; i++) {
+    snprintf(line, sizeof(line), "buffer %i src%i", i, i % BUFF_N);
+    stub_send_line(h.x, line);
+    snprintf(line, sizeof(line), "set_seeder %i 0.3 10 40 0 8 1 0.2 4", i);
+    stub_send_line(h.x, line);
+    snprintf(line, sizeof(line), "seeder_on %i", i);
+    stub_send_line(h.x, line);
+  }
+
+  // The load counters are handed to the message thread at the end of each vector cycle
+  stub_send_line(h.x, "load 1");
+
+  // Run the audio thread while the main thread sends messages and runs the deferred tasks
+  pthread_t audio;
+
+  stub_dsp_start(h.x, SR, VEC_LEN);
+  pthread_create(&audio, NULL, harness_audio, &h);
+
+  double time_end = systimer_gettime() + seconds * 1000;
+  long   msg_cnt = 0;
+
+  while (systimer_gettime() < time_end) {
+    harness_message(h.x, &seed, paths);
+    msg_cnt++;
+    stub_idle();
+    usleep(200);
+  }
+
+  __atomic_store_n(&h.running, 0, __ATOMIC_RELEASE);
+  pthread_join(audio, NULL);
+
+  // The deferred file reads complete with the DSP off
+  stub_dsp_stop(h.x);
+  while (stub_idle_pending()) { stub_idle(); usleep(1000); }
+
+  object_free(h.x);
+  for (t_int16 b = 0; b < BUFF_N; b++) { remove(paths[b]); }
+
+  printf("granular_tsan:  %li messages, %i vector cycles, %i posts, %i errors\n", msg_cnt,
+    (t_int32)h.cycles, (t_int32)post_cnt, (t_int32)err_cnt);
+
+  return 0;
+}
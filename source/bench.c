@@ -0,0 +1,228 @@
+#include "bench.h"
+#include "max_util.h"
+#include "linked_list.h"
+#include "envelopes.h"
+
+// ========  MICROBENCHMARKS  ========
+
+// Sink for the computed values, so that the compiler keeps the loops
+static volatile t_double bench_sink;
+
+// ====  PROCEDURE: BENCH_PERMUTATION  ====
+// Fills an array with a pseudo-random permutation of 0 to n - 1, always the same one
+
+static void bench_permutation(t_int16* perm, t_int16 n) {
+
+  t_uint32 seed = 1;
+  t_int16  j, tmp;
+
+  for (t_int16 i = 0; i < n; i++) { perm[i] = i; }
+
+  for (t_int16 i = n - 1; i > 0; i--) {
+    seed = seed * 1664525 + 1013904223;
+    j = (t_int16)((seed >> 8) % (i + 1));
+    tmp = perm[i]; perm[i] = perm[j]; perm[j] = tmp;
+  }
+}
+
+// ====  PROCEDURE: BENCH_LIST  ====
+// Times the list operations on a list of n nodes, with the access patterns of the engine:
+//   - list_insert_first:  filling the list, as grains are added
+//   - list_remove_node:   removing every other node while walking the list, as grains end in the grain loop
+//   - list_remove_index:  removing nodes in random order by index, as seeders are turned off
+//   - list_prev_node:     finding the previous node of a random node
+// and the alternative of a dense array of indexes with swap-remove, as a structure of arrays pool would use.
+// RETURNS: The number of results written
+
+t_int16 bench_list(t_bench_result* res, t_int16 n, t_int32 n_rep) {
+
+  t_list*   list  = list_new(n);
+  t_int16*  perm  = (t_int16*)sysmem_newptr(n * sizeof(t_int16));
+  t_int16*  dense = (t_int16*)sysmem_newptr(n * sizeof(t_int16));
+  t_int16*  pos   = (t_int16*)sysmem_newptr(n * sizeof(t_int16));
+
+  if ((list == NULL) || (perm == NULL) || (dense == NULL) || (pos == NULL)) {
+    if (list) { list_free(list); }
+    if (perm) { sysmem_freeptr(perm); }
+    if (dense) { sysmem_freeptr(dense); }
+    if (pos) { sysmem_freeptr(pos); }
+    return 0;
+  }
+
+  bench_permutation(perm, n);
+
+  t_double  best[6] = { 1e300, 1e300, 1e300, 1e300, 1e300, 1e300 };
+  t_uint64  t[6];
+  t_uint64  ticks;
+  t_int16*  node;
+  t_int16   cnt, k;
+  t_int32   sum = 0;
+
+  for (t_int16 run = 0; run < BENCH_N_RUN; run++) {
+
+    for (t_int16 i = 0; i < 6; i++) { t[i] = 0; }
+
+    for (t_int32 rep = 0; rep < n_rep; rep++) {
+
+      // Fill
+      list_remove_all(list);
+      ticks = CYCLE_COUNT();
+      for (t_int16 i = 0; i < n; i++) { sum += list_insert_first(list); }
+      t[0] += CYCLE_COUNT() - ticks;
+
+      // Previous node of random nodes, on the full list
+      ticks = CYCLE_COUNT();
+      for (t_int16 i = 0; i < n; i++) { sum += *list_prev_node(list, list->array + perm[i]); }
+      t[3] += CYCLE_COUNT() - ticks;
+
+      // Remove every other node while walking, then the rest
+      ticks = CYCLE_COUNT();
+      node = list->first_used;
+      k = 0;
+      while (*node != LIST_END) {
+        if (k++ & 1) { sum += list_remove_node(list, node); }
+        else { node = list->array + *node; }
+      }
+      node = list->first_used;
+      while (*node != LIST_END) { sum += list_remove_node(list, node); }
+      t[1] += CYCLE_COUNT() - ticks;
+
+      // Remove by index in random order
+      for (t_int16 i = 0; i < n; i++) { list_insert_first(list); }
+      ticks = CYCLE_COUNT();
+      for (t_int16 i = 0; i < n; i++) { sum += list_remove_index(list, perm[i]); }
+      t[2] += CYCLE_COUNT() - ticks;
+
+      // Dense array: fill, then swap-remove in random order
+      cnt = 0;
+      ticks = CYCLE_COUNT();
+      for (t_int16 i = 0; i < n; i++) { pos[i] = cnt; dense[cnt++] = i; }
+      t[4] += CYCLE_COUNT() - ticks;
+
+      ticks = CYCLE_COUNT();
+      for (t_int16 i = 0; i < n; i++) {
+        k = pos[perm[i]];
+        dense[k] = dense[--cnt];
+        pos[dense[k]] = k;
+        sum += k;
+      }
+      t[5] += CYCLE_COUNT() - ticks;
+    }
+
+    for (t_int16 i = 0; i < 6; i++) {
+      if ((t_double)t[i] / ((t_double)n_rep * n) < best[i]) { best[i] = (t_double)t[i] / ((t_double)n_rep * n); }
+    }
+  }
+
+  bench_sink = sum;
+
+  res[0].name = "list_insert_first";            res[0].ticks = best[0];
+  res[1].name = "list_remove_node (walk)";      res[1].ticks = best[1];
+  res[2].name = "list_remove_index (random)";   res[2].ticks = best[2];
+  res[3].name = "list_prev_node (random)";      res[3].ticks = best[3];
+  res[4].name = "dense array insert";           res[4].ticks = best[4];
+  res[5].name = "dense array swap-remove";      res[5].ticks = best[5];
+
+  list_free(list);
+  sysmem_freeptr(perm);
+  sysmem_freeptr(dense);
+  sysmem_freeptr(pos);
+
+  return 6;
+}
+
+// ====  PROCEDURE: BENCH_ENV  ====
+// Times each envelope, ramp and crossfade function over n_smp increasing positions in [0, 1],
+// and the alternative of a linearly interpolated table of n_smp values, as the grain kernels read envelopes.
+// RETURNS: The number of results written
+
+t_int16 bench_env(t_bench_result* res, t_int16 n_smp, t_int32 n_rep) {
+
+  static const struct { const char* name; t_double(*func)(t_double, t_double, t_double); } envs[] = {
+    { "env_rectangular", env_rectangular }, { "env_triangular", env_triangular }, { "env_trapezoidal", env_trapezoidal },
+    { "env_welch", env_welch }, { "env_sine", env_sine }, { "env_hann", env_hann }, { "env_hamming", env_hamming },
+    { "env_blackman", env_blackman }, { "env_nuttal", env_nuttal }, { "env_blackman_nuttal", env_blackman_nuttal },
+    { "env_blackman_harris", env_blackman_harris }, { "env_flat_top", env_flat_top }, { "env_tukey", env_tukey },
+    { "env_expodec", env_expodec }, { "env_rexpodec", env_rexpodec } };
+
+  static const struct { const char* name; t_double(*func)(t_double, t_double); } ramps[] = {
+    { "ramp_linear", ramp_linear }, { "ramp_poly", ramp_poly }, { "ramp_poly_s", ramp_poly_s },
+    { "ramp_exp", ramp_exp }, { "ramp_exp_s", ramp_exp_s }, { "ramp_sigmoid", ramp_sigmoid },
+    { "xfade_linear", xfade_linear }, { "xfade_sqrt", xfade_sqrt }, { "xfade_sinus", xfade_sinus } };
+
+  t_int16 n_env  = (t_int16)(sizeof(envs) / sizeof(envs[0]));
+  t_int16 n_ramp = (t_int16)(sizeof(ramps) / sizeof(ramps[0]));
+  t_int16 cnt = 0;
+
+  float* table = (float*)sysmem_newptr((n_smp + 1) * sizeof(float));
+  if ((table == NULL) || (n_smp < 2)) { if (table) { sysmem_freeptr(table); } return 0; }
+
+  t_double step = 1. / (n_smp - 1);
+  t_double sum = 0;
+  t_double best, f;
+  t_uint64 ticks;
+
+  // Envelope functions, with the parameters set by the envelope message for the envelopes that use them
+  for (t_int16 e = 0; (e < n_env) && (cnt < BENCH_N_RESULT - 1); e++) {
+
+    best = 1e300;
+
+    for (t_int16 run = 0; run < BENCH_N_RUN; run++) {
+      ticks = CYCLE_COUNT();
+      for (t_int32 rep = 0; rep < n_rep; rep++) {
+        for (t_int16 i = 0; i < n_smp; i++) { sum += envs[e].func(i * step, 0.1, 0.2); }
+      }
+      f = (t_double)(CYCLE_COUNT() - ticks) / ((t_double)n_rep * n_smp);
+      if (f < best) { best = f; }
+    }
+
+    res[cnt].name = envs[e].name; res[cnt++].ticks = best;
+  }
+
+  // Ramp and crossfade functions
+  for (t_int16 e = 0; (e < n_ramp) && (cnt < BENCH_N_RESULT - 1); e++) {
+
+    best = 1e300;
+
+    for (t_int16 run = 0; run < BENCH_N_RUN; run++) {
+      ticks = CYCLE_COUNT();
+      for (t_int32 rep = 0; rep < n_rep; rep++) {
+        for (t_int16 i = 0; i < n_smp; i++) { sum += ramps[e].func(i * step, 0.5); }
+      }
+      f = (t_double)(CYCLE_COUNT() - ticks) / ((t_double)n_rep * n_smp);
+      if (f < best) { best = f; }
+    }
+
+    res[cnt].name = ramps[e].name; res[cnt++].ticks = best;
+  }
+
+  // Table lookup with linear interpolation, at a rate that does not fall on the table points
+  for (t_int16 i = 0; i < n_smp; i++) { table[i] = (float)env_hann(i * step, 0, 0); }
+  table[n_smp] = table[n_smp - 1];
+
+  t_double phase_inc = (n_smp - 1) / (n_smp + 0.5);
+  t_double phase;
+  t_int32  ind;
+  best = 1e300;
+
+  for (t_int16 run = 0; run < BENCH_N_RUN; run++) {
+    ticks = CYCLE_COUNT();
+    for (t_int32 rep = 0; rep < n_rep; rep++) {
+      phase = 0;
+      for (t_int16 i = 0; i < n_smp; i++) {
+        ind = (t_int32)phase;
+        sum += table[ind] + (phase - ind) * (table[ind + 1] - table[ind]);
+        phase += phase_inc;
+      }
+    }
+    f = (t_double)(CYCLE_COUNT() - ticks) / ((t_double)n_rep * n_smp);
+    if (f < best) { best = f; }
+  }
+
+  res[cnt].name = "table lookup (linear)"; res[cnt++].ticks = best;
+
+  bench_sink = sum;
+  sysmem_freeptr(table);
+
+  return cnt;
+}
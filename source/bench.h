@@ -0,0 +1,35 @@
+#ifndef YC_BENCH_H_
+#define YC_BENCH_H_
+
+// ======== DESCRIPTION ======== //
+// Microbenchmarks of the low-level primitives: the linked list operations used to manage grains and seeders,
+// and the envelope, ramp and crossfade functions, each next to the alternative the engine could use instead.
+// Times are in ticks of CYCLE_COUNT per operation, the minimum over a few runs to leave out interruptions.
+
+// ========  HEADER FILE FOR THE MICROBENCHMARKS  ========
+
+#include "ext.h"      // Header file for all objects, should always be first
+#include "z_dsp.h"    // Header file for MSP objects, included here for t_double type
+
+// ========  DEFINES  ========
+
+#define BENCH_N_RESULT  64    // Maximum number of results of all the benchmarks
+#define BENCH_N_RUN     5     // Number of runs of each benchmark, the fastest is kept
+
+// ====  STRUCTURE DECLARATIONS  ====
+
+typedef struct _bench_result {
+
+  const char* name;     // Name of the primitive
+  t_double    ticks;    // Ticks per operation
+
+} t_bench_result;
+
+// ====  PROCEDURE DECLARATIONS  ====
+
+t_int16   bench_list  (t_bench_result* res, t_int16 n, t_int32 n_rep);
+t_int16   bench_env   (t_bench_result* res, t_int16 n_smp, t_int32 n_rep);
+
+// ========  END OF HEADER FILE  ========
+
+#endif
@@ -15,12 +15,20 @@
 
 // Max headers
 #include <time.h>
+#include <stdio.h>
 
 #include "max_util.h"
 #include "buffer.h"
+#include "ext_atomic.h"
 
 #include "linked_list.h"
 #include "envelopes.h"
+#include "locked_mem.h"
+#include "halfband.h"
+#include "param_queue.h"
+#include "wavetable.h"
+#include "timeline.h"
+#include "bench.h"
 
 // ========  DEFINES  ========
 
@@ -29,6 +37,52 @@
 #define POLY_MAX      10
 #define ENV_N_SMP     1000
 
+#define MESS_SEEDER_LEN 13    // Number of atoms describing one seeder in the replies to get_seeder
+#define MESS_MIN        64    // Minimum number of atoms in the message array, for the replies that do not depend on the seeders
+#define SEEDERS_LIMIT   (32767 / MESS_SEEDER_LEN)   // Most seeders whose reply to "get_seeder all" fits in one message
+#define GRAINS_MESS_MAX 256   // Most grains per message in the replies to get_grains
+
+#define HIST_N_BIN      32    // Number of bins of each grain histogram
+
+// ====  SOAK TEST  ====
+
+#define SCORE_LINE_MAX  1024      // Maximum length of a line of a render score
+#define SOAK_CHANGE_MS  250       // Simulated time between two random parameter changes
+#define SOAK_SOURCE_MS  60000     // Simulated time between two random envelope, source and loop changes
+#define SOAK_REPORT_MS  3600000   // Simulated time between two progress reports
+#define SOAK_SLICE_MS   20        // Wall time rendered by each slice of the run before the message thread resumes
+#define SOAK_CALIB_MS   10        // Wall time measuring the tick rate before the run, to convert the budget to ticks
+#define SOAK_DRIFT_FRM  1         // Drift of the play position in frames tolerated on top of the step truncation
+#define SOAK_RAND_MAX   0x7FFFFFFF  // Maximum of the private random generator of the changes
+
+// ====  TIMELINE  ====
+// Spans are only recorded while the timeline is on, at the cost of one test per span otherwise
+
+#define TL_LOCK_MIN     2000  // Buffer lock waits shorter than this number of ticks are not recorded
+
+#define TL_BEGIN(t) t_uint64 t = (x->tl_on ? CYCLE_COUNT() : 0)
+#define TL_END(t, thread, span, arg) do { if (x->tl_on && (t)) { tl_record(x->tl, thread, span, arg, t, CYCLE_COUNT()); } } while (0)
+
+#define PREFETCH_LINES  2   // Number of cache lines prefetched at the beginning of each upcoming grain
+
+#define SUBBLOCK_LEN    64    // Maximum number of samples processed between two scheduling passes
+#define PARAM_QUEUE_LEN 1024  // Maximum number of pending parameter changes, a power of 2
+#define FILE_WAIT_MS    100   // Time a file read waits for the audio thread before draining the queue itself
+#define ENGINE_SPIN_MAX 4096  // Attempts of the perform routine to take the engine from a message thread applying a change
+
+#define RESTART_FADE_MS 20    // Length in ms of the fade out of live grains when the DSP restarts in fade mode
+
+#define AUTOGAIN_MAX    4.    // Default limit on the gain applied to new grains by the automatic gain
+#define AUTOGAIN_MIN_E  1e-6  // Floor on the overlap energy, to bound the gain when there are almost no grains
+
+#define NORM_MAX        8.    // Default limit on the per-grain loudness normalization gain
+#define NORM_MIN_MS     1e-12 // Floor on the mean square of a grain window, for silent windows
+
+// ====  DSP RESTART MODES  ====
+
+#define RESTART_RESCALE 0     // Live grains and seeder countdowns are rescaled to the new samplerate and continue
+#define RESTART_FADE    1     // Live grains fade out
+
 // ====  NUMERICAL CONSTANTS:  FOR CALCULATIONS  ====
 
 #define LN2 0.693147180559945309417
@@ -43,6 +97,230 @@
 #define BUFF_NO_OBJ   -4    // Failed to get an object for the buffer
 #define BUFF_NO_FILE  -5    // Failed to load a file in the buffer
 #define BUFF_READY     1    // Buffer is succesfully linked to and a file has been loaded into it
+#define BUFF_LOADING   2    // A file is loaded into the buffer once the audio thread removed the grains of the seeder
+
+// ====  SOURCE MEMORY MODES  ====
+
+#define MEM_MODE_OFF    0   // Grains read directly from the buffer
+#define MEM_MODE_LOCKED 1   // Grains read from an engine owned copy of the buffer, locked in RAM
+#define MEM_MODE_HUGE   2   // Same, backed by huge pages where available
+
+// ====  PLAY POSITION AND LOOP REGIONS  ====
+
+#define POS_FRAC_BITS   16    // Number of fractional bits of the fixed-point play position
+
+#define BOUND_WRAP      0     // The play position wraps around the loop region
+#define BOUND_PINGPONG  1     // The play position reverses direction at each end of the loop region
+#define BOUND_CLAMP     2     // The play position stays at the end of the loop region it reached
+#define BOUND_STOP      3     // The seeder stops adding grains when the play position reaches an end of the loop region
+
+// ====  ENVELOPE TABLES  ====
+
+#define ENV_RETIRED_MAX 64    // Maximum number of replaced envelope tables waiting for their grains to end
+#define SRC_RETIRED_MAX 64    // Maximum number of replaced source handles waiting for their grains to end
+#define BLK_RETIRED_MAX 64    // Maximum number of replaced shared blocks waiting for their grains to end
+
+// ====  SAMPLE POOLS  ====
+
+#define POOL_MAX        64    // Maximum number of buffers in the sample pool of a seeder
+#define POOL_NONE       -1    // Pool index of the grains that read from the seeder's own buffer
+#define POOL_LOOP       -2    // Pool index of the grains that read from the seeder's loop copy
+#define POOL_OSC        -3    // Pool index of the grains that read from a wavetable
+#define POOL_RING       -4    // Pool index of the grains that read from the record ring
+
+// ====  SEEDER SOURCE MODES  ====
+
+#define SRC_MODE_BUFFER     0   // Grains read from the source buffer
+#define SRC_MODE_WAVETABLE  1   // Grains loop over a single-cycle wavetable at a per-grain frequency
+#define SRC_MODE_PULSAR     2   // Grains are pulsar trains: each period holds one cycle of the wavetable compressed by the duty cycle, then silence
+#define SRC_MODE_RING       3   // Grains read from the record ring, behind the write head
+
+// ====  RECORD RING  ====
+
+#define RING_FB_MAX     0.99  // Maximum feedback gain of the output into the record ring
+
+#define POOL_OFF        0     // Grains read from the seeder's own buffer
+#define POOL_RANDOM     1     // Each grain reads from a buffer of the pool chosen at random
+#define POOL_SEQUENTIAL 2     // Each grain reads from the next buffer of the pool
+#define POOL_WEIGHTED   3     // Each grain reads from a buffer of the pool chosen at random with a probability set by its weight
+
+// ====  QUEUED PARAMETERS  ====
+// Parameters changed from the message threads and applied by the audio thread between sub-blocks
+
+typedef enum _param_type {
+
+  PARAM_AMPL,
+  PARAM_BEGIN,
+  PARAM_LENGTH,
+  PARAM_SHIFT,
+  PARAM_PERIOD,
+  PARAM_SPEED,
+  PARAM_POLY,
+  PARAM_PERIOD_RAND,
+  PARAM_ON,           // Adds the seeder to the active list
+  PARAM_OFF,          // Removes the seeder from the active list, and its grains too if the value is not 0
+  PARAM_GLIDE_BEGIN,
+  PARAM_GLIDE_END,
+  PARAM_GLIDE_RAND,
+  PARAM_WAVE,
+  PARAM_FREQ,
+  PARAM_DUTY,
+  PARAM_FREQ_RAND,
+  PARAM_RING_BEHIND,
+  PARAM_SRC_MODE,     // Pushed after the parameters of the mode, so that new grains see them all
+  PARAM_OVERSAMPLE,   // Index of the oversampling factor
+  PARAM_INTERP,
+  PARAM_NORM_TARGET,
+  PARAM_NORM_MAX,
+  PARAM_POOL_MODE,    // Also restarts the sequential mode
+  PARAM_BOUND_MODE,   // Also restarts the play position forward
+  PARAM_LOOP_BEGIN,   // Loop region in frames
+  PARAM_LOOP_END,
+  PARAM_LAST
+
+} t_param_type;
+
+// ====  RENDER KERNELS  ====
+
+#ifndef KERNEL_SPECIALIZED
+#define KERNEL_SPECIALIZED  true  // Set to false, or -DKERNEL_SPECIALIZED=false, to render all grains with the generic kernel
+#endif
+
+// Interpolation of the source samples
+typedef enum _interp_type {
+
+  INTERP_NONE,      // Truncate to the previous sample
+  INTERP_LINEAR,    // Linear interpolation between two samples
+  INTERP_LAST
+
+} t_interp_type;
+
+// Envelope rendering
+typedef enum _env_mode {
+
+  ENV_MODE_FLAT,    // Constant envelope: no table lookup
+  ENV_MODE_TABLE,   // Linear interpolation in the envelope table
+  ENV_MODE_LAST
+
+} t_env_mode;
+
+// Source channel strides: 1 channel, 2 channels, or any number of channels read at runtime
+#define KERNEL_STRIDES  3
+
+// ====  OVERSAMPLING  ====
+
+#define OS_N_BUS      3       // Render buses: 1x (the outlet), 2x and 4x, indexed by the log2 of the factor
+
+// ====  GRAIN CLOUD VISUALIZATION  ====
+
+#define VIZ_FPS_MAX   60      // Maximum snapshot frame rate
+#define VIZ_N_VAL     5       // Number of values per grain in the visualization buffer
+#define VIZ_NEW       0x4     // Flag set on the exchanged snapshot index when it holds a frame not read yet
+#define VIZ_INDEX     0x3     // Mask to get the snapshot index
+#define VIZ_REQ       1       // get_grains state: a snapshot is requested from the audio thread
+#define VIZ_REPLY     2       // get_grains state: the next snapshot read is sent as the reply
+
+// ========  STRUCT DEFINITION: ENVELOPE TABLE  ========
+// Envelope values, their rendering mode and mean square, and the number of live grains reading them. A published table is never written:
+// an envelope change builds a new table and swaps the pointer, and each grain keeps the table it started with.
+// The replaced table is retired, and freed once the audio thread moved on and no grain reads it anymore.
+
+typedef struct _env_table {
+
+  t_int32_atomic  grain_cnt;  // Number of live grains reading the table, updated by the audio thread
+  t_int32         epoch;      // Audio epoch when the table was retired
+  t_env_mode      mode;       // Whether grains need to read the envelope values
+  t_double        ms;         // Mean square of the envelope, used to estimate the energy of each grain
+  float*          values;     // Envelope values, allocated with the table
+
+} t_env_table;
+
+// ========  STRUCT DEFINITION: SOURCE HANDLE  ========
+// Snapshot of the source of a seeder: buffer object, metadata and engine owned copy. A published handle is never
+// written: a buffer change or a new copy builds a new handle and swaps the pointer, and each grain keeps the handle
+// it started with. The replaced handle is retired like an envelope table, and its copy freed with it.
+
+typedef struct _src_handle {
+
+  t_int32_atomic  grain_cnt;  // Number of live grains reading the source, updated by the audio thread
+  t_int32         epoch;      // Audio epoch when the handle was retired
+  t_buffer_obj*   buff_obj;   // Buffer object when the handle was published
+  t_int16         n_chn;      // Number of channels of the source
+  t_int32         n_frm;      // Number of frames of the source
+  t_atom_float    msr;        // Samplerate of the source in samples per ms
+  t_mem_block     mem;        // Engine owned copy of the source, empty when reading from the buffer
+
+} t_src_handle;
+
+// ========  STRUCT DEFINITION: SHARED BLOCK  ========
+// Data built by the message thread and read by the audio thread: prefix sums, loop copy or record ring.
+// A published block is never written, but for the record ring by the audio thread, and it is retired like
+// an envelope table when replaced.
+// The data follows the header, in the same allocation.
+
+typedef struct _shared_block {
+
+  t_int32_atomic  grain_cnt;  // Number of live grains reading the block, updated by the audio thread
+  t_int32         epoch;      // Audio epoch when the block was retired
+  t_int32         n_frm;      // Number of frames covered by the data
+  t_int16         n_chn;      // Number of channels of the data
+  t_int32         offset;     // Position in frames of the data in its source
+  void*           data;       // Data, right after the header
+
+} t_shared_block;
+
+// ========  STRUCT DEFINITION: LOAD COUNTERS  ========
+// Render cost of a seeder, accumulated by the audio thread while the load accounting is on. The counters only grow:
+// the message thread keeps the values of the previous report and outputs the differences.
+
+typedef struct _load {
+
+  t_uint64  ticks;    // Ticks of CYCLE_COUNT spent in the render kernels of the seeder's grains
+  t_uint64  grains;   // Number of grains added
+  t_uint64  smp;      // Number of samples rendered, at the rate of each grain's bus
+
+} t_load;
+
+// ========  STRUCT DEFINITION: GRAIN HISTOGRAMS  ========
+// Grain statistics for capacity planning, updated by the audio thread once per vector cycle and once per grain.
+// The message thread only reads them, and asks the audio thread to clear them.
+
+typedef struct _hist {
+
+  t_uint32  conc[HIST_N_BIN];   // Live grains at the end of each vector cycle, in bins of conc_width grains
+  t_uint32  life[HIST_N_BIN];   // Lifetime of the grains that ended, bin k for [2^(k-1), 2^k) samples, bin 0 for none
+  t_uint32  spawn[HIST_N_BIN];  // Grains added per vector cycle, the last bin for HIST_N_BIN - 1 or more
+  t_int32   conc_width;         // Width of the concurrency bins, so that the bins cover 0 to grains_max
+  t_int16   conc_hwm;           // Highest number of live grains
+  t_uint32  spawn_cnt;          // Grains added in the current vector cycle
+  t_uint32  dropped;            // Grains not added because grains_max was reached
+
+} t_hist;
+
+// ========  STRUCT DEFINITION: POOL SOURCE  ========
+// One buffer of the sample pool of a seeder, as set by the pool message. Only used by the message threads:
+// the audio thread reads the published pool table.
+
+typedef struct _pool_src {
+
+  t_symbol*     buff_sym;     // Name
+  t_buffer_ref* buff_ref;     // Buffer reference
+  t_double      weight;       // Weight of the source in weighted mode
+
+} t_pool_src;
+
+// ========  STRUCT DEFINITION: POOL TABLE  ========
+// Sample pool of a seeder as seen by the audio thread, the data of a shared block. A published table is never written:
+// a pool or buffer change builds a new table. Each source is a source handle, that grains keep like the seeder's own
+// handle. The handles of the buffers that did not change are carried over to the new table, the others are retired.
+
+typedef struct _pool_table {
+
+  t_int16       cnt;                    // Number of sources
+  t_double      weight_sum[POOL_MAX];   // Cumulative weight of each source and all the sources before it
+  t_src_handle* handle[POOL_MAX];       // Source handles, NULL for a buffer without file
+
+} t_pool_table;
 
 // ========  STRUCT DEFINITION: SEEDER  ========
 // Each seeder can generate a stream of grains at regular intervals
@@ -55,16 +333,29 @@ typedef struct _seeder {
 
   t_int16   index;        // Index of the seeder in the seeder array
   t_bool    is_on;        // When inactive the seeder is not processed in the perform64 method
+  t_bool    on_msg;       // Whether the seeder is on as last set by the message threads, is_on once the audio thread applied it
 
   // Used to set grain parameters
   t_double  ampl;         // Amplitude multiplier
   t_int32   src_begin;    // Beginning in samples in the source buffer
-  t_double  src_len_ms;   // Length in ms in the source buffer: used externally
+  t_double  src_len_ms;   // Length in ms in the source buffer: used externally, as last set by the message threads
+  t_double  len_ms;       // Length in ms in the source buffer, src_len_ms once the audio thread applied it
   t_int32   src_len;      // Length in samples in the source buffer: used internally
   t_double  shift;        // Pitch shift: used externally, +1 is one octave up
   t_double  shift_r;      // Pitch shift ratio: used internally
   t_int32   out_len;      // Length in samples for the output
 
+  // Play position and loop region
+  t_int64   src_pos;      // Play position in the source buffer, fixed point with POS_FRAC_BITS fractional bits
+  t_int8    play_dir;     // Direction of the play position: 1 forward, -1 backward in ping-pong mode, 0 stopped
+  t_int8    bound_mode;   // BOUND_WRAP, BOUND_PINGPONG, BOUND_CLAMP or BOUND_STOP
+  t_int8    bound_msg;    // Boundary mode as last set by the message threads, bound_mode once the audio thread applied it
+  t_double  loop_begin_ms;  // Loop region in ms: used externally, an end of 0 is the end of the buffer
+  t_double  loop_end_ms;
+  t_int32   loop_begin;   // Loop region in frames: used internally
+  t_int32   loop_end;
+  t_shared_block* loop;   // In wrap mode, copy of the loop region followed by a guard region repeating it
+
   // Used to determine grain generation
   t_double  period;       // Period ratio between two subsequent grains
   t_int32   period_len;   // Period length in samples between two subsequent grains - output
@@ -77,6 +368,21 @@ typedef struct _seeder {
   t_double  shift_rand;
   t_double  period_rand;
 
+  // Oscillator sources: wavetable and pulsar grains, which do not read the source buffer
+  t_int8        src_mode;     // SRC_MODE_BUFFER, SRC_MODE_WAVETABLE, SRC_MODE_PULSAR or SRC_MODE_RING
+  t_int8        src_mode_msg; // Source mode as last set by the message threads, src_mode once the audio thread applied it
+  t_wave_type   wave;         // Waveform of the wavetable
+  t_double      freq;         // Frequency in Hz, transposed by the shift
+  t_double      freq_rand;    // Random deviation of the frequency of each grain in octaves
+  t_double      duty;         // Pulsar: fraction of each period occupied by the wavetable cycle
+  t_double      ring_behind_ms; // Record ring: time in ms between the end of the grain windows and the write head
+
+  // Glisson: the playback rate of each grain ramps from the start shift to the end shift, relative to the shift
+  t_bool    glide;        // Whether the seeder adds glisson grains
+  t_double  glide_begin;  // Start shift in octaves
+  t_double  glide_end;    // End shift in octaves
+  t_double  glide_rand;   // Random deviation of the start and end shifts in octaves
+
   // Source buffer symbol, reference, and object
   t_symbol*     buff_sym;     // Name
   t_buffer_ref* buff_ref;     // Buffer reference
@@ -90,23 +396,54 @@ typedef struct _seeder {
   t_symbol*     buff_path;    // Full path of the file loaded in the buffer
   t_bool        buff_is_chg;  // Used when the buffer was just changed to intercept notifications
 
+  // Sample pool: when on, each grain reads from one of the pool buffers instead of the seeder's own buffer,
+  // at the same position and length in ms. The seeder's own buffer still sets the range of positions.
+  t_int8        pool_mode;    // POOL_OFF, POOL_RANDOM, POOL_SEQUENTIAL or POOL_WEIGHTED
+  t_int16       pool_cnt;     // Number of buffers in the pool
+  t_int16       pool_next;    // Next buffer in sequential mode
+  t_pool_src*   pool_arr;     // Array of POOL_MAX sources, allocated when the pool is first set
+  t_shared_block* pool_table; // Pool table read by the audio thread, NULL when the pool is empty
+
+  // Engine owned copy of the source buffer
+  t_int8        mem_mode;     // MEM_MODE_OFF, MEM_MODE_LOCKED or MEM_MODE_HUGE
+  t_src_handle* src_handle;   // Source handle used by new grains, NULL when no source is ready
+
+  // Per-grain loudness normalization
+  t_double      norm_target;  // Target RMS level of each grain, 0 when the normalization is off
+  t_double      norm_max;     // Maximum normalization gain
+  t_shared_block* psum;       // Prefix sums of the squared samples of the first channel: psum[i] = s[0]^2 + ... + s[i-1]^2
+
   // Envelope
   t_env_type    env_type;     // Envelope type
   t_symbol*     env_sym;      // Envelope symbol
   t_double      env_alpha;    // First envelope parameter
   t_double      env_beta;     // Second envelope parameter
-  float*        env_values;   // Array to store the envelope
+  t_env_table*  env_table;    // Envelope table used by new grains
 
   t_double(*env_func) (t_double, t_double, t_double); // Envelope function: not used at this point XXX
 
+  // Rendering
+  t_interp_type interp;       // Interpolation of the source samples
+  t_int8        os_ind;       // Oversampling: 0 for none, 1 for 2x, 2 for 4x
+
   // Countdown to next grain generation for each stream of grains
   t_int16   poly_cnt;
   t_int32   period_cntd[POLY_MAX];
 
+  // Load accounting
+  t_load    load;         // Counters written by the audio thread
+  t_load    load_prev;    // Counters at the previous report, written by the message thread
+
 } t_seeder;
 
 // ========  STRUCT DEFINITION: GRAIN  ========
 
+// Render kernel: writes n samples of a grain to the output
+struct _grain;
+
+typedef void (*t_kernel)(struct _grain* grain, t_double* out, t_int32 n, float* buff_src, float* env_values,
+  t_int32 n_chn, t_int32 env_len, t_double mult, t_double mult_inc);
+
 typedef struct _grain {
 
   // Index of the seeder that created the grain
@@ -127,8 +464,127 @@ typedef struct _grain {
   t_int32   env_I;        // Index for interpolation in the envelope LUT
   t_int32   env_R;        // Remainder for interpolation in the envelope LUT
 
+  t_bool    glide;        // Glisson grain: the playback rate ramps over the grain
+  float*    table;        // Oscillator grains: wavetable
+  t_double  duty_inv;     // Pulsar grains: inverse of the duty cycle
+  t_double  phase;        // Glisson grains: position in the source window
+  t_double  phase_inc;    // Glisson grains: current increment of the position per output sample
+  t_double  phase_inc_inc;  // Glisson grains: change of the increment per output sample
+
+  t_kernel  kernel;       // Render kernel chosen when the grain is added
+  t_env_table*  env_table;  // Envelope table of the seeder when the grain was added
+  t_src_handle* src_handle; // Source handle of the seeder or of its pool source when the grain was added, NULL otherwise
+  t_shared_block* block;    // Loop copy or record ring when the grain was added, NULL unless it reads one
+  t_int16   pool_ind;     // Index of the source in the seeder's pool, POOL_NONE for the seeder's own buffer,
+                          // POOL_LOOP for the seeder's loop copy
+  t_int8    os_ind;       // Render bus: 0 for the outlet, 1 for the 2x bus, 2 for the 4x bus
+
+  t_double  energy;       // Contribution to the overlap energy: squared amplitude times envelope mean square
+
+  t_bool    fading;       // Whether the grain fades out
+  t_int32   fade_cntd;    // Countdown in samples to the end of the fade out
+  t_int32   fade_len;     // Length in samples of the fade out
+
+  t_int32   played;       // Samples written so far at the rate of the grain's bus, cut short by a fade or rescaled
+
 } t_grain;
 
+// ========  STRUCT DEFINITION: SCORE EVENT  ========
+// One message of a render score, sent to the object when the render reaches its frame
+
+typedef struct _score_event {
+
+  t_int32   frm;          // Frame of the render at which the message is sent
+  t_int32   line;         // Line in the score file, to keep the order of the messages at the same frame
+  t_symbol* sym;          // Message
+  long      argc;         // Number of arguments
+  t_atom*   argv;         // Arguments, after the time and the message in the atoms
+  t_atom*   atoms;        // Atoms of the whole line, allocated by atom_setparse
+
+} t_score_event;
+
+// ========  STRUCT DEFINITION: SOAK SEEDER  ========
+// Per seeder state of a soak run: the snapshot restored at the end, and the reference of the drift check
+
+typedef struct _soak_seeder {
+
+  // Snapshot of the seeder before the run
+  t_double  ampl;
+  t_int32   src_begin;
+  t_double  src_len_ms;
+  t_double  shift;
+  t_double  period;
+  t_double  speed;
+  t_int16   poly_cnt;
+  t_double  period_rand;
+  t_int64   src_pos;
+  t_int8    play_dir;
+  t_symbol* env_sym;
+  t_double  loop_begin_ms;
+  t_double  loop_end_ms;
+
+  // Drift reference: position and period countdown at the last reset, and what the position depends on
+  t_bool    ref_ok;         // Whether the reference is set, false to reset it after the next vector cycle
+  t_int64   ref_pos;        // Play position at the reset
+  t_int32   ref_cntd;       // Period countdown of the main stream at the reset
+  t_int64   ref_frm;        // Frames rendered since the reset
+  t_double  ref_speed;
+  t_int8    ref_dir;
+  t_atom_float ref_msr;
+  t_int32   ref_len;
+  t_int32   ref_loop_begin;
+  t_int32   ref_loop_end;
+
+} t_soak_seeder;
+
+// ========  STRUCT DEFINITION: SOAK  ========
+// State of a soak run, rendered in slices from a queue element
+
+typedef struct _soak {
+
+  t_uint32  rand;           // State of the private random generator of the changes
+  t_int64   n_vec;          // Number of vector cycles to render
+  t_int64   vec;            // Number of vector cycles rendered
+  t_int32   vec_len;        // Vector size
+  t_double  vec_ms;         // Vector duration in ms
+  t_double  budget;         // Budget of the render time as a fraction of the vector duration
+  t_int64   change_vec;     // Vector cycles between two parameter changes
+  t_int64   source_vec;     // Vector cycles between two envelope, source and loop changes
+  t_int64   report_vec;     // Vector cycles between two progress reports
+  t_double* out;            // Output vector, followed by the silent input vector in the same block
+  t_double* in;
+
+  t_int64   err_grains;     // Number of failed checks of each kind
+  t_int64   err_begin;
+  t_int64   err_drift;
+  t_int64   err_out;
+  t_int64   err_mem;
+  t_int16   grains_hwm;     // Highest number of grains
+  t_int16   retired_hwm;    // Highest number of retired tables, handles and blocks
+  t_double  drift_max;      // Highest drift of a play position in frames
+  t_uint64  ticks_max;      // Highest render time of a vector cycle in ticks
+  t_uint64  ticks_sum;      // Render time of all the vector cycles in ticks
+  t_uint64  ticks_budget;   // Budget of the render time of a vector cycle in ticks, 0 without a tick counter
+  t_int64   n_over;         // Number of vector cycles over the budget
+  t_double  time_ms;        // Wall time spent in the slices
+
+  t_soak_seeder* seeders;   // Per seeder state, following this struct in the same block
+
+} t_soak;
+
+// ========  STRUCT DEFINITION: GRAIN SNAPSHOT  ========
+// Compact state of one grain, published by the audio thread for the visualization
+
+typedef struct _grain_snap {
+
+  float     seeder;       // Index of the seeder that created the grain
+  float     pos;          // Current position in the source, normalized to the source length
+  float     len;          // Length in the source, normalized to the source length
+  float     phase;        // Envelope phase, from 0 to 1
+  float     ampl;         // Amplitude multiplier
+
+} t_grain_snap;
+
 // ========  STRUCTURE DECLARATION  ========
 
 typedef struct _granular {
@@ -138,9 +594,13 @@ typedef struct _granular {
   void*         outl_bounds;    // Outlet 1: List outlet to output grain boundaries in ms
   void*         outl_mess;      // Outlet 2: General message outlet
   void*         outl_compl;     // Outlet 3: Bang outlet to indicate task completion
-  t_atom        mess_arr[20];   // To output messages
+  t_atom*       mess_arr;       // To output messages, sized for the replies covering all the seeders
+  t_int32       mess_cap;       // Number of atoms in mess_arr
+  t_atom        bounds_arr[2];  // To output grain boundaries from the audio thread, apart from the replies
 
   t_double      msamplerate;    // Stores the current samplerate in ms
+  t_int8        restart_mode;   // What happens to live grains when the DSP restarts: RESTART_RESCALE or RESTART_FADE
+  t_bool        dsp_stopped;    // Whether the DSP was stopped since the last DSP chain compile
   t_int16       connected[2];   // Inlet and outlet signal connection status
 
   t_symbol*     buff_env_sym;   // The buffer's name
@@ -157,13 +617,89 @@ typedef struct _granular {
   t_list*   seeders_list;   // Linked list to go through the active seeders
   t_int16   seeders_foc;    // Index of the seeder which is in focus, used to output grain boundaries
 
+  // Envelope tables replaced while grains may still read them
+  t_env_table*    env_retired[ENV_RETIRED_MAX];  // Retired tables
+  t_int16         env_retired_cnt;               // Number of retired tables
+
+  // Source handles replaced while grains may still read them
+  t_src_handle*   src_retired[SRC_RETIRED_MAX];  // Retired handles
+  t_int16         src_retired_cnt;               // Number of retired handles
+
+  // Shared blocks replaced while grains may still read them
+  t_shared_block* blk_retired[BLK_RETIRED_MAX];  // Retired blocks
+  t_int16         blk_retired_cnt;               // Number of retired blocks
+
+  t_int32_atomic  epoch;                         // Audio epoch, incremented at the end of each vector cycle
+
   t_int16   grains_max;     // Maximum number of grains
   t_int16   grains_cnt;     // Current number of grains
   t_grain*  grains_arr;     // Array to store the grains
   t_list*   grains_list;    // List to manage the grain indexes
 
+  t_param_queue*  param_queue;  // Parameter changes waiting to be applied by the audio thread
+  t_int32_atomic  engine_owned; // 1 while a thread renders or drains the queue: the queue has a single consumer
+
+  // Automatic gain: new grains are scaled so that the summed level stays at the target as the overlap changes
+  t_double  autogain_target;  // Target RMS level, 0 when the automatic gain is off
+  t_double  autogain_max;     // Maximum gain applied to a grain
+  t_double  overlap_e;        // Energy of the live grains before automatic gain, updated per spawn and per sub-block
+
+  // Per-seeder load accounting, reported by get_seeder_load
+  t_bool    load_on;          // Whether the render cost is accumulated
+  t_uint64  load_ticks;       // Ticks of CYCLE_COUNT spent in the perform routine, written by the audio thread
+  t_uint64  load_prev_ticks;  // Value at the previous report, written by the message thread
+  t_load*   load_snaps[3];    // Triple buffer of the published counters: one per seeder, then the total ticks
+  t_int32   load_w;           // Index of the snapshot owned by the engine
+  t_int32   load_r;           // Index of the snapshot owned by the message thread
+  t_int32_atomic load_mid;    // Index of the snapshot being exchanged, with the VIZ_NEW flag
+
+  // Grain histograms, reported by get_hist
+  t_hist          hist;         // Histograms, written by the audio thread
+  t_int32_atomic  hist_clear;   // Set by the message thread to have the audio thread clear the histograms
+
+  // Timeline of engine activity, dumped as Chrome trace JSON by timeline_dump
+  t_timeline*     tl;           // Rings of spans, allocated when the timeline is first turned on
+  t_bool          tl_on;        // Whether spans are recorded
+
+  // Record ring: the signal input plus the output scaled by the feedback gain, recorded after each sub-block
+  // for the seeders in ring mode to granulate. Grains only read what was recorded before they started.
+  // A new length publishes a new ring, and grains keep the ring they started with.
+  t_shared_block* ring;     // Ring of n_frm frames, stored twice in a row so that windows read across the end
+  t_shared_block* ring_rec; // Ring the audio thread records into, only compared to the published one
+  t_int32   ring_len;       // Length in frames of the published ring, used by the message threads
+  t_double  ring_len_ms;    // Length in ms
+  t_int32   ring_w;         // Write index in ring_rec
+  t_double  ring_fb;        // Feedback gain
+
   t_double (*env_func) (t_double, t_double, t_double);  // Envelope function XXX
 
+  // Oversampled render buses, each one decimated into the bus at half its rate
+  t_int32       vector_max;         // Maximum vector size, used to allocate the buses
+  t_double*     os_bus[OS_N_BUS];   // Oversampled buses: os_bus[0] is unused, the outlet is used instead
+  t_halfband*   os_hb[OS_N_BUS];    // Decimator from each bus to the bus at half its rate
+  t_bool        os_used[OS_N_BUS];  // Whether the bus was cleared and written to in the current vector cycle
+  t_int32       os_tail[OS_N_BUS];  // Countdown in input samples to flush the decimator after the last grain
+
+  // Grain cloud visualization: the audio thread writes snapshots in a triple buffer, and a low priority
+  // clock copies the latest one to the visualization buffer
+  t_symbol*       buff_viz_sym;   // The buffer's name
+  t_buffer_ref*   buff_viz_ref;   // Buffer reference for the visualization output
+  t_double        viz_fps;        // Snapshot frame rate, 0 when the visualization is off
+  t_int32         viz_cntd;       // Countdown in samples to the next snapshot
+  t_grain_snap*   viz_snaps[3];   // Triple buffer of snapshots, each one holding up to grains_max grains
+  t_int32         viz_cnt[3];     // Number of grains in each snapshot
+  t_int32         viz_w;          // Index of the snapshot owned by the audio thread
+  t_int32         viz_r;          // Index of the snapshot owned by the low priority thread
+  t_int32_atomic  viz_mid;        // Index of the snapshot being exchanged, with the VIZ_NEW flag
+  void*           viz_clock;      // Clock ticking at the frame rate
+  void*           viz_qelem;      // Queue element to write the buffer at low priority
+  t_int32_atomic  viz_grains;     // State of a get_grains request: 0, VIZ_REQ or VIZ_REPLY
+  t_atom*         viz_mess;       // To output the replies to get_grains, apart from the other replies
+
+  // Soak run, see granular_soak
+  t_soak*         soak;           // State of the run in progress, NULL when none
+  void*           soak_qelem;     // Queue element rendering the run in slices
+
 } t_granular;
 
 // ========  METHOD PROTOTYPES  ========
@@ -175,8 +711,12 @@ void    granular_free       (t_granular* x);
 t_max_err granular_notify   (t_granular* x, t_symbol* sender_sym, t_symbol* msg, void* sender_ptr, void* data);
 
 void    granular_dsp64      (t_granular* x, t_object* dsp64, t_int16* count, t_double samplerate, t_int32 maxvectorsize, t_int32 flags);
+void    granular_dspstate   (t_granular* x, t_atom_long state);
 void    granular_perform64  (t_granular* x, t_object* dsp64, t_double** ins, t_int16 numins, t_double** outs, t_int16 numouts, t_int32 sampleframes, t_int32 flags, void* userparam);
+void    granular_perform_block  (t_granular* x, t_double* out_block, t_int32 sampleframes);
 void    granular_assist     (t_granular* x, void* b, t_int16 type, t_int16 arg, char* str);
+void    granular_restart    (t_granular* x, t_symbol* sym);
+void    granular_rescale    (t_granular* x, t_double ratio, t_bool restart);
 
 // ====  GRANULAR METHODS  ====
 
@@ -187,13 +727,45 @@ void    granular_post_seeders (t_granular* x, t_symbol* sym, t_int16 argc, t_ato
 void    granular_post_grains  (t_granular* x);
 void    granular_post_buffers (t_granular* x);
 void    granular_get_active   (t_granular* x);
+void    granular_load         (t_granular* x, t_atom_long on);
+void    granular_get_seeder_load (t_granular* x);
+void    granular_load_publish (t_granular* x);
+void    granular_get_hist     (t_granular* x);
+void    granular_clear_hist   (t_granular* x);
+void    granular_hist_update  (t_granular* x);
+void    granular_timeline     (t_granular* x, t_atom_long on);
+void    granular_soak         (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
+void    granular_soak_slice   (t_granular* x);
+void    granular_soak_vector  (t_granular* x, t_soak* soak);
+void    granular_soak_drift   (t_granular* x, t_soak* soak, t_seeder* seeder);
+void    granular_soak_end     (t_granular* x);
+void    granular_soak_free    (t_granular* x);
+t_uint32 granular_soak_rand   (t_soak* soak);
+void    granular_soak_change  (t_granular* x, t_soak* soak, t_bool source);
+void    granular_bench        (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
+void    granular_timeline_dump (t_granular* x, t_symbol* path);
+void    granular_autogain     (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
+void    granular_viz          (t_granular* x, t_double fps);
+void    granular_viz_snapshot (t_granular* x);
+void    granular_viz_tick     (t_granular* x);
+void    granular_viz_write    (t_granular* x);
+void    granular_get_grains   (t_granular* x);
+void    granular_grains_reply (t_granular* x);
 
 // ====  SEEDER METHODS  ====
 
 t_int16 granular_check_args   (t_granular* x, const char* method, t_int16 argc, t_atom* argv, t_int16 argc_exp);
 
+void    granular_param_push   (t_granular* x, t_int16 index, t_param_type param, t_double value);
+t_bool  granular_engine_acquire (t_granular* x);
+void    granular_engine_release (t_granular* x);
+void    granular_param_drain  (t_granular* x);
+void    granular_param_apply  (t_granular* x, t_int16 index, t_param_type param, t_double value);
+void    granular_grains_remove (t_granular* x, t_int16 index);
+
 void    granular_set_seeder   (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
 void    granular_get_seeder   (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
+t_atom* granular_seeder_atoms (t_seeder* seeder, t_atom* atom);
 void    granular_seeder_on    (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
 void    granular_seeder_off   (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
 
@@ -208,18 +780,62 @@ void    granular_poly         (t_granular* x, t_symbol* sym, t_int16 argc, t_ato
 void    granular_period_rand  (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
 void    granular_buffer       (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
 void    granular_file         (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
+void    granular_file_read    (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
+void    granular_interp       (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
+void    granular_oversample   (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
+void    granular_memory       (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
+void    granular_memory_load  (t_granular* x, t_seeder* seeder);
+void    granular_src_publish  (t_granular* x, t_seeder* seeder, t_mem_block* mem);
+void    granular_src_reclaim  (t_granular* x, t_bool force);
+t_src_handle* granular_src_new (t_buffer_obj* buff_obj);
+t_shared_block* granular_block_new (t_int32 n_frm, size_t size);
+t_bool  granular_block_publish (t_granular* x, t_shared_block** dst, t_shared_block* block);
+void    granular_block_reclaim (t_granular* x, t_bool force);
+void    granular_normalize    (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
+void    granular_psum_load    (t_granular* x, t_seeder* seeder);
+void    granular_pool         (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
+void    granular_pool_publish (t_granular* x, t_seeder* seeder, t_symbol* changed);
+t_int16 granular_pool_choose  (t_seeder* seeder, t_pool_table* table);
+void    granular_loop         (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
+void    granular_boundary     (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
+void    granular_glisson      (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
+void    granular_source       (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
+void    granular_ring         (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
+void    granular_ring_alloc   (t_granular* x);
+void    granular_ring_write   (t_granular* x, t_double* in, t_double* out, t_int32 n);
+void    granular_render       (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
+t_int32 granular_score_load   (t_granular* x, t_symbol* path, t_score_event** score);
+void    granular_score_free   (t_score_event* score, t_int32 cnt);
+void    granular_loop_update  (t_granular* x, t_seeder* seeder);
+void    granular_bound        (t_seeder* seeder);
 
 void    granular_envelope     (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
+void    granular_env_ms       (t_granular* x, t_env_table* table);
+t_env_table* granular_env_new (t_granular* x);
+void    granular_env_reclaim  (t_granular* x, t_bool force);
 void    granular_output_env   (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
 
 // ====  GRAIN METHODS  ====
 
 t_grain*  granular_add_grain_fs   (t_granular* x, t_seeder* seeder, t_int32 src_offset, t_int32 out_offset);
+void      granular_prefetch_fs    (t_granular* x, t_seeder* seeder, float* buff_src, t_int32 src_offset);
 t_grain*  granular_add_grain      (t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv);
 void      granular_output_grain   (t_granular* x);
 
 void  granular_bang       (t_granular* x);
 
+// ====  OVERSAMPLING  ====
+
+t_double* granular_os_bus   (t_granular* x, t_int8 os_ind, t_int32 sampleframes);
+void      granular_os_mix   (t_granular* x, t_double* out, t_int32 sampleframes);
+
+// ====  RENDER KERNELS  ====
+
+t_kernel  kernel_select   (t_interp_type interp, t_env_mode env_mode, t_int16 n_chn, t_bool glide);
+t_kernel  kernel_osc_select (t_int8 src_mode, t_env_mode env_mode);
+void      kernel_generic  (t_grain* grain, t_double* out, t_int32 n, float* buff_src, float* env_values,
+  t_int32 n_chn, t_int32 env_len, t_double mult, t_double mult_inc);
+
 // ========  GLOBAL CLASS POINTER AND STATIC VARIABLES  ========
 
 static t_class*   granular_class = NULL;
@@ -230,8 +846,16 @@ static t_symbol*  sym_on;
 static t_symbol*  sym_off;
 static t_symbol*  sym_all;
 static t_symbol*  sym_seeder;
+static t_symbol*  sym_seeders;
 static t_symbol*  sym_active;
+static t_symbol*  sym_seeder_load;
+static t_symbol*  sym_hist_conc;
+static t_symbol*  sym_hist_life;
+static t_symbol*  sym_hist_spawn;
+static t_symbol*  sym_grains_hwm;
+static t_symbol*  sym_grains;
 static t_symbol*  sym_env;
+static t_symbol*  sym_viz;
 
 // ========  INITIALIZATION ROUTINE  ========
 
@@ -241,8 +865,11 @@ int C74_EXPORT main(void) {
 
   class_addmethod(c, (method)granular_notify, "notify", A_CANT, 0);
   class_addmethod(c, (method)granular_dsp64,  "dsp64",  A_CANT, 0);
+  class_addmethod(c, (method)granular_dspstate, "dspstate", A_CANT, 0);
   class_addmethod(c, (method)granular_assist, "assist", A_CANT, 0);
 
+  class_addmethod(c, (method)granular_restart,      "restart",      A_SYM,   0);
+
   class_addmethod(c, (method)granular_master,       "master",       A_FLOAT, 0);
   class_addmethod(c, (method)granular_all_on,       "all_on",                0);
   class_addmethod(c, (method)granular_all_off,      "all_off",               0);
@@ -250,6 +877,15 @@ int C74_EXPORT main(void) {
   class_addmethod(c, (method)granular_post_grains,  "post_grains",           0);
   class_addmethod(c, (method)granular_post_buffers, "post_buffers",          0);
   class_addmethod(c, (method)granular_get_active,   "get_active",            0);
+  class_addmethod(c, (method)granular_get_grains,   "get_grains",            0);
+  class_addmethod(c, (method)granular_load,         "load",         A_LONG,  0);
+  class_addmethod(c, (method)granular_get_seeder_load, "get_seeder_load",    0);
+  class_addmethod(c, (method)granular_get_hist,     "get_hist",              0);
+  class_addmethod(c, (method)granular_clear_hist,   "clear_hist",            0);
+  class_addmethod(c, (method)granular_timeline,     "timeline",     A_LONG,  0);
+  class_addmethod(c, (method)granular_timeline_dump, "timeline_dump", A_SYM, 0);
+  class_addmethod(c, (method)granular_autogain,     "autogain",     A_GIMME, 0);
+  class_addmethod(c, (method)granular_viz,          "viz",          A_FLOAT, 0);
 
   class_addmethod(c, (method)granular_set_seeder,   "set_seeder",   A_GIMME, 0);
   class_addmethod(c, (method)granular_get_seeder,   "get_seeder",   A_GIMME, 0);
@@ -267,6 +903,19 @@ int C74_EXPORT main(void) {
   class_addmethod(c, (method)granular_period_rand,  "period_rand",  A_GIMME, 0);
   class_addmethod(c, (method)granular_buffer,       "buffer",       A_GIMME, 0);
   class_addmethod(c, (method)granular_file,         "file",         A_GIMME, 0);
+  class_addmethod(c, (method)granular_interp,       "interp",       A_GIMME, 0);
+  class_addmethod(c, (method)granular_oversample,   "oversample",   A_GIMME, 0);
+  class_addmethod(c, (method)granular_memory,       "memory",       A_GIMME, 0);
+  class_addmethod(c, (method)granular_normalize,    "normalize",    A_GIMME, 0);
+  class_addmethod(c, (method)granular_pool,         "pool",         A_GIMME, 0);
+  class_addmethod(c, (method)granular_loop,         "loop",         A_GIMME, 0);
+  class_addmethod(c, (method)granular_boundary,     "boundary",     A_GIMME, 0);
+  class_addmethod(c, (method)granular_glisson,      "glisson",      A_GIMME, 0);
+  class_addmethod(c, (method)granular_source,       "source",       A_GIMME, 0);
+  class_addmethod(c, (method)granular_ring,         "ring",         A_GIMME, 0);
+  class_addmethod(c, (method)granular_render,       "render",       A_GIMME, 0);
+  class_addmethod(c, (method)granular_soak,         "soak",         A_GIMME, 0);
+  class_addmethod(c, (method)granular_bench,        "bench",        A_GIMME, 0);
 
   class_addmethod(c, (method)granular_envelope,     "envelope",     A_GIMME, 0);
   class_addmethod(c, (method)granular_output_env,   "output_env",   A_GIMME, 0);
@@ -285,8 +934,18 @@ int C74_EXPORT main(void) {
   sym_off         = gensym("off");
   sym_all         = gensym("all");
   sym_seeder      = gensym("seeder");
+  sym_seeders     = gensym("seeders");
   sym_active      = gensym("active");
+  sym_seeder_load = gensym("seeder_load");
+  sym_hist_conc   = gensym("hist_concurrency");
+  sym_hist_life   = gensym("hist_lifetime");
+  sym_hist_spawn  = gensym("hist_spawns");
+  sym_grains_hwm  = gensym("grains_hwm");
+  sym_grains      = gensym("grains");
   sym_env         = gensym("env");
+  sym_viz         = gensym("viz");
+
+  wt_init();
 
   return 0;
 }
@@ -308,6 +967,7 @@ void* granular_new(t_symbol* sym, t_int16 argc, t_atom* argv) {
 
   // Inlets and outlets
   dsp_setup((t_pxobject*)x, 1);                      // One MSP inlet
+  x->obj.z_misc |= Z_NO_INPLACE;                      // The input is recorded after the output is written
 
   x->outl_compl   = bangout((t_object*)x);            // Outlet 3: Bang outlet to indicate task completion
   x->outl_mess    = outlet_new((t_object*)x, NULL);   // Outlet 2: General message outlet
@@ -328,10 +988,14 @@ void* granular_new(t_symbol* sym, t_int16 argc, t_atom* argv) {
     x->grains_max  = (t_int16)atom_getlong(argv);
   }
 
-  // If there are two arguments provided
+  // If there are two arguments provided: the number of seeders is limited so that the replies covering them fit in one message
   else if ((argc == 2) && (atom_gettype(argv) == A_LONG) && (atom_gettype(argv) == A_LONG)) {
-    x->seeders_max = (t_int16)atom_getlong(argv);
+    x->seeders_max = (t_int16)((atom_getlong(argv) > SEEDERS_LIMIT) ? SEEDERS_LIMIT : atom_getlong(argv));
     x->grains_max  = (t_int16)atom_getlong(argv + 1);
+
+    if (atom_getlong(argv) > SEEDERS_LIMIT) {
+      MY_ERR("granular_new:  The maximum number of seeders is %i. Was %i instead.", SEEDERS_LIMIT, (t_int32)atom_getlong(argv));
+    }
   }
 
   // Otherwise arguments are invalid and default values are used
@@ -351,8 +1015,10 @@ void* granular_new(t_symbol* sym, t_int16 argc, t_atom* argv) {
   POST("granular_new:  Granular object created. Maximum of %i seeders and %i grains.", x->seeders_max, x->grains_max);
   POST("  You need to link seeders to buffers and load files before being able to use the granular object.");
 
-  // Initialize samplerate
+  // Initialize samplerate and restart mode
   x->msamplerate  = sys_getsr() * 0.001;
+  x->restart_mode = RESTART_RESCALE;
+  x->dsp_stopped  = true;
 
   // Initialize master level and maximum number of grain streams per seeder
   x->master     = 1.;
@@ -363,30 +1029,85 @@ void* granular_new(t_symbol* sym, t_int16 argc, t_atom* argv) {
   x->grains_arr   = (t_grain*)sysmem_newptr(sizeof(t_grain)* x->grains_max);
   x->grains_list  = list_new(x->grains_max);
 
+  // Allocate the parameter queue
+  x->param_queue  = pq_new(PARAM_QUEUE_LEN);
+  x->engine_owned = 0;
+
+  // Initialize automatic gain
+  x->autogain_target  = 0;
+  x->autogain_max     = AUTOGAIN_MAX;
+  x->overlap_e        = 0;
+
+  // Initialize load accounting
+  x->load_on          = false;
+  x->load_ticks       = 0;
+  x->load_prev_ticks  = 0;
+  x->load_w           = 0;
+  x->load_r           = 1;
+  x->load_mid         = 2;
+
+  // Initialize the grain histograms
+  memset(&x->hist, 0, sizeof(t_hist));
+  x->hist.conc_width  = (x->grains_max + HIST_N_BIN) / HIST_N_BIN;
+  x->hist_clear       = 0;
+
+  // The timeline is allocated when first turned on
+  x->tl               = NULL;
+  x->tl_on            = false;
+
+  // Initialize the record ring, allocated by the ring message
+  x->ring         = NULL;
+  x->ring_rec     = NULL;
+  x->ring_len     = 0;
+  x->ring_len_ms  = 0;
+  x->ring_w       = 0;
+  x->ring_fb      = 0;
+
   // Allocate and initialize seeder array and index list
   x->seeders_cnt  = 0;
   x->seeders_list = list_new(x->seeders_max);
   x->seeders_arr  = (t_seeder*)sysmem_newptr(sizeof(t_seeder) * x->seeders_max);
   x->seeders_foc  = 0;
 
+  // Allocate the message array once, for the replies covering all the seeders
+  x->mess_cap     = ((x->seeders_max * MESS_SEEDER_LEN > MESS_MIN) ? x->seeders_max * MESS_SEEDER_LEN : MESS_MIN);
+  x->mess_arr     = (t_atom*)sysmem_newptr(sizeof(t_atom) * x->mess_cap);
+
   // Initialize each seeder
   x->env_n_frm = ENV_N_SMP;
 
+  x->env_retired_cnt = 0;
+  x->src_retired_cnt = 0;
+  x->blk_retired_cnt = 0;
+  x->epoch           = 0;
+
   for (t_int16 index = 0; index < x->seeders_max; index++) {
 
     t_seeder* seeder = x->seeders_arr + index;
 
     seeder->index       = index;
     seeder->is_on       = false;
+    seeder->on_msg      = false;
 
     seeder->ampl        = 1;
     seeder->src_begin   = 0;
     seeder->src_len_ms  = 100;
-    seeder->src_len     = (t_int32)(seeder->src_len_ms * x->msamplerate);
+    seeder->len_ms      = 100;
+    seeder->src_len     = (t_int32)(seeder->len_ms * x->msamplerate);
     seeder->shift       = 0;
     seeder->shift_r     = 1;
     seeder->out_len     = (t_int32)(seeder->src_len * seeder->shift_r);
 
+    seeder->src_pos       = 0;
+    seeder->play_dir      = 1;
+    seeder->bound_mode    = BOUND_WRAP;
+    seeder->bound_msg     = BOUND_WRAP;
+    seeder->loop_begin_ms = 0;
+    seeder->loop_end_ms   = 0;
+    seeder->loop_begin    = 0;
+    seeder->loop_end      = 0;
+    seeder->loop          = NULL;
+
     seeder->period      = 0.37;
     seeder->period_len  = (t_int32)(seeder->out_len * seeder->period);
     seeder->speed       = 1;
@@ -397,6 +1118,19 @@ void* granular_new(t_symbol* sym, t_int16 argc, t_atom* argv) {
     seeder->shift_rand  = 0.25;
     seeder->period_rand = 0.25;
 
+    seeder->src_mode    = SRC_MODE_BUFFER;
+    seeder->src_mode_msg = SRC_MODE_BUFFER;
+    seeder->wave        = WAVE_SINE;
+    seeder->freq        = 440;
+    seeder->freq_rand   = 0;
+    seeder->duty        = 1;
+    seeder->ring_behind_ms  = 0;
+
+    seeder->glide       = false;
+    seeder->glide_begin = 0;
+    seeder->glide_end   = 0;
+    seeder->glide_rand  = 0;
+
     seeder->buff_sym    = sym_empty;
     seeder->buff_ref    = NULL;
     seeder->buff_obj    = NULL;
@@ -409,20 +1143,41 @@ void* granular_new(t_symbol* sym, t_int16 argc, t_atom* argv) {
     seeder->buff_path   = sym_empty;
     seeder->buff_is_chg = false;
 
+    seeder->pool_mode   = POOL_OFF;
+    seeder->pool_cnt    = 0;
+    seeder->pool_next   = 0;
+    seeder->pool_arr    = NULL;
+    seeder->pool_table  = NULL;
+
+    seeder->mem_mode    = MEM_MODE_OFF;
+    seeder->src_handle  = NULL;
+
+    seeder->norm_target = 0;
+    seeder->norm_max    = NORM_MAX;
+    seeder->psum        = NULL;
+
     seeder->env_type    = ENV_HANN;
     seeder->env_sym     = gensym("hann");
     seeder->env_alpha   = 0;
     seeder->env_beta    = 0;
-    seeder->env_values  = (float*)sysmem_newptr((long)(x->env_n_frm * sizeof(float)));
+    seeder->env_table   = granular_env_new(x);
+    seeder->interp      = INTERP_LINEAR;
+    seeder->os_ind      = 0;
 
     t_double f;
     for (t_int16 i = 0; i < x->env_n_frm; i++) {
       f = (t_double)i / (x->env_n_frm - 1);
-      seeder->env_values[i] = (float)env_hann(f, seeder->env_alpha, seeder->env_beta);
+      seeder->env_table->values[i] = (float)env_hann(f, seeder->env_alpha, seeder->env_beta);
     }
 
+    seeder->env_table->mode = ENV_MODE_TABLE;
+    granular_env_ms(x, seeder->env_table);
+
     seeder->poly_cnt        = 1;
     seeder->period_cntd[0]  = 0;
+
+    memset(&seeder->load, 0, sizeof(t_load));
+    memset(&seeder->load_prev, 0, sizeof(t_load));
   }
 
   // Initialize envelope output buffer
@@ -430,6 +1185,44 @@ void* granular_new(t_symbol* sym, t_int16 argc, t_atom* argv) {
   x->buff_env_ref = NULL;
   x->buff_env_obj = NULL;
 
+  // Initialize oversampled buses, allocated when the DSP starts
+  x->vector_max = 0;
+
+  for (t_int16 i = 0; i < OS_N_BUS; i++) {
+    x->os_bus[i]  = NULL;
+    x->os_hb[i]   = NULL;
+    x->os_used[i] = false;
+    x->os_tail[i] = 0;
+  }
+
+  // Published load counters, allocated once the number of seeders is known
+  for (t_int16 i = 0; i < 3; i++) {
+    x->load_snaps[i] = (t_load*)sysmem_newptr(sizeof(t_load) * (x->seeders_max + 1));
+    memset(x->load_snaps[i], 0, sizeof(t_load) * (x->seeders_max + 1));
+  }
+
+  // Initialize grain cloud visualization
+  x->buff_viz_sym = sym_empty;
+  x->buff_viz_ref = NULL;
+  x->viz_fps      = 0;
+  x->viz_cntd     = 0;
+
+  for (t_int16 i = 0; i < 3; i++) {
+    x->viz_snaps[i] = (t_grain_snap*)sysmem_newptr(sizeof(t_grain_snap) * x->grains_max);
+    x->viz_cnt[i]   = 0;
+  }
+
+  x->viz_w      = 0;
+  x->viz_r      = 1;
+  x->viz_mid    = 2;
+  x->viz_clock  = clock_new(x, (method)granular_viz_tick);
+  x->viz_qelem  = qelem_new(x, (method)granular_viz_write);
+  x->viz_grains = 0;
+  x->viz_mess   = (t_atom*)sysmem_newptr(sizeof(t_atom) * (2 + VIZ_N_VAL * GRAINS_MESS_MAX));
+
+  x->soak       = NULL;
+  x->soak_qelem = qelem_new(x, (method)granular_soak_slice);
+
   // Initialize random
   srand((unsigned int)time(NULL));
 
@@ -442,25 +1235,73 @@ void granular_free(t_granular* x) {
 
   TRACE("granular_free");
 
+  // Stop a soak run in progress
+  qelem_free(x->soak_qelem);
+  granular_soak_free(x);
+
   // Free grains array and list
   sysmem_freeptr(x->grains_arr);
   list_free(x->grains_list);
 
+  // Free the parameter queue and record ring
+  pq_free(x->param_queue);
+  if (x->ring != NULL) { sysmem_freeptr(x->ring); }
+
   // Free seeders buffer references and envelope arrays
   t_seeder* seeder;
   for (t_int16 index = 0; index < x->seeders_max; index++) {
     seeder = x->seeders_arr + index;
     if (seeder->buff_ref != NULL) { object_free(seeder->buff_ref); }
-    sysmem_freeptr(seeder->env_values);
+    if (seeder->src_handle != NULL) { mem_free(&seeder->src_handle->mem); sysmem_freeptr(seeder->src_handle); }
+    if (seeder->psum != NULL) { sysmem_freeptr(seeder->psum); }
+    if (seeder->loop != NULL) { sysmem_freeptr(seeder->loop); }
+    sysmem_freeptr(seeder->env_table);
+
+    if (seeder->pool_table != NULL) {
+      t_pool_table* table = (t_pool_table*)seeder->pool_table->data;
+      for (t_int16 i = 0; i < table->cnt; i++) {
+        if (table->handle[i] != NULL) { sysmem_freeptr(table->handle[i]); }
+      }
+      sysmem_freeptr(seeder->pool_table);
+    }
+
+    if (seeder->pool_arr != NULL) {
+      for (t_int16 i = 0; i < POOL_MAX; i++) {
+        if (seeder->pool_arr[i].buff_ref != NULL) { object_free(seeder->pool_arr[i].buff_ref); }
+      }
+      sysmem_freeptr(seeder->pool_arr);
+    }
   }
 
+  // Free the retired envelope tables, source handles and shared blocks
+  granular_env_reclaim(x, true);
+  granular_src_reclaim(x, true);
+  granular_block_reclaim(x, true);
+
   // Free seeders array and list
   sysmem_freeptr(x->seeders_arr);
+  sysmem_freeptr(x->mess_arr);
+  tl_free(x->tl);
   list_free(x->seeders_list);
 
   // Free envelope buffer
   if (x->buff_env_ref != NULL) { object_free(x->buff_env_ref); }
 
+  // Free oversampled buses and decimators
+  for (t_int16 i = 1; i < OS_N_BUS; i++) {
+    if (x->os_bus[i]) { sysmem_freeptr(x->os_bus[i]); }
+    hb_free(x->os_hb[i]);
+  }
+
+  // Free visualization clock, queue element, snapshots and buffer
+  object_free(x->viz_clock);
+  qelem_free(x->viz_qelem);
+  for (t_int16 i = 0; i < 3; i++) { sysmem_freeptr(x->viz_snaps[i]); }
+  sysmem_freeptr(x->viz_mess);
+  if (x->buff_viz_ref != NULL) { object_free(x->buff_viz_ref); }
+
+  for (t_int16 i = 0; i < 3; i++) { sysmem_freeptr(x->load_snaps[i]); }
+
   dsp_free((t_pxobject*)x);
 }
 
@@ -471,6 +1312,8 @@ t_max_err granular_notify(t_granular* x, t_symbol* sender_sym, t_symbol* msg, vo
   TRACE("granular_notify");
 
   t_symbol* class_name = object_classname(data);
+  t_max_err err = MAX_ERR_NONE, ret;
+  t_bool    found = false;
 
   //==== If the object sending the notification is a buffer
   if (class_name == gensym("buffer~")) {
@@ -478,8 +1321,21 @@ t_max_err granular_notify(t_granular* x, t_symbol* sender_sym, t_symbol* msg, vo
     //== Get the name of the buffer
     t_symbol* buff_name = object_method_direct(t_symbol *, (t_object*), data, gensym("getname"));
 
+    // The same buffer can be used in several roles: every reference to it is notified, keeping the first error
+
     // If it is the envelope output buffer
-    if (buff_name == x->buff_env_sym) { return buffer_ref_notify(x->buff_env_ref, sender_sym, msg, sender_ptr, data); }
+    if (buff_name == x->buff_env_sym) {
+      ret = buffer_ref_notify(x->buff_env_ref, sender_sym, msg, sender_ptr, data);
+      if (err == MAX_ERR_NONE) { err = ret; }
+      found = true;
+    }
+
+    // If it is the visualization buffer
+    if (buff_name == x->buff_viz_sym) {
+      ret = buffer_ref_notify(x->buff_viz_ref, sender_sym, msg, sender_ptr, data);
+      if (err == MAX_ERR_NONE) { err = ret; }
+      found = true;
+    }
 
     // Loop through the source buffers
     for (t_int16 index = 0; index < x->seeders_max; index++) {
@@ -490,21 +1346,53 @@ t_max_err granular_notify(t_granular* x, t_symbol* sender_sym, t_symbol* msg, vo
       // If it is one of the source buffers
       if ((buff_name == seeder->buff_sym) && (buff_obj)) {
 
+        seeder->buff_obj   = buff_obj;
         seeder->buff_n_frm = (t_int32)buffer_getframecount(buff_obj);
         seeder->buff_n_chn = (t_int16)buffer_getchannelcount(buff_obj);
         seeder->buff_msr   = buffer_getmillisamplerate(buff_obj);
-        seeder->src_len    = (t_int32)(seeder->src_len_ms * seeder->buff_msr);
 
         POST("notify - %s:  Buffer %s, Length: %ims, Frames: %i, Channels: %i, Samplerate: %.0f, File: %s",
           msg->s_name, seeder->buff_sym->s_name, (t_int16)(seeder->buff_n_frm / seeder->buff_msr),
           seeder->buff_n_frm, seeder->buff_n_chn, 1000 * seeder->buff_msr, seeder->buff_file->s_name);
 
-        return buffer_ref_notify(seeder->buff_ref, sender_sym, msg, sender_ptr, data);
+        // Publish a new source handle, with a new engine owned copy when the content of the buffer changed
+        if ((seeder->mem_mode != MEM_MODE_OFF) && (msg == gensym("buffer_modified"))) { granular_memory_load(x, seeder); }
+        else if (seeder->mem_mode == MEM_MODE_OFF) { granular_src_publish(x, seeder, NULL); }
+        if ((seeder->norm_target > 0) && (msg == gensym("buffer_modified"))) { granular_psum_load(x, seeder); }
+        if (msg == gensym("buffer_modified")) { granular_loop_update(x, seeder); }
+
+        // The audio thread sets the length in frames from the new source
+        granular_param_push(x, index, PARAM_LENGTH, seeder->src_len_ms);
+
+        ret = buffer_ref_notify(seeder->buff_ref, sender_sym, msg, sender_ptr, data);
+        if (err == MAX_ERR_NONE) { err = ret; }
+        found = true;
+      }
+    }
+
+    // Loop through the pool buffers: one new pool table per seeder, with new handles for all its sources reading the buffer
+    for (t_int16 index = 0; index < x->seeders_max; index++) {
+
+      t_seeder* seeder = x->seeders_arr + index;
+      t_bool    in_pool = false;
+
+      for (t_int16 i = 0; i < seeder->pool_cnt; i++) {
+
+        t_pool_src* src = seeder->pool_arr + i;
+
+        if (buff_name == src->buff_sym) {
+          ret = buffer_ref_notify(src->buff_ref, sender_sym, msg, sender_ptr, data);
+          if (err == MAX_ERR_NONE) { err = ret; }
+          in_pool = true;
+        }
       }
+
+      if (in_pool) { granular_pool_publish(x, seeder, buff_name); found = true; }
     }
 
     // If it is any other buffer
-    POST("notify:  Buffer \"%s\" - %s", buff_name->s_name, msg->s_name); return 0;
+    if (!found) { POST("notify:  Buffer \"%s\" - %s", buff_name->s_name, msg->s_name); }
+    return err;
   }
 
   // In all other cases
@@ -525,27 +1413,64 @@ void granular_dsp64(t_granular* x, t_object* dsp64, t_int16* count, t_double sam
   x->connected[1] = count[1];   // Number of signal connections going out
   POST("Samplerate = %.0f - Maxvectorsize = %i - Count: %i %i", samplerate, maxvectorsize, x->connected[0], x->connected[1]);
 
+  // Apply the parameter changes still pending at the previous samplerate
+  if (granular_engine_acquire(x)) {
+    granular_param_drain(x);
+    granular_engine_release(x);
+  }
+
+  // Carry the live grains and seeder countdowns over to the new samplerate. A recompile of the DSP chain
+  // at the same samplerate, while the DSP keeps running, is not a restart
+  t_double ratio = ((x->msamplerate > 0) ? (samplerate * 0.001 / x->msamplerate) : 1);
+  granular_rescale(x, ratio, (x->dsp_stopped || (ratio != 1)));
+  x->dsp_stopped = false;
+
   // Recalculate everything that depends on the samplerate
   x->msamplerate = samplerate * 0.001;
 
+  if ((x->ring_len_ms > 0) && (x->ring_len != (t_int32)(x->ring_len_ms * x->msamplerate))) { granular_ring_alloc(x); }
+
   for (t_int16 index = 0; index < x->seeders_max; index++) {
-    x->seeders_arr[index].out_len    = (t_int32)(x->seeders_arr[index].src_len_ms * x->seeders_arr[index].shift_r * x->msamplerate);
+    x->seeders_arr[index].out_len    = (t_int32)(x->seeders_arr[index].len_ms * x->seeders_arr[index].shift_r * x->msamplerate);
     x->seeders_arr[index].period_len = (t_int32)(x->seeders_arr[index].out_len * x->seeders_arr[index].period);
   }
-}
 
-// ========  METHOD: GRANULAR_PERFORM64  ========
+  // Allocate the oversampled buses and decimators for the new vector size
+  if (maxvectorsize != x->vector_max) {
 
-void granular_perform64(t_granular* x, t_object* dsp64, t_double** ins, t_int16 numins, t_double** outs, t_int16 numouts,
-  t_int32 sampleframes, t_int32 flags, void* userparam) {
+    x->vector_max = maxvectorsize;
 
-  //TRACE("granular_perform64");
+    for (t_int16 i = 1; i < OS_N_BUS; i++) {
+      if (x->os_bus[i]) { sysmem_freeptr(x->os_bus[i]); }
+      hb_free(x->os_hb[i]);
+      x->os_bus[i] = (t_double*)sysmem_newptr((maxvectorsize << i) * sizeof(t_double));
+      x->os_hb[i]  = hb_new(maxvectorsize << i);
+    }
+  }
+
+  for (t_int16 i = 1; i < OS_N_BUS; i++) {
+    if (x->os_hb[i]) { hb_reset(x->os_hb[i]); }
+    x->os_tail[i] = 0;
+  }
+}
+
+// ========  PROCEDURE: GRANULAR_PERFORM_BLOCK  ========
+// Schedule and render one sub-block of at most SUBBLOCK_LEN samples, called by granular_perform64.
+// The output is written from out_block[0] to out_block[sampleframes - 1].
+
+void granular_perform_block(t_granular* x, t_double* out_block, t_int32 sampleframes) {
 
   //====== Seeder variables
   t_seeder* seeder;
 
   t_int16*  node = x->seeders_list->first_used;
   t_int32   period;
+  float*    buff_src;
+  float*    src_mem;
+  t_src_handle* handle;
+  t_double  src_msr;
+
+  TL_BEGIN(tl_seeders);
 
   //====== BEGIN: SEEDER LOOP
   while (*node != LIST_END) {
@@ -556,24 +1481,28 @@ void granular_perform64(t_granular* x, t_object* dsp64, t_double** ins, t_int16
     //==== If the seeder is active
     if (seeder->is_on) {
 
+      //== The source metadata is read from the published handle, never from the seeder fields the message threads write
+      handle  = PTR_ACQUIRE(seeder->src_handle);
+      src_msr = (handle ? handle->msr : x->msamplerate);
+
       //== Process the main grain stream
 
-      //== Add all the grains that the seeder generates this vector cycle
+      //== Add all the grains that the seeder generates this sub-block, none once it stopped
       while (seeder->period_cntd[0] < sampleframes) {
 
         // Add a grain
-        granular_add_grain_fs(x, seeder, 0, seeder->period_cntd[0]);
+        if (seeder->play_dir) { granular_add_grain_fs(x, seeder, 0, seeder->period_cntd[0]); }
 
-        // Calculate and add the period for the next grain
+        // Calculate and add the period for the next grain, at least one sample so that the stream moves on
+        // when the grains are shorter than a sample or the randomness exceeds the period
         period = (t_int32)(seeder->period_len * (1 + (seeder->period_rand * (2.0 * rand() / RAND_MAX - 1))));
+        if (period < 1) { period = 1; }
         seeder->period_cntd[0] += period;
 
-        // Calculate the beginning for the next grain, using the speed value
-        seeder->src_begin += (t_int32)(period * seeder->speed * seeder->buff_msr / x->msamplerate);
-
-        // Test the boundaries and adjust if necessary
-        if (seeder->src_begin < 0) { seeder->src_begin = seeder->buff_n_frm - seeder->src_len; }
-        if (seeder->src_begin + seeder->src_len > seeder->buff_n_frm) { seeder->src_begin = 0; }
+        // Move the play position for the next grain, using the speed value, and apply the boundary mode
+        seeder->src_pos += (t_int64)(seeder->play_dir * period * seeder->speed * src_msr / x->msamplerate
+          * (1 << POS_FRAC_BITS));
+        granular_bound(seeder);
       }
 
       //== Loop through the poly streams
@@ -582,19 +1511,48 @@ void granular_perform64(t_granular* x, t_object* dsp64, t_double** ins, t_int16
         while (seeder->period_cntd[i] < sampleframes) {
 
           // Add a grain
-          granular_add_grain_fs(x, seeder, (t_int32)((seeder->period_cntd[i] - seeder->period_cntd[0]) * seeder->speed
-            * seeder->buff_msr / x->msamplerate), seeder->period_cntd[i]);
-
-          // Calculate and add the period for the next grain
-          seeder->period_cntd[i] += (t_int32)(seeder->period_len * (1 + (seeder->period_rand * (2.0 * rand() / RAND_MAX - 1))));
+          if (seeder->play_dir) {
+            granular_add_grain_fs(x, seeder, (t_int32)((seeder->period_cntd[i] - seeder->period_cntd[0]) * seeder->speed
+              * src_msr / x->msamplerate), seeder->period_cntd[i]);
+          }
+
+          // Calculate and add the period for the next grain, at least one sample
+          period = (t_int32)(seeder->period_len * (1 + (seeder->period_rand * (2.0 * rand() / RAND_MAX - 1))));
+          seeder->period_cntd[i] += ((period < 1) ? 1 : period);
         }
 
-        //== Set the period countdown for the next vector cycle
+        //== Set the period countdown for the next sub-block
         seeder->period_cntd[i] -= sampleframes;
       }
 
-      //== Set the period countdown for the next vector cycle
+      //== Set the period countdown for the next sub-block
       seeder->period_cntd[0] -= sampleframes;
+
+      //== Prefetch the source windows of the grains that will be added in the next sub-block
+      //== Oscillator grains read from wavetables that stay in the cache, and have no source buffer to lock
+      //== The buffer is only locked when a stream adds a grain in the next sub-block, which most sub-blocks do not
+      t_bool due = (seeder->period_cntd[0] < sampleframes);
+      for (t_int16 i = 1; !due && (i < seeder->poly_cnt); i++) { due = (seeder->period_cntd[i] < sampleframes); }
+
+      src_mem  = (handle ? (float*)handle->mem.ptr : NULL);
+      buff_src = ((!due || (seeder->src_mode != SRC_MODE_BUFFER) || !handle) ? NULL
+        : (src_mem ? src_mem : buffer_locksamples(handle->buff_obj)));
+
+      if (buff_src) {
+
+        if (seeder->period_cntd[0] < sampleframes) { granular_prefetch_fs(x, seeder, buff_src, 0); }
+
+        for (t_int16 i = 1; i < seeder->poly_cnt; i++) {
+          if (seeder->period_cntd[i] < sampleframes) {
+            granular_prefetch_fs(x, seeder, buff_src, (t_int32)((seeder->period_cntd[i] - seeder->period_cntd[0])
+              * seeder->speed * src_msr / x->msamplerate));
+          }
+        }
+
+        PREFETCH(PTR_ACQUIRE(seeder->env_table)->values);
+      }
+
+      if (buff_src && !src_mem) { buffer_unlocksamples(handle->buff_obj); }
     }
 
     //==== Iterate the seeder index list
@@ -603,19 +1561,26 @@ void granular_perform64(t_granular* x, t_object* dsp64, t_double** ins, t_int16
 
   //====== END: SEEDER LOOP
 
+  TL_END(tl_seeders, TL_AUDIO, TL_SEEDERS, -1);
+
   //====== Set the output vector to 0
   t_int32   n = sampleframes;
-  t_double* out = outs[0];
+  t_double* out = out_block;
   while (n--) { *out++ = 0; }
 
   //====== Grain and calculation variables
   t_grain*  grain;
-  t_int32   ind, src_len, env_len, out_len;
-  t_double  mult, inv_out_len;
-  float*    buff_src;
+  t_double  mult;
+  t_double  mult_inc;
+  t_buffer_obj* buff_obj;
+  t_int16   n_chn;
+  t_uint64  ticks;
+  t_double  overlap_e = 0;
 
   node = x->grains_list->first_used;
 
+  TL_BEGIN(tl_grains);
+
   //====== BEGIN: GRAIN LOOP
   while (*node != LIST_END) {
 
@@ -623,50 +1588,98 @@ void granular_perform64(t_granular* x, t_object* dsp64, t_double** ins, t_int16
     grain = x->grains_arr + *node;
     seeder = x->seeders_arr + grain->index;
 
-    //==== Set local variables
-    out     = outs[0] + grain->out_begin;
-    n       = sampleframes - grain->out_begin;
-    mult    = x->master * grain->ampl;
-    src_len = grain->src_len - 1;
-    out_len = grain->out_len - 1;
-    env_len = x->env_n_frm - 1;
-    inv_out_len = 1 / (t_double)out_len;
+    //==== Number of samples to write this sub-block, at the rate of the grain's bus
+    n = (sampleframes << grain->os_ind) - grain->out_begin;
+    if (n > grain->out_cntd) { n = grain->out_cntd; }
 
-    //====== Access and lock the source buffer
-    buff_src = buffer_locksamples(seeder->buff_obj);
+    //==== Fading grains end with the fade, with a gain ramped every sample down to the last sample of the fade
+    mult = x->master * grain->ampl;
+    mult_inc = 0;
 
-    //==== Write the grain to the output
-    while (n && grain->out_cntd) {
+    if (grain->fading) {
+      if (grain->out_cntd > grain->fade_cntd) { grain->out_cntd = grain->fade_cntd; }
+      if (n > grain->out_cntd) { n = grain->out_cntd; }
+      mult_inc = -mult / grain->fade_len;
+      mult *= (t_double)grain->fade_cntd / grain->fade_len;
+      grain->fade_cntd -= n;
+    }
+
+    out = (grain->os_ind ? granular_os_bus(x, grain->os_ind, sampleframes) : out_block);
+
+    //====== Access and lock the source buffer, unless the seeder reads from its own copy
+    if ((grain->pool_ind == POOL_NONE) || (grain->pool_ind >= 0)) {
+      handle   = grain->src_handle;
+      buff_obj = (handle ? handle->buff_obj : NULL);
+      n_chn    = (handle ? handle->n_chn : 0);
+      src_mem  = (handle ? (float*)handle->mem.ptr : NULL);
+    }
+    else if (grain->pool_ind == POOL_LOOP) {
+      buff_obj = NULL;
+      n_chn    = grain->block->n_chn;
+      src_mem  = (float*)grain->block->data;
+    }
+    else if (grain->pool_ind == POOL_OSC) {
+      buff_obj = NULL;
+      n_chn    = 1;
+      src_mem  = grain->table;
+    }
+    else {
+      buff_obj = NULL;
+      n_chn    = 1;
+      src_mem  = (float*)grain->block->data;
+    }
 
-      //== Calculate interpolated values from buffer and envelope
-      ind = (grain->src_begin + grain->src_I) * seeder->buff_n_chn;
-      *out++ += mult
-        * (seeder->env_values[grain->env_I] + grain->env_R * inv_out_len * (seeder->env_values[grain->env_I + 1] - seeder->env_values[grain->env_I]))
-        * (buff_src[ind] + grain->src_R * inv_out_len * (buff_src[ind + seeder->buff_n_chn] - buff_src[ind]));
+    TL_BEGIN(tl_lock);
+    buff_src = (src_mem ? src_mem : (buff_obj ? buffer_locksamples(buff_obj) : NULL));
 
-      //== Iterate integer and fractional values
-      grain->src_R += src_len;
-      while (grain->src_R >= out_len) { grain->src_R -= out_len; grain->src_I++; }
+    //==== Long waits for the buffer lock show on the timeline
+    if (tl_lock && !src_mem && (CYCLE_COUNT() - tl_lock > TL_LOCK_MIN)) { TL_END(tl_lock, TL_AUDIO, TL_LOCK, grain->index); }
 
-      grain->env_R += env_len;
-      while (grain->env_R >= out_len) { grain->env_R -= out_len; grain->env_I++; }
+    //==== A buffer resized or reloaded since the grain was added is skipped until the grain ends
+    if (buff_src && !src_mem && ((buffer_getchannelcount(buff_obj) != n_chn)
+      || (buffer_getframecount(buff_obj) < grain->src_begin + grain->src_len))) {
+      buffer_unlocksamples(buff_obj);
+      buff_src = NULL;
+    }
 
-      n--; grain->out_cntd--;
+    //==== Write the grain to the output, timing the kernel when the load accounting is on
+    if (buff_src && ATOMIC_LOAD(x->load_on)) {
+      ticks = CYCLE_COUNT();
+      grain->kernel(grain, out + grain->out_begin, n, buff_src, grain->env_table->values,
+        n_chn, x->env_n_frm - 1, mult, mult_inc);
+      seeder->load.ticks += CYCLE_COUNT() - ticks;
+      seeder->load.smp   += n;
+    }
+    else if (buff_src) {
+      grain->kernel(grain, out + grain->out_begin, n, buff_src, grain->env_table->values,
+        n_chn, x->env_n_frm - 1, mult, mult_inc);
     }
 
+    grain->out_cntd -= n;
+    grain->played   += n;
+
     //====== Unlock the samples
-    buffer_unlocksamples(seeder->buff_obj);
+    if (!src_mem && buff_src) { buffer_unlocksamples(buff_obj); }
 
     //==== Reset the output beginning to zero in case the grain was new
     grain->out_begin = 0;
 
-    //==== If the grain is unfinished iterate the grain index list
+    //==== If the grain is unfinished add its energy and iterate the grain index list
     if (grain->out_cntd != 0) {
+      overlap_e += grain->energy;
       node = x->grains_list->array + *node;
     }
 
     //==== Otherwise remove the grain and do not increment the index list
     else {
+      t_uint32 life = (t_uint32)(grain->played >> grain->os_ind);
+      t_int16  bin = 0;
+      while (life && (bin < HIST_N_BIN - 1)) { life >>= 1; bin++; }
+      x->hist.life[bin]++;
+
+      ATOMIC_DECREMENT(&grain->env_table->grain_cnt);
+      if (grain->src_handle) { ATOMIC_DECREMENT(&grain->src_handle->grain_cnt); }
+      if (grain->block) { ATOMIC_DECREMENT(&grain->block->grain_cnt); }
       x->grains_cnt--;
       list_remove_node(x->grains_list, node);
     }
@@ -674,6 +1687,60 @@ void granular_perform64(t_granular* x, t_object* dsp64, t_double** ins, t_int16
 
   //====== END: GRAIN LOOP
 
+  TL_END(tl_grains, TL_AUDIO, TL_GRAINS, -1);
+
+  //====== Overlap energy of the grains that carry on into the next sub-block
+  x->overlap_e = overlap_e;
+
+  //====== Decimate the oversampled buses into the output
+  granular_os_mix(x, out_block, sampleframes);
+}
+
+
+// ========  METHOD: GRANULAR_PERFORM64  ========
+// The vector is processed in sub-blocks of at most SUBBLOCK_LEN samples. Queued parameter changes are applied
+// and grains are scheduled before each sub-block, so that the latency of control changes and the working set
+// do not depend on the signal vector size.
+
+void granular_perform64(t_granular* x, t_object* dsp64, t_double** ins, t_int16 numins, t_double** outs, t_int16 numouts,
+  t_int32 sampleframes, t_int32 flags, void* userparam) {
+
+  //TRACE("granular_perform64");
+
+  t_seeder* seeder;
+  t_double* out;
+  t_int32   n;
+  t_bool    load_on = ATOMIC_LOAD(x->load_on);
+  t_uint64  ticks = (load_on ? CYCLE_COUNT() : 0);
+
+  //====== The message thread applies changes directly while the DSP is off: if the DSP has just started, wait for
+  //====== the change to be applied, which takes a few microseconds. Only an offline render or soak run holds the
+  //====== engine longer, and the soak run stops once it sees the DSP on: output silence meanwhile.
+  for (t_int32 spin = 0; !granular_engine_acquire(x); spin++) {
+    if (spin == ENGINE_SPIN_MAX) {
+      for (t_int16 i = 0; i < numouts; i++) { memset(outs[i], 0, sizeof(t_double) * sampleframes); }
+      return;
+    }
+  }
+
+  TL_BEGIN(tl_perform);
+
+  //====== Process the sub-blocks
+  for (t_int32 offset = 0; offset < sampleframes; offset += SUBBLOCK_LEN) {
+
+    n = ((sampleframes - offset < SUBBLOCK_LEN) ? (sampleframes - offset) : SUBBLOCK_LEN);
+
+    TL_BEGIN(tl_drain);
+    granular_param_drain(x);
+    TL_END(tl_drain, TL_AUDIO, TL_DRAIN, -1);
+
+    granular_perform_block(x, outs[0] + offset, n);
+
+    TL_BEGIN(tl_ring);
+    granular_ring_write(x, ins[0] + offset, outs[0] + offset, n);
+    TL_END(tl_ring, TL_AUDIO, TL_RING, -1);
+  }
+
   //====== Eliminate values that are out of bounds
   n = sampleframes;
   out = outs[0];
@@ -683,73 +1750,206 @@ void granular_perform64(t_granular* x, t_object* dsp64, t_double** ins, t_int16
     out++;
   }
 
-  //====== Send out a message with the grain boundaries of the seeder in focus
-  seeder = x->seeders_arr + x->seeders_foc;
-  atom_setfloat(x->mess_arr, seeder->src_begin / seeder->buff_msr);
-  atom_setfloat(x->mess_arr + 1, (seeder->src_begin + seeder->src_len) / seeder->buff_msr);
-  outlet_list(x->outl_bounds, NULL, 2, x->mess_arr);
-}
+  //====== Publish a snapshot of the grain cloud at the visualization frame rate
+  if (x->viz_fps > 0) {
+    x->viz_cntd -= sampleframes;
+    if (x->viz_cntd <= 0) {
+      x->viz_cntd += (t_int32)(1000 * x->msamplerate / x->viz_fps);
+      granular_viz_snapshot(x);
+    }
+  }
 
-// ========  METHOD: GRANULAR_ASSIST  ========
+  //====== And one for a grain listing requested by get_grains, sent at low priority
+  if ((ATOMIC_LOAD(x->viz_grains) == VIZ_REQ) && ATOMIC_COMPARE_SWAP32(VIZ_REQ, VIZ_REPLY, &x->viz_grains)) {
+    granular_viz_snapshot(x);
+    qelem_set(x->viz_qelem);
+  }
 
-void granular_assist(t_granular* x, void* b, t_int16 type, t_int16 arg, char* str) {
+  //====== Grain boundaries of the seeder in focus, while its source handle cannot be freed yet
+  seeder = x->seeders_arr + x->seeders_foc;
+  t_src_handle* handle = PTR_ACQUIRE(seeder->src_handle);
+  t_double      src_msr = (handle ? handle->msr : x->msamplerate);
+  atom_setfloat(x->bounds_arr, seeder->src_begin / src_msr);
+  atom_setfloat(x->bounds_arr + 1, (seeder->src_begin + seeder->src_len) / src_msr);
 
-  TRACE("granular_assist");
+  //====== Envelope tables retired before this point are no longer read by new grains
+  ATOMIC_INCREMENT_BARRIER(&x->epoch);
 
-  if (type == ASSIST_INLET) {
-    switch (arg) {
-    case 0: sprintf(str, "Inlet 0: All purpose (signal, list)"); break;
-    default: break;
-  }
-}
+  //====== Grain histograms
+  granular_hist_update(x);
 
-  else if (type == ASSIST_OUTLET) {
-    switch (arg) {
-    case 0: sprintf(str, "Outlet 0: Signal outlet (signal)"); break;
-    case 1: sprintf(str, "Outlet 1: List outlet to output grain boundaries in ms (list)"); break;
-    case 2: sprintf(str, "Outlet 2: General message outlet (various)"); break;
-    case 3: sprintf(str, "Outlet 3: Bang outlet to indicate task completion (bang)"); break;
-    default: break;
+  //====== Ticks spent in the whole vector cycle, to report the share of each seeder
+  if (load_on) {
+    x->load_ticks += CYCLE_COUNT() - ticks;
+    granular_load_publish(x);
   }
-}
-}
 
-// ========  GENERAL INTERFACE PROCEDURES  ========
+  TL_END(tl_perform, TL_AUDIO, TL_PERFORM, -1);
 
-// ====  METHOD: GRANULAR_MASTER  ====
+  granular_engine_release(x);
 
-void granular_master(t_granular* x, t_double master) {
+  //====== Send out a message with the grain boundaries of the seeder in focus
+  outlet_list(x->outl_bounds, NULL, 2, x->bounds_arr);
+}
 
-  //TRACE("granular_master");
+// ========  METHOD: GRANULAR_DSPSTATE  ========
+// Called when the DSP is turned on or off
 
-  x->master = master;
+void granular_dspstate(t_granular* x, t_atom_long state) {
+
+  TRACE("granular_dspstate");
+
+  if (state == 0) { x->dsp_stopped = true; }
 }
 
-// ====  METHOD: GRANULAR_ALL_ON  ====
+// ========  METHOD: GRANULAR_RESTART  ========
+// Sets what happens to live grains when the DSP restarts. Called by restart message.
+// Arguments: Symbol
+//   "rescale":  Live grains and seeder countdowns are rescaled to the new samplerate and continue (default)
+//   "fade":     Live grains fade out over RESTART_FADE_MS
 
-void granular_all_on(t_granular* x) {
+void granular_restart(t_granular* x, t_symbol* sym) {
 
-  TRACE("granular_all_on");
+  TRACE("granular_restart");
+
+  if (sym == gensym("rescale"))   { x->restart_mode = RESTART_RESCALE; }
+  else if (sym == gensym("fade")) { x->restart_mode = RESTART_FADE; }
+  else { MY_ERR("restart:  Invalid argument. The method expects one symbol: \"rescale\" or \"fade\"."); }
+}
+
+// ========  PROCEDURE: GRANULAR_RESCALE  ========
+// Called by granular_dsp64 before the samplerate is updated, with the ratio of the new samplerate to the old one,
+// and whether the DSP restarts: it was stopped, or the samplerate changed.
+// Each live grain keeps its relative position: its output length is rescaled, and its interpolation indexes and
+// remainders are recalculated from the number of samples already written. Seeder countdowns are rescaled.
+// In fade mode the grains also fade out on a restart, from their rescaled position.
+
+void granular_rescale(t_granular* x, t_double ratio, t_bool restart) {
+
+  TRACE("granular_rescale");
 
-  t_int16* node = x->seeders_list->first_used + 1;
+  t_int16* node = x->grains_list->first_used;
+  t_grain* grain;
+  t_int32  out_len, out_pos, env_len = x->env_n_frm - 1;
+  t_int64  acc;
 
-  // Go through the inactive seeders link list
+  //==== Live grains
   while (*node != LIST_END) {
 
-    t_seeder* seeder = x->seeders_arr + *node;
+    grain = x->grains_arr + *node;
+
+    if (ratio != 1) {
+
+      out_len = (t_int32)(grain->out_len * ratio + 0.5);
+      if (out_len < 2) { out_len = 2; }
+
+      out_pos = (t_int32)((grain->out_len - grain->out_cntd) * ratio + 0.5);
+      if (out_pos > out_len - 1) { out_pos = out_len - 1; }
 
-    if (seeder->buff_state == BUFF_READY) {
+      acc = (t_int64)out_pos * (grain->src_len - 1);
+      grain->src_I = (t_int32)(acc / (out_len - 1));
+      grain->src_R = (t_int32)(acc % (out_len - 1));
 
-      // Update the seeder counter, set the seeder on, and add the node to the active link list
-      // Note: No need to iterate the node as that is taken care of by list_insert_first
-      x->seeders_cnt++;
-      seeder->is_on = true;
-      list_insert_first(x->seeders_list);
+      // Glisson grains keep their phase and their rate rescaled, and the rate change is recalculated so that
+      // the phase still reaches the end of the source window on the last sample, despite the rounded length
+      if (grain->glide) {
+        t_int32 steps = out_len - out_pos - 1;
+        grain->src_I          = (t_int32)grain->phase;
+        grain->phase_inc     /= ratio;
+        grain->phase_inc_inc  = 0;
+        if (steps == 1) { grain->phase_inc = grain->src_len - 1 - grain->phase; }
+        if (steps > 1) {
+          grain->phase_inc_inc = 2 * (grain->src_len - 1 - grain->phase - grain->phase_inc * steps) / ((t_double)steps * (steps - 1));
+        }
+      }
+
+      acc = (t_int64)out_pos * env_len;
+      grain->env_I = (t_int32)(acc / (out_len - 1));
+      grain->env_R = (t_int32)(acc % (out_len - 1));
+
+      grain->out_begin = (t_int32)(grain->out_begin * ratio);
+      grain->out_len   = out_len;
+      grain->out_cntd  = out_len - out_pos;
+
+      // A fading grain keeps at least one sample of fade
+      if (grain->fading) {
+        grain->fade_len  = (t_int32)(grain->fade_len * ratio);
+        grain->fade_cntd = (t_int32)(grain->fade_cntd * ratio);
+        if (grain->fade_len < 1)  { grain->fade_len = 1; }
+        if (grain->fade_cntd < 1) { grain->fade_cntd = 1; }
+        if (grain->fade_cntd > grain->fade_len) { grain->fade_cntd = grain->fade_len; }
+      }
     }
 
-    else {
-      // But in case the seeder is not set on the node needs to be incremented
-      node = x->seeders_list->array + *node;
+    if (restart && (x->restart_mode == RESTART_FADE) && !grain->fading) {
+      grain->fading    = true;
+      grain->fade_len  = (t_int32)(RESTART_FADE_MS * x->msamplerate * ratio) << grain->os_ind;
+      if (grain->fade_len < 1) { grain->fade_len = 1; }
+      grain->fade_cntd = grain->fade_len;
+    }
+
+    node = x->grains_list->array + *node;
+  }
+
+  //==== Seeder countdowns
+  if (ratio != 1) {
+    for (t_int16 index = 0; index < x->seeders_max; index++) {
+      for (t_int16 i = 0; i < POLY_MAX; i++) {
+        x->seeders_arr[index].period_cntd[i] = (t_int32)(x->seeders_arr[index].period_cntd[i] * ratio);
+      }
+    }
+  }
+}
+
+// ========  METHOD: GRANULAR_ASSIST  ========
+
+void granular_assist(t_granular* x, void* b, t_int16 type, t_int16 arg, char* str) {
+
+  TRACE("granular_assist");
+
+  if (type == ASSIST_INLET) {
+    switch (arg) {
+    case 0: sprintf(str, "Inlet 0: All purpose (signal, list)"); break;
+    default: break;
+  }
+}
+
+  else if (type == ASSIST_OUTLET) {
+    switch (arg) {
+    case 0: sprintf(str, "Outlet 0: Signal outlet (signal)"); break;
+    case 1: sprintf(str, "Outlet 1: List outlet to output grain boundaries in ms (list)"); break;
+    case 2: sprintf(str, "Outlet 2: General message outlet (various)"); break;
+    case 3: sprintf(str, "Outlet 3: Bang outlet to indicate task completion (bang)"); break;
+    default: break;
+  }
+}
+}
+
+// ========  GENERAL INTERFACE PROCEDURES  ========
+
+// ====  METHOD: GRANULAR_MASTER  ====
+
+void granular_master(t_granular* x, t_double master) {
+
+  //TRACE("granular_master");
+
+  x->master = master;
+}
+
+// ====  METHOD: GRANULAR_ALL_ON  ====
+
+void granular_all_on(t_granular* x) {
+
+  TRACE("granular_all_on");
+
+  // The active list is only changed by the audio thread, through the parameter queue
+  for (t_int16 index = 0; index < x->seeders_max; index++) {
+
+    t_seeder* seeder = x->seeders_arr + index;
+
+    if (!seeder->on_msg && ((seeder->buff_state == BUFF_READY) || (seeder->src_mode_msg != SRC_MODE_BUFFER))) {
+      seeder->on_msg = true;
+      granular_param_push(x, index, PARAM_ON, 1);
     }
   }
 
@@ -762,18 +1962,12 @@ void granular_all_off(t_granular* x) {
 
   TRACE("granular_all_off");
 
-  t_int16* node = x->seeders_list->first_used;
-
-  // Go through the active seeders link list
-  while (*node != LIST_END) {
-
-    t_seeder* seeder = x->seeders_arr + *node;
-
-    // Update the seeder counter, set the seeder on, and add the node to the active link list
-    // Note: No need to iterate the node as that is taken care of by list_remove_node
-    x->seeders_cnt--;
-    seeder->is_on = false;
-    list_remove_node(x->seeders_list, node);
+  // The active list is only changed by the audio thread, through the parameter queue
+  for (t_int16 index = 0; index < x->seeders_max; index++) {
+    if (x->seeders_arr[index].on_msg) {
+      x->seeders_arr[index].on_msg = false;
+      granular_param_push(x, index, PARAM_OFF, 0);
+    }
   }
 
   outlet_bang(x->outl_compl);
@@ -813,10 +2007,11 @@ void granular_post_seeders(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* a
       case BUFF_NO_REF:   strcpy(buff_state, "NO REFERENCE"); break;
       case BUFF_NO_OBJ:   strcpy(buff_state, "NO OBJECT"); break;
       case BUFF_NO_FILE:  strcpy(buff_state, "NO FILE"); break;
+      case BUFF_LOADING:  strcpy(buff_state, "LOADING"); break;
       default:            strcpy(buff_state, ""); break;
     }
 
-      if (seeder->is_on) {
+      if (seeder->on_msg) {
 
         POST("  Seeder %i - ON - Ampl: %.2f, Beg Src: %.0fms, Len Src: %.0fms, Len Out: %.0fms, Shift: %.2f",
           index, seeder->ampl, seeder->src_begin / seeder->buff_msr, seeder->src_len_ms,
@@ -846,10 +2041,11 @@ void granular_post_seeders(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* a
       case BUFF_NO_REF:   strcpy(buff_state, "NO REFERENCE"); break;
       case BUFF_NO_OBJ:   strcpy(buff_state, "NO OBJECT"); break;
       case BUFF_NO_FILE:  strcpy(buff_state, "NO FILE"); break;
+      case BUFF_LOADING:  strcpy(buff_state, "LOADING"); break;
       default:            strcpy(buff_state, ""); break;
     }
 
-      if (!seeder->is_on) {
+      if (!seeder->on_msg) {
 
         POST("  Seeder %i - OFF - Ampl: %.2f, Beg Src: %.0fms, Len Src: %.0fms, Len Out: %.0fms, Shift: %.2f",
           index, seeder->ampl, seeder->src_begin / seeder->buff_msr, seeder->src_len_ms,
@@ -921,6 +2117,9 @@ void granular_post_buffers(t_granular* x) {
     else if (seeder->buff_state == BUFF_NO_FILE) {
       POST("  Seeder %i:  Buffer %s has no audio file loaded in. Use \"file\" message to load a file.", index, seeder->buff_sym->s_name);
     }
+    else if (seeder->buff_state == BUFF_LOADING) {
+      POST("  Seeder %i:  Buffer %s is loading %s.", index, seeder->buff_sym->s_name, seeder->buff_file->s_name);
+    }
 
     else {
       POST("  Seeder %i:  Buffer %s, Length: %ims, Frames: %i, Channels: %i, Samplerate: %.0f, File: %s",
@@ -930,6 +2129,38 @@ void granular_post_buffers(t_granular* x) {
     }
 }
 
+// ====  METHOD: GRANULAR_AUTOGAIN  ====
+// Sets the automatic gain. Called by autogain message.
+// The energy of the live grains is estimated from their amplitudes and the mean square of their envelopes,
+// assuming uncorrelated sources of unit power. Each new grain is scaled by target / sqrt(energy), so that
+// the summed level stays at the target as the density changes. Computed per spawn and per sub-block only.
+// Arguments: Float [Float]
+//   Arg 0:  Float - Target RMS level, 0 to turn the automatic gain off
+//   Arg 1:  Float - Optional: maximum gain applied to a grain (default 4)
+
+void granular_autogain(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  TRACE("granular_autogain");
+
+  if ((argc < 1) || (argc > 2)) {
+    MY_ERR("autogain:  Invalid arguments. The method expects:");
+    MY_ERR2("  Arg 0:  Float - Target RMS level, 0 to turn the automatic gain off");
+    MY_ERR2("  Arg 1:  Float - Optional: maximum gain applied to a grain");
+    return;
+  }
+
+  t_double target   = (t_double)atom_getfloat(argv);
+  t_double gain_max = ((argc == 2) ? (t_double)atom_getfloat(argv + 1) : AUTOGAIN_MAX);
+
+  if ((target < 0) || (gain_max <= 0)) {
+    MY_ERR("autogain:  The target level has to be 0 or more and the maximum gain more than 0.");
+    return;
+  }
+
+  x->autogain_max    = gain_max;
+  x->autogain_target = target;
+}
+
 // ====  METHOD: GRANULAR_GET_ACTIVE  ====
 
 void granular_get_active(t_granular* x) {
@@ -939,567 +2170,3029 @@ void granular_get_active(t_granular* x) {
   t_atom*   atom = x->mess_arr;
 
   for (t_int16 index = 0; index < x->seeders_max; index++) {
-    atom_setlong(atom++, (x->seeders_arr + index)->is_on);
+    atom_setlong(atom++, (x->seeders_arr + index)->on_msg);
   }
 
   outlet_anything(x->outl_mess, sym_active, x->seeders_max, x->mess_arr);
 }
 
-// ========  INTERNAL PROCEDURES  ========
-// The method receives an atom with an integer and checks that this integer is a valid index in the seeder array
-// and that the corresponding seeder already exists
-// Arguments:
-//   t_atom*     atom:      Should contain one integer from 0 to (x->seeders_max - 1)
-//   const char* method:    The name of the method calling granular_seeder_index
-//   t_int16     argc:      The number of arguments expected
-//   t_int16     argc_exp:  The number of arguments expected
+// ====  METHOD: GRANULAR_LOAD  ====
+// Turns the per-seeder load accounting on or off. Called by load message.
+// When on, the render kernels of each grain are timed, at the cost of two reads of the tick counter per grain
+// and sub-block. The counters are kept when it is turned off.
 
-t_int16 granular_check_args(t_granular* x, const char* method, t_int16 argc, t_atom* argv, t_int16 argc_exp) {
+void granular_load(t_granular* x, t_atom_long on) {
 
-  // Check the number of arguments
-  if (argc != argc_exp) {
-    if (argc_exp == 1) {
-      MY_ERR("%s:  Invalid arguments. The method expects one integer as the seeder index.", method); return ERR_ARG;
-    }
-    else if (argc_exp == 2) {
-      MY_ERR("%s:  Invalid arguments. The method expects two arguments.", method); return ERR_ARG;
-    }
-    else {
-      MY_ERR("%s:  Invalid arguments. The method expects %i parameters.", method, argc_exp); return ERR_ARG;
-    }
-  }
+  TRACE("granular_load");
 
-  // The first atom has to contain an integer
-  if (atom_gettype(argv) != A_LONG) {
-    MY_ERR("%s:  Arg 0 (index of the seeder):  Has to be an integer.", method); return ERR_ARG;
-  }
+  ATOMIC_STORE(x->load_on, (t_bool)(on != 0));
+}
 
-  t_int16 index = (t_int16)atom_getlong(argv);
+// ====  PROCEDURE: GRANULAR_LOAD_PUBLISH  ====
+// Called by whoever owns the engine, at the end of each vector cycle or run with the load accounting on: copy the
+// counters in the snapshot owned by the engine, then exchange it atomically with the snapshot in the middle, as the
+// visualization does. The message thread never reads a 64-bit counter while it is written, on 32-bit targets too.
 
-  // Check the boundaries
-  if (index < 0) {
-    MY_ERR("%s:  Arg 0 (index of the seeder):  Has to be 0 or more. Was %i instead.", method, index); return ERR_ARG;
-  }
+void granular_load_publish(t_granular* x) {
 
-  if (index >= x->seeders_max) {
-    MY_ERR("%s:  Arg 0 (index of the seeder):  Has to be %i at most. Was %i instead.", method, x->seeders_max - 1, index); return ERR_ARG;
-  }
+  t_load* snap = x->load_snaps[x->load_w];
+  t_int32 mid;
 
-  return index;
+  for (t_int16 i = 0; i < x->seeders_max; i++) { snap[i] = x->seeders_arr[i].load; }
+  snap[x->seeders_max].ticks = x->load_ticks;
+
+  do { mid = ATOMIC_LOAD(x->load_mid); } while (!ATOMIC_COMPARE_SWAP32(mid, x->load_w | VIZ_NEW, &x->load_mid));
+  x->load_w = mid & VIZ_INDEX;
 }
 
-// ========  SEEDERS  ========
+// ====  METHOD: GRANULAR_GET_SEEDER_LOAD  ====
+// Outputs the render cost of all the seeders since the previous report, in one message. Called by get_seeder_load message.
+// Output: seeder_load Int followed by 5 atoms per seeder:
+//    Int - Total ticks spent in the perform routine
+//    Per seeder:  Int - Seeder index, Int - Ticks, Int - Grains added, Int - Samples rendered,
+//                 Float - Share of the total ticks in percent
 
-// ====  METHOD: GRANULAR_SET_SEEDER  ====
-// Sets all seeder parameters. Called by set_seeder message.
-// Arguments: Int Float Float Float Float Float Float
-//   Arg 0:  Int   - Seeder index
-//   Arg 1:  Float - Amplitude
-//   Arg 2:  Float - Beginning
-//   Arg 3:  Float - Length
-//   Arg 4:  Float - Shift
-//   Arg 5:  Float - Period
-//   Arg 6:  Float - Speed
-//   Arg 7:  Float - Random
-//   Arg 8:  Int   - Number of simultaneous grain streams
+void granular_get_seeder_load(t_granular* x) {
 
-void granular_set_seeder(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+  TRACE("granular_get_seeder_load");
 
-  TRACE("granular_set_seeder");
+  if (!x->load_on) { MY_ERR("get_seeder_load:  The load accounting is off. Use \"load 1\" to turn it on."); }
 
-  // Check the number of arguments
-  if (argc != 9) {
-    MY_ERR("add_seeder:  Wrong number of arguments. The method expects:");
-    MY_ERR2("  Arg 0:  Int - Seeder index");
-    MY_ERR2("  Arg 1:  Float - Amplitude");
-    MY_ERR2("  Arg 2:  Float - Beginning");
-    MY_ERR2("  Arg 3:  Float - Length");
-    MY_ERR2("  Arg 4:  Float - Shift");
-    MY_ERR2("  Arg 5:  Float - Period");
-    MY_ERR2("  Arg 6:  Float - Speed");
-    MY_ERR2("  Arg 7:  Float - Random");
-    MY_ERR2("  Arg 8:  Int - Number of simultaneous grain streams");
-    return;
-  }
+  // Take the latest counters published by the engine, or keep the ones of the previous report if none since
+  t_int32 mid = ATOMIC_LOAD(x->load_mid);
+  if ((mid & VIZ_NEW) && ATOMIC_COMPARE_SWAP32(mid, x->load_r, &x->load_mid)) { x->load_r = mid & VIZ_INDEX; }
 
-  // Check the validity of the arguments
-  t_int16 index = granular_check_args(x, "set_seeder", argc, argv, 9);
-  if (index == ERR_ARG) { return; }
+  t_load*   snap  = x->load_snaps[x->load_r];
+  t_uint64  total = snap[x->seeders_max].ticks - x->load_prev_ticks;
+  t_atom*   atom  = x->mess_arr;
+  t_seeder* seeder;
+  t_load    load;
 
-  // Set the seeder pointer
-  t_seeder* seeder    = x->seeders_arr + index;
+  x->load_prev_ticks += total;
+  atom_setlong(atom++, (t_atom_long)total);
 
-  seeder->ampl        = (t_double)atom_getfloat(argv + 1);
+  for (t_int16 index = 0; index < x->seeders_max; index++) {
 
-  seeder->src_begin   = (t_int32)(atom_getfloat(argv + 2) * seeder->buff_n_frm);
-  seeder->src_len_ms  = (t_double)atom_getfloat(argv + 3);
-  seeder->src_len     = (t_int32)(seeder->src_len_ms * seeder->buff_msr);
+    seeder = x->seeders_arr + index;
+    load   = snap[index];
 
-  if (seeder->src_begin < 0) { seeder->src_begin = 0; }
-  if (seeder->src_begin + seeder->src_len > seeder->buff_n_frm) { seeder->src_begin = seeder->buff_n_frm - seeder->src_len; }
+    atom_setlong (atom++, index);
+    atom_setlong (atom++, (t_atom_long)(load.ticks  - seeder->load_prev.ticks));
+    atom_setlong (atom++, (t_atom_long)(load.grains - seeder->load_prev.grains));
+    atom_setlong (atom++, (t_atom_long)(load.smp    - seeder->load_prev.smp));
+    atom_setfloat(atom++, (total ? 100. * (load.ticks - seeder->load_prev.ticks) / total : 0));
 
-  seeder->shift       = (t_double)atom_getfloat(argv + 4);
-  seeder->shift_r     = (t_double)exp(- LN2 * seeder->shift);
-  seeder->out_len     = (t_int32)(seeder->src_len_ms * seeder->shift_r * x->msamplerate);
+    seeder->load_prev = load;
+  }
 
-  seeder->period      = (t_double)atom_getfloat(argv + 5);
-  seeder->period_len  = (t_int32)(seeder->period * seeder->out_len);
+  outlet_anything(x->outl_mess, sym_seeder_load, (short)(atom - x->mess_arr), x->mess_arr);
+}
 
-  seeder->speed       = (t_double)atom_getfloat(argv + 6);
-  seeder->period_rand = (t_double)atom_getfloat(argv + 7);
+// ====  PROCEDURE: GRANULAR_HIST_UPDATE  ====
+// Called from the perform routine once per vector cycle: clear the histograms if asked, then add the number
+// of live grains and the number of grains added in the cycle.
 
-  seeder->poly_cnt    = (t_int16)atom_getlong(argv + 8);
+void granular_hist_update(t_granular* x) {
 
-  if ((seeder->poly_cnt < 1) || (seeder->poly_cnt > x->poly_max)) {
-    MY_ERR("add_seeder:  Arg 8 (number of grain streams):  Has to be between 1 and %i. Was %i instead. Set to 1.",
-      x->poly_max, seeder->poly_cnt);
-    seeder->poly_cnt = 1;
-  }
+  t_hist* hist = &x->hist;
 
-  for (int i = 0; i < seeder->poly_cnt; i++) {
-    seeder->period_cntd[i] = (t_int32)(i * seeder->period_len / seeder->poly_cnt);
+  if (ATOMIC_LOAD(x->hist_clear)) {
+    t_int32 width = hist->conc_width;
+    memset(hist, 0, sizeof(t_hist));
+    hist->conc_width = width;
+    ATOMIC_STORE(x->hist_clear, 0);
   }
 
-  return;
-}
+  t_int32 bin = x->grains_cnt / hist->conc_width;
+  hist->conc[(bin < HIST_N_BIN) ? bin : HIST_N_BIN - 1]++;
 
-// ====  METHOD: GRANULAR_GET_SEEDER  ====
-// Gets all seeder parameters. Called by get_seeder message.
-// Arguments: Int Float Float Float Float Float Float
-//    Arg 0:  Int - Seeder index
-//    Arg 1:  Sym - ON or OFF
-//    Arg 2:  Float - Amplitude
-//    Arg 3:  Float - Beginning
-//    Arg 4:  Float - Length
-//    Arg 5:  Float - Shift
-//    Arg 6:  Float - Period
-//    Arg 7:  Float - Speed
-//    Arg 8:  Float - Random
-//    Arg 9:  Int - Number of simultaneous grain streams
-//    Arg 10:  Symbol - Envelope type
-//    Arg 11:  Symbol - Buffer name
-//    Arg 12:  Symbol - File name
+  if (x->grains_cnt > hist->conc_hwm) { hist->conc_hwm = x->grains_cnt; }
 
-void granular_get_seeder(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+  hist->spawn[(hist->spawn_cnt < HIST_N_BIN) ? hist->spawn_cnt : HIST_N_BIN - 1]++;
+  hist->spawn_cnt = 0;
+}
 
-  TRACE("granular_get_seeder");
+// ====  METHOD: GRANULAR_GET_HIST  ====
+// Outputs the grain histograms, each as one message. Called by get_hist message.
+// Output:
+//    hist_concurrency Int Int...:  Bin width in grains, then the number of vector cycles per bin of live grains
+//    hist_lifetime Float Int...:   Samplerate in samples per ms, then the number of grains per bin of lifetime,
+//                                  bin k for lifetimes of 2^(k-1) to 2^k - 1 samples
+//    hist_spawns Int...:           Number of vector cycles per number of grains added, the last bin for more
+//    grains_hwm Int Int Int:       Highest number of live grains, grains_max, number of grains dropped
+
+void granular_get_hist(t_granular* x) {
+
+  TRACE("granular_get_hist");
+
+  // The histograms are read without locking: a report may miss the counts of the vector cycle in progress
+  t_hist  hist = x->hist;
+  t_atom* atom;
+
+  atom = x->mess_arr;
+  atom_setlong(atom++, hist.conc_width);
+  for (t_int16 i = 0; i < HIST_N_BIN; i++) { atom_setlong(atom++, hist.conc[i]); }
+  outlet_anything(x->outl_mess, sym_hist_conc, HIST_N_BIN + 1, x->mess_arr);
+
+  atom = x->mess_arr;
+  atom_setfloat(atom++, x->msamplerate);
+  for (t_int16 i = 0; i < HIST_N_BIN; i++) { atom_setlong(atom++, hist.life[i]); }
+  outlet_anything(x->outl_mess, sym_hist_life, HIST_N_BIN + 1, x->mess_arr);
+
+  atom = x->mess_arr;
+  for (t_int16 i = 0; i < HIST_N_BIN; i++) { atom_setlong(atom++, hist.spawn[i]); }
+  outlet_anything(x->outl_mess, sym_hist_spawn, HIST_N_BIN, x->mess_arr);
+
+  atom = x->mess_arr;
+  atom_setlong(atom++, hist.conc_hwm);
+  atom_setlong(atom++, x->grains_max);
+  atom_setlong(atom++, hist.dropped);
+  outlet_anything(x->outl_mess, sym_grains_hwm, 3, x->mess_arr);
+}
 
-  // Check the validity of the arguments
-  t_int16 index = granular_check_args(x, "get_seeder", argc, argv, 1);
-  if (index == ERR_ARG) { return; }
+// ====  METHOD: GRANULAR_CLEAR_HIST  ====
+// Clears the grain histograms at the next vector cycle. Called by clear_hist message.
 
-  t_seeder* seeder = x->seeders_arr + index;
-  t_atom*   atom   = x->mess_arr;
+void granular_clear_hist(t_granular* x) {
 
-  atom_setlong (atom++, index);
-  atom_setsym  (atom++, (seeder->is_on ? sym_on : sym_off));
-  atom_setfloat(atom++, seeder->ampl);
-  atom_setfloat(atom++, seeder->src_begin);
-  atom_setfloat(atom++, seeder->src_len_ms);
-  atom_setfloat(atom++, seeder->shift);
-  atom_setfloat(atom++, seeder->period);
-  atom_setfloat(atom++, seeder->speed);
-  atom_setfloat(atom++, seeder->period_rand);
-  atom_setfloat(atom++, seeder->poly_cnt);
-  atom_setsym  (atom++, seeder->env_sym);
-  atom_setsym  (atom++, seeder->buff_sym);
-  atom_setsym  (atom++, seeder->buff_file);
+  TRACE("granular_clear_hist");
 
-  outlet_anything(x->outl_mess, sym_seeder, 13, x->mess_arr);
+  // Without the DSP running the audio thread would never clear them
+  if (sys_getdspobjdspstate((t_object*)x) == 0) {
+    t_int32 width = x->hist.conc_width;
+    memset(&x->hist, 0, sizeof(t_hist));
+    x->hist.conc_width = width;
+  }
+  else { ATOMIC_STORE(x->hist_clear, 1); }
 }
 
-// ====  METHOD: GRANULAR_SEEDER_ON  ====
+// ====  METHOD: GRANULAR_TIMELINE  ====
+// Turns the timeline of engine activity on or off. Called by timeline message.
+// Turning it on empties the rings, so that a dump covers what happened since.
 
-void granular_seeder_on(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+void granular_timeline(t_granular* x, t_atom_long on) {
 
-  TRACE("granular_seeder_on");
+  TRACE("granular_timeline");
 
-  // Check the validity of the arguments
-  t_int16 index = granular_check_args(x, "seeder_on", argc, argv, 1);
-  if (index == ERR_ARG) {
-    outlet_bang(x->outl_compl);
-    return;
-  }
+  x->tl_on = false;
+  if (!on) { return; }
 
-  t_seeder* seeder = x->seeders_arr + index;
+  if (x->tl == NULL) { x->tl = tl_new(); }
 
-  // Check if the seeder is already on
-  if (seeder->is_on == true) {
-    //POST("seeder_on:  Arg 0 (index of the seeder):  Seeder %i is already on.", index);
-    outlet_bang(x->outl_compl);
+  if (x->tl == NULL) {
+    MY_ERR("timeline:  Unable to allocate the timeline.");
     return;
   }
 
-  // Check that a file has been loaded in the buffer
-  if (seeder->buff_state == BUFF_NO_FILE) {
-    POST("seeder_on:  Source buffer for seeder %i has no file loaded in.", index);
-    outlet_bang(x->outl_compl);
-    return;
-  }
+  tl_start(x->tl, systimer_gettime());
 
-  // Check that the seeder has a buffer linked to it
-  if (seeder->buff_state != BUFF_READY) {
-    POST("seeder_on:  Source buffer for seeder %i is not ready to be used.", index);
-    outlet_bang(x->outl_compl);
-    return;
-  }
+  MEMORY_BARRIER();
+  x->tl_on = true;
+}
 
-  // Update the linked list to add a node and check for an error from list_insert_index
-  // This should have been caught by the previous test already
-  if (list_insert_index(x->seeders_list, index) == LIST_END) {
-    MY_ERR("seeder_off:  Error calling list_insert_index. Could not find the index %i.", index);
-    outlet_bang(x->outl_compl);
+// ====  METHOD: GRANULAR_TIMELINE_DUMP  ====
+// Writes the spans recorded since the timeline was turned on as a Chrome trace JSON file, to open in
+// chrome://tracing or Perfetto. The timeline keeps recording. Called by timeline_dump message.
+// Arguments: Symbol - Path of the file
+
+void granular_timeline_dump(t_granular* x, t_symbol* path) {
+
+  TRACE("granular_timeline_dump");
+
+  if (x->tl == NULL) {
+    MY_ERR("timeline_dump:  Nothing recorded. Use \"timeline 1\" to turn the timeline on.");
     return;
   }
 
-  // Update the seeder counter and set the seeder on
-  x->seeders_cnt++;
-  seeder->is_on = true;
+  char path_native[MAX_PATH_CHARS];
+  path_nameconform(path->s_name, path_native, PATH_STYLE_NATIVE, PATH_TYPE_BOOT);
 
-  outlet_bang(x->outl_compl);
-}
+  t_int32 cnt = tl_dump(x->tl, path_native, systimer_gettime());
 
-// ====  METHOD: GRANULAR_SEEDER_OFF  ====
+  if (cnt == -2) { MY_ERR("timeline_dump:  No tick counter on this platform."); }
+  else if (cnt < 0) { MY_ERR("timeline_dump:  Unable to write the file \"%s\".", path_native); }
+  else { POST("timeline_dump:  %i spans written to %s", cnt, path_native); }
+}
 
-void granular_seeder_off(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+// ====  METHOD: GRANULAR_VIZ  ====
+// Sets the frame rate at which the grain cloud is written to the visualization buffer. 0 turns it off.
+// The buffer holds the number of grains, followed by 5 values per grain:
+//   seeder index, normalized position, normalized length, envelope phase, amplitude
 
-  TRACE("granular_seeder_off");
+void granular_viz(t_granular* x, t_double fps) {
 
-  // Check the validity of the arguments
-  t_int16 index = granular_check_args(x, "seeder_off", argc, argv, 1);
-  if (index == ERR_ARG) {
-    outlet_bang(x->outl_compl);
-    return;
-  }
+  TRACE("granular_viz");
 
-  // Check if the seeder is already off
-  if (x->seeders_arr[index].is_on == false) {
-    //POST("seeder_off:  Arg 0 (index of the seeder):  Seeder %i is already off.", index);
-    outlet_bang(x->outl_compl);
+  if ((fps < 0) || (fps > VIZ_FPS_MAX)) {
+    MY_ERR("viz:  The frame rate has to be between 0 and %i. Was %.2f instead.", VIZ_FPS_MAX, fps);
     return;
   }
 
-  // Update the linked list to remove a node and check for an error from list_remove_index
-  // This should have been caught by the previous test already
-  if (list_remove_index(x->seeders_list, index) == LIST_END) {
-    MY_ERR("seeder_off:  Error calling list_remove_index. Could not find the index %i.", index);
-    outlet_bang(x->outl_compl);
+  if ((fps > 0) && (x->buff_viz_ref == NULL)) {
+    MY_ERR("viz:  The visualization buffer is not set. Use \"buffer viz\" to set it.");
     return;
   }
 
-  // Update the seeder counter and set the seeder off
-  x->seeders_cnt--;
-  x->seeders_arr[index].is_on = false;
+  x->viz_fps  = fps;
+  x->viz_cntd = 0;
 
-  outlet_bang(x->outl_compl);
+  if (fps > 0) { clock_fdelay(x->viz_clock, 1000 / fps); }
+  else { clock_unset(x->viz_clock); }
 }
 
-// ====  METHOD: GRANULAR_FOCUS  ====
+// ====  PROCEDURE: GRANULAR_VIZ_SNAPSHOT  ====
+// Called from the perform routine at the frame rate, or by whoever owns the engine for get_grains: write the state
+// of all grains in the snapshot owned by the audio thread, then exchange it atomically with the snapshot in the middle.
+// No allocation, no locks, one pass through the grain list.
 
-void granular_focus(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+void granular_viz_snapshot(t_granular* x) {
 
-  TRACE("granular_focus");
+  t_grain_snap* snap = x->viz_snaps[x->viz_w];
+  t_int16*      node = x->grains_list->first_used;
+  t_grain*      grain;
+  t_seeder*     seeder;
+  t_int32       cnt = 0;
+  t_int32       mid;
+  t_int32       n_frm;
+  t_int32       pos;
 
-  // Check the validity of the arguments
-  t_int16 index = granular_check_args(x, "focus", argc, argv, 1);
-  if (index == ERR_ARG) { return; }
+  while (*node != LIST_END) {
 
-  x->seeders_foc = index;
+    grain  = x->grains_arr + *node;
+    seeder = x->seeders_arr + grain->index;
 
-  outlet_bang(x->outl_compl);
-}
+    pos   = grain->src_begin + grain->src_I;
+    n_frm = (((grain->pool_ind >= 0) && grain->src_handle) ? grain->src_handle->n_frm : seeder->buff_n_frm);
+    if (grain->pool_ind == POOL_OSC) { n_frm = WT_LEN; }
+    if (grain->pool_ind == POOL_RING) { n_frm = grain->block->n_frm; if (n_frm > 0) { pos %= n_frm; } }
+    if (n_frm <= 0) { n_frm = 1; }
 
-// ====  METHOD: GRANULAR_AMPL  ====
+    // Grains reading from the loop copy: back to a position in the buffer
+    if (grain->pool_ind == POOL_LOOP) {
+      pos = grain->block->offset + pos % grain->block->n_frm;
+    }
 
-void granular_ampl(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+    snap->seeder = (float)grain->index;
+    snap->pos    = (float)pos / n_frm;
+    snap->len    = (float)grain->src_len / n_frm;
+    snap->phase  = 1 - (float)grain->out_cntd / grain->out_len;
+    snap->ampl   = (float)grain->ampl;
 
-  //TRACE("granular_ampl");
+    snap++; cnt++;
+    node = x->grains_list->array + *node;
+  }
 
-  t_int16 index = (t_int16)atom_getlong(argv);
+  x->viz_cnt[x->viz_w] = cnt;
 
-  x->seeders_arr[index].ampl = (t_double)atom_getfloat(argv + 1);
+  // Publish: swap the written snapshot with the middle one, flagged as new
+  do { mid = ATOMIC_LOAD(x->viz_mid); } while (!ATOMIC_COMPARE_SWAP32(mid, x->viz_w | VIZ_NEW, &x->viz_mid));
+  x->viz_w = mid & VIZ_INDEX;
 }
 
-// ====  METHOD: GRANULAR_BEGIN  ====
-// Argument comes in as a float between 0 and 1
+// ====  PROCEDURE: GRANULAR_VIZ_TICK  ====
+// Clock callback at the frame rate: defer the buffer writing to the low priority thread
 
+void granular_viz_tick(t_granular* x) {
 
-void granular_begin(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+  if (x->viz_fps <= 0) { return; }
 
-  //TRACE("granular_begin");
+  qelem_set(x->viz_qelem);
+  clock_fdelay(x->viz_clock, 1000 / x->viz_fps);
+}
 
-  t_int16 index = (t_int16)atom_getlong(argv);
+// ====  PROCEDURE: GRANULAR_VIZ_WRITE  ====
+// Low priority: take the latest published snapshot, if there is a new one, and copy it to the first channel of
+// the visualization buffer. When a grain listing was requested, also send it from the same snapshot.
+
+void granular_viz_write(t_granular* x) {
+
+  t_int32 mid = ATOMIC_LOAD(x->viz_mid);
+
+  // Nothing new since the last frame
+  if (!(mid & VIZ_NEW)) { return; }
+
+  // Take the middle snapshot and leave the one that was read in its place
+  if (!ATOMIC_COMPARE_SWAP32(mid, x->viz_r, &x->viz_mid)) { return; }
+  x->viz_r = mid & VIZ_INDEX;
+
+  if ((ATOMIC_LOAD(x->viz_grains) == VIZ_REPLY) && ATOMIC_COMPARE_SWAP32(VIZ_REPLY, 0, &x->viz_grains)) { granular_grains_reply(x); }
+
+  if ((x->viz_fps <= 0) || (x->buff_viz_ref == NULL)) { return; }
+
+  t_buffer_obj* buff_viz_obj = buffer_ref_getobject(x->buff_viz_ref);
+  if (buff_viz_obj == NULL) { return; }
 
-  x->seeders_arr[index].src_begin = (t_int32)(atom_getfloat(argv + 1) * x->seeders_arr[index].buff_n_frm);
+  float* buffer = buffer_locksamples(buff_viz_obj);
+  if (buffer == NULL) { return; }
 
-  if (x->seeders_arr[index].src_begin < 0) {
-    x->seeders_arr[index].src_begin = 0;
+  t_int32 cnt = x->viz_cnt[x->viz_r];
+  t_int32 n_frm = (t_int32)buffer_getframecount(buff_viz_obj);
+  t_int32 n_chn = (t_int32)buffer_getchannelcount(buff_viz_obj);
+  if ((n_frm < 1) || (n_chn < 1)) { buffer_unlocksamples(buff_viz_obj); return; }
+  if (1 + VIZ_N_VAL * cnt > n_frm) { cnt = (n_frm - 1) / VIZ_N_VAL; }
+
+  // Samples are interleaved: a buffer with more than one channel is written with the channel stride
+  *buffer = (float)cnt;
+
+  if (n_chn == 1) { memcpy(buffer + 1, x->viz_snaps[x->viz_r], cnt * sizeof(t_grain_snap)); }
+  else {
+    float* values = (float*)x->viz_snaps[x->viz_r];
+    for (t_int32 i = 0; i < VIZ_N_VAL * cnt; i++) { buffer[(i + 1) * n_chn] = values[i]; }
   }
-  if (x->seeders_arr[index].src_begin + x->seeders_arr[index].src_len > x->seeders_arr[index].buff_n_frm) {
-    x->seeders_arr[index].src_begin = x->seeders_arr[index].buff_n_frm - x->seeders_arr[index].src_len;
+
+  buffer_setdirty(buff_viz_obj);
+  buffer_unlocksamples(buff_viz_obj);
+}
+
+// ====  METHOD: GRANULAR_GET_GRAINS  ====
+// Lists all the live grains, from a snapshot of the grain cloud. Called by get_grains message.
+// The snapshot is taken directly when the audio thread is not rendering, otherwise by the perform routine
+// at the next vector cycle. The listing is sent at low priority, with up to GRAINS_MESS_MAX grains per message:
+//    grains Int Int ...:  Number of grains in the snapshot, index of the first grain of the message,
+//                         then 5 values per grain: seeder index, normalized position, normalized length,
+//                         envelope phase, amplitude
+
+void granular_get_grains(t_granular* x) {
+
+  TRACE("granular_get_grains");
+
+  if (granular_engine_acquire(x)) {
+    ATOMIC_STORE(x->viz_grains, VIZ_REPLY);
+    granular_viz_snapshot(x);
+    granular_engine_release(x);
+    qelem_set(x->viz_qelem);
   }
+  else { ATOMIC_STORE(x->viz_grains, VIZ_REQ); }
 }
 
-// ====  METHOD: GRANULAR_LENGTH  ====
-// Argument is the source length in ms
+// ====  PROCEDURE: GRANULAR_GRAINS_REPLY  ====
+// Low priority: send the snapshot just taken by granular_viz_write as the reply to get_grains
 
-void granular_length(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+void granular_grains_reply(t_granular* x) {
 
-  //TRACE("granular_length");
+  t_grain_snap* snap = x->viz_snaps[x->viz_r];
+  t_int32       cnt = x->viz_cnt[x->viz_r];
+  t_int32       first = 0;
+  t_atom*       atom;
 
-  t_int16 index = (t_int16)atom_getlong(argv);
+  do {
+    atom = x->viz_mess;
+    atom_setlong(atom++, cnt);
+    atom_setlong(atom++, first);
+
+    for (t_int32 i = first; (i < cnt) && (i < first + GRAINS_MESS_MAX); i++) {
+      atom_setlong (atom++, (t_atom_long)snap[i].seeder);
+      atom_setfloat(atom++, snap[i].pos);
+      atom_setfloat(atom++, snap[i].len);
+      atom_setfloat(atom++, snap[i].phase);
+      atom_setfloat(atom++, snap[i].ampl);
+    }
 
-  x->seeders_arr[index].src_len_ms = (t_double)atom_getfloat(argv + 1);
-  x->seeders_arr[index].src_len    = (t_int32)(x->seeders_arr[index].src_len_ms * (x->seeders_arr + index)->buff_msr);
-  x->seeders_arr[index].out_len    = (t_int32)(x->seeders_arr[index].src_len_ms * x->seeders_arr[index].shift_r * x->msamplerate);
-  x->seeders_arr[index].period_len = (t_int32)(x->seeders_arr[index].out_len * x->seeders_arr[index].period);
+    outlet_anything(x->outl_mess, sym_grains, (short)(atom - x->viz_mess), x->viz_mess);
+    first += GRAINS_MESS_MAX;
+
+  } while (first < cnt);
 }
 
-// ====  METHOD: GRANULAR_SHIFT  ====
+// ========  INTERNAL PROCEDURES  ========
+// The method receives an atom with an integer and checks that this integer is a valid index in the seeder array
+// and that the corresponding seeder already exists
+// Arguments:
+//   t_atom*     atom:      Should contain one integer from 0 to (x->seeders_max - 1)
+//   const char* method:    The name of the method calling granular_seeder_index
+//   t_int16     argc:      The number of arguments expected
+//   t_int16     argc_exp:  The number of arguments expected
 
-void granular_shift(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+t_int16 granular_check_args(t_granular* x, const char* method, t_int16 argc, t_atom* argv, t_int16 argc_exp) {
 
-  //TRACE("granular_shift");
+  // Check the number of arguments
+  if (argc != argc_exp) {
+    if (argc_exp == 1) {
+      MY_ERR("%s:  Invalid arguments. The method expects one integer as the seeder index.", method); return ERR_ARG;
+    }
+    else if (argc_exp == 2) {
+      MY_ERR("%s:  Invalid arguments. The method expects two arguments.", method); return ERR_ARG;
+    }
+    else {
+      MY_ERR("%s:  Invalid arguments. The method expects %i parameters.", method, argc_exp); return ERR_ARG;
+    }
+  }
+
+  // The first atom has to contain an integer
+  if (atom_gettype(argv) != A_LONG) {
+    MY_ERR("%s:  Arg 0 (index of the seeder):  Has to be an integer.", method); return ERR_ARG;
+  }
 
   t_int16 index = (t_int16)atom_getlong(argv);
 
-  x->seeders_arr[index].shift      = (t_double)atom_getfloat(argv + 1);
-  x->seeders_arr[index].shift_r    = (t_double)exp(- LN2 * x->seeders_arr[index].shift);
-  x->seeders_arr[index].out_len    = (t_int32)(x->seeders_arr[index].src_len_ms * x->seeders_arr[index].shift_r * x->msamplerate);
-  x->seeders_arr[index].period_len = (t_int32)(x->seeders_arr[index].out_len * x->seeders_arr[index].period);
+  // Check the boundaries
+  if (index < 0) {
+    MY_ERR("%s:  Arg 0 (index of the seeder):  Has to be 0 or more. Was %i instead.", method, index); return ERR_ARG;
+  }
+
+  if (index >= x->seeders_max) {
+    MY_ERR("%s:  Arg 0 (index of the seeder):  Has to be %i at most. Was %i instead.", method, x->seeders_max - 1, index); return ERR_ARG;
+  }
+
+  return index;
 }
 
-// ====  METHOD: GRANULAR_PERIOD  ====
+// ========  QUEUED PARAMETERS  ========
+// Seeder parameters that are read by the scheduler are not written by the message threads directly.
+// The changes are pushed into a lock-free queue, and applied by the audio thread before each sub-block.
 
-void granular_period(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+// ====  PROCEDURE: GRANULAR_PARAM_PUSH  ====
+// Queue a parameter change for a seeder. When the DSP is off nothing drains the queue,
+// so the pending changes and this one are applied directly, but only while owning the engine:
+// the audio thread may start in between, and the queue has a single consumer.
 
-  //TRACE("granular_period");
+void granular_param_push(t_granular* x, t_int16 index, t_param_type param, t_double value) {
 
-  t_int16 index = (t_int16)atom_getlong(argv);
+  if ((index < 0) || (index >= x->seeders_max)) {
+    MY_ERR("Invalid seeder index %i. Has to be between 0 and %i.", index, x->seeders_max - 1);
+    return;
+  }
+
+  // The length is also kept on the message side, to be read back and pushed again when the source changes
+  if (param == PARAM_LENGTH) { x->seeders_arr[index].src_len_ms = value; }
+
+  if (!sys_getdspobjdspstate((t_object*)x) && granular_engine_acquire(x)) {
+    granular_param_drain(x);
+    granular_param_apply(x, index, param, value);
+    granular_engine_release(x);
+    return;
+  }
 
-  x->seeders_arr[index].period     = (t_double)atom_getfloat(argv + 1);
-  x->seeders_arr[index].period_len = (t_int32)(x->seeders_arr[index].out_len * x->seeders_arr[index].period);
+  if (!pq_push(x->param_queue, index, (t_int16)param, value)) {
+    MY_ERR("The parameter queue is full. Change to seeder %i dropped.", index);
+  }
 }
 
-// ====  METHOD: GRANULAR_SPEED  ====
+// ====  PROCEDURE: GRANULAR_ENGINE_ACQUIRE  ====
+// Take the ownership of the seeders and grains, held by the thread that renders or drains the parameter queue.
+// Never blocks: returns false if another thread owns them.
 
-void granular_speed(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+t_bool granular_engine_acquire(t_granular* x) {
 
-  //TRACE("granular_speed");
+  return (ATOMIC_COMPARE_SWAP32(0, 1, &x->engine_owned) != 0);
+}
 
-  t_int16 index = (t_int16)atom_getlong(argv);
+// ====  PROCEDURE: GRANULAR_ENGINE_RELEASE  ====
 
-  x->seeders_arr[index].speed    = (t_double)atom_getfloat(argv + 1);
+void granular_engine_release(t_granular* x) {
+
+  ATOMIC_DECREMENT_BARRIER(&x->engine_owned);
 }
 
-// ====  METHOD: GRANULAR_POLY  ====
+// ====  PROCEDURE: GRANULAR_PARAM_DRAIN  ====
+// Apply all the pending parameter changes, in the order they were queued
 
-void granular_poly(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+void granular_param_drain(t_granular* x) {
 
-  //TRACE("granular_poly");
+  t_param_item item;
 
-  t_int16 index    = (t_int16)atom_getlong(argv);
-  t_int16 poly_cnt = (t_int16)atom_getfloat(argv + 1);
+  while (pq_pop(x->param_queue, &item)) { granular_param_apply(x, item.index, (t_param_type)item.param, item.value); }
+}
+
+// ====  PROCEDURE: GRANULAR_PARAM_APPLY  ====
+// Set a seeder parameter and everything that depends on it
+
+void granular_param_apply(t_granular* x, t_int16 index, t_param_type param, t_double value) {
+
+  t_seeder* seeder = x->seeders_arr + index;
+
+  // The buffer metadata of the seeder is written by the message threads: use the published source instead
+  t_src_handle* handle    = PTR_ACQUIRE(seeder->src_handle);
+  t_int32       src_n_frm = (handle ? handle->n_frm : 0);
+  t_double      src_msr   = (handle ? handle->msr : x->msamplerate);
+
+  switch (param) {
+
+  case PARAM_AMPL:
+    seeder->ampl = value;
+    break;
+
+  case PARAM_BEGIN:
+    seeder->src_begin = (t_int32)(value * src_n_frm);
+    if (seeder->src_begin < 0) { seeder->src_begin = 0; }
+    if (seeder->src_begin + seeder->src_len > src_n_frm) { seeder->src_begin = src_n_frm - seeder->src_len; }
+    seeder->src_pos  = (t_int64)seeder->src_begin << POS_FRAC_BITS;
+    seeder->play_dir = 1;
+    granular_bound(seeder);
+    break;
+
+  case PARAM_LENGTH:
+    seeder->len_ms     = value;
+    seeder->src_len    = (t_int32)(seeder->len_ms * src_msr);
+    seeder->out_len    = (t_int32)(seeder->len_ms * seeder->shift_r * x->msamplerate);
+    seeder->period_len = (t_int32)(seeder->out_len * seeder->period);
+    break;
+
+  case PARAM_SHIFT:
+    seeder->shift      = value;
+    seeder->shift_r    = (t_double)exp(- LN2 * seeder->shift);
+    seeder->out_len    = (t_int32)(seeder->len_ms * seeder->shift_r * x->msamplerate);
+    seeder->period_len = (t_int32)(seeder->out_len * seeder->period);
+    break;
+
+  case PARAM_PERIOD:
+    seeder->period     = value;
+    seeder->period_len = (t_int32)(seeder->out_len * seeder->period);
+    break;
+
+  case PARAM_SPEED:
+    seeder->speed = value;
+    break;
+
+  case PARAM_POLY:
+    seeder->poly_cnt = (t_int16)value;
+    for (t_int16 i = 0; i < seeder->poly_cnt; i++) {
+      seeder->period_cntd[i] = (t_int32)(i * seeder->period_len / seeder->poly_cnt);
+    }
+    break;
+
+  case PARAM_PERIOD_RAND:
+    seeder->period_rand = value;
+    break;
+
+  case PARAM_ON:
+    if (seeder->is_on || (list_insert_index(x->seeders_list, index) == LIST_END)) { break; }
+    x->seeders_cnt++;
+    seeder->is_on = true;
+    break;
+
+  case PARAM_OFF:
+    if (seeder->is_on && (list_remove_index(x->seeders_list, index) != LIST_END)) {
+      x->seeders_cnt--;
+      seeder->is_on = false;
+    }
+    if (value != 0) { granular_grains_remove(x, index); }
+    break;
+
+  case PARAM_GLIDE_BEGIN:
+  case PARAM_GLIDE_END:
+  case PARAM_GLIDE_RAND:
+    if (param == PARAM_GLIDE_BEGIN)    { seeder->glide_begin = value; }
+    else if (param == PARAM_GLIDE_END) { seeder->glide_end = value; }
+    else                               { seeder->glide_rand = value; }
+    seeder->glide = ((seeder->glide_begin != 0) || (seeder->glide_end != 0) || (seeder->glide_rand != 0));
+    break;
+
+  case PARAM_WAVE:
+    seeder->wave = (t_wave_type)value;
+    break;
+
+  case PARAM_FREQ:
+    seeder->freq = value;
+    break;
+
+  case PARAM_DUTY:
+    seeder->duty = value;
+    break;
+
+  case PARAM_FREQ_RAND:
+    seeder->freq_rand = value;
+    break;
+
+  case PARAM_RING_BEHIND:
+    seeder->ring_behind_ms = value;
+    break;
+
+  case PARAM_SRC_MODE:
+    seeder->src_mode = (t_int8)value;
+    break;
+
+  case PARAM_OVERSAMPLE:
+    seeder->os_ind = (t_int16)value;
+    break;
+
+  case PARAM_INTERP:
+    seeder->interp = (t_interp_type)value;
+    break;
+
+  case PARAM_NORM_TARGET:
+    seeder->norm_target = value;
+    break;
+
+  case PARAM_NORM_MAX:
+    seeder->norm_max = value;
+    break;
+
+  case PARAM_POOL_MODE:
+    seeder->pool_mode = (t_int8)value;
+    seeder->pool_next = 0;
+    break;
+
+  case PARAM_BOUND_MODE:
+    seeder->bound_mode = (t_int8)value;
+    seeder->play_dir   = 1;
+    granular_bound(seeder);
+    break;
+
+  case PARAM_LOOP_BEGIN:
+    seeder->loop_begin = (t_int32)value;
+    granular_bound(seeder);
+    break;
+
+  case PARAM_LOOP_END:
+    seeder->loop_end = (t_int32)value;
+    granular_bound(seeder);
+    break;
+
+  default:
+    break;
+  }
+}
+
+// ========  SEEDERS  ========
+
+// ====  METHOD: GRANULAR_SET_SEEDER  ====
+// Sets all seeder parameters. Called by set_seeder message.
+// Arguments: Int Float Float Float Float Float Float
+//   Arg 0:  Int   - Seeder index
+//   Arg 1:  Float - Amplitude
+//   Arg 2:  Float - Beginning
+//   Arg 3:  Float - Length
+//   Arg 4:  Float - Shift
+//   Arg 5:  Float - Period
+//   Arg 6:  Float - Speed
+//   Arg 7:  Float - Random
+//   Arg 8:  Int   - Number of simultaneous grain streams
+
+void granular_set_seeder(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  TRACE("granular_set_seeder");
+
+  // Check the number of arguments
+  if (argc != 9) {
+    MY_ERR("add_seeder:  Wrong number of arguments. The method expects:");
+    MY_ERR2("  Arg 0:  Int - Seeder index");
+    MY_ERR2("  Arg 1:  Float - Amplitude");
+    MY_ERR2("  Arg 2:  Float - Beginning");
+    MY_ERR2("  Arg 3:  Float - Length");
+    MY_ERR2("  Arg 4:  Float - Shift");
+    MY_ERR2("  Arg 5:  Float - Period");
+    MY_ERR2("  Arg 6:  Float - Speed");
+    MY_ERR2("  Arg 7:  Float - Random");
+    MY_ERR2("  Arg 8:  Int - Number of simultaneous grain streams");
+    return;
+  }
+
+  // Check the validity of the arguments
+  t_int16 index = granular_check_args(x, "set_seeder", argc, argv, 9);
+  if (index == ERR_ARG) { return; }
+
+  // Check the number of grain streams
+  t_int16 poly_cnt = (t_int16)atom_getlong(argv + 8);
 
   if ((poly_cnt < 1) || (poly_cnt > x->poly_max)) {
-    MY_ERR("poly:  Arg 2 (number of grain streams):  Has to be between 1 and %i. Was %i instead.",
+    MY_ERR("add_seeder:  Arg 8 (number of grain streams):  Has to be between 1 and %i. Was %i instead. Set to 1.",
       x->poly_max, poly_cnt);
-    return;
+    poly_cnt = 1;
   }
 
-  x->seeders_arr[index].poly_cnt = poly_cnt;
+  // Queue the changes: the length comes before the beginning which is bounded by it,
+  // and the number of streams comes last as it resets the period countdowns
+  granular_param_push(x, index, PARAM_AMPL,        (t_double)atom_getfloat(argv + 1));
+  granular_param_push(x, index, PARAM_LENGTH,      (t_double)atom_getfloat(argv + 3));
+  granular_param_push(x, index, PARAM_BEGIN,       (t_double)atom_getfloat(argv + 2));
+  granular_param_push(x, index, PARAM_SHIFT,       (t_double)atom_getfloat(argv + 4));
+  granular_param_push(x, index, PARAM_PERIOD,      (t_double)atom_getfloat(argv + 5));
+  granular_param_push(x, index, PARAM_SPEED,       (t_double)atom_getfloat(argv + 6));
+  granular_param_push(x, index, PARAM_PERIOD_RAND, (t_double)atom_getfloat(argv + 7));
+  granular_param_push(x, index, PARAM_POLY,        poly_cnt);
+}
+
+// ====  METHOD: GRANULAR_GET_SEEDER  ====
+// Gets all seeder parameters. Called by get_seeder message, with a seeder index, or with "all" or no argument
+// to get all the seeders in a single "seeders" message of 13 atoms per seeder, in index order.
+// Output: seeder Int Sym Float Float Float Float Float Float Float Int Sym Sym Sym
+//    Arg 0:  Int - Seeder index
+//    Arg 1:  Sym - ON or OFF
+//    Arg 2:  Float - Amplitude
+//    Arg 3:  Float - Beginning
+//    Arg 4:  Float - Length
+//    Arg 5:  Float - Shift
+//    Arg 6:  Float - Period
+//    Arg 7:  Float - Speed
+//    Arg 8:  Float - Random
+//    Arg 9:  Int - Number of simultaneous grain streams
+//    Arg 10:  Symbol - Envelope type
+//    Arg 11:  Symbol - Buffer name
+//    Arg 12:  Symbol - File name
+
+void granular_get_seeder(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  TRACE("granular_get_seeder");
+
+  // All the seeders in one message
+  if ((argc == 0) || ((argc == 1) && (atom_gettype(argv) == A_SYM) && (atom_getsym(argv) == gensym("all")))) {
+
+    t_atom* atom = x->mess_arr;
 
-  for (int i = 0; i < x->seeders_arr[index].poly_cnt; i++) {
-    x->seeders_arr[index].period_cntd[i] =
-      (t_int32)(i * x->seeders_arr[index].period_len / x->seeders_arr[index].poly_cnt);
+    for (t_int16 index = 0; index < x->seeders_max; index++) {
+      atom = granular_seeder_atoms(x->seeders_arr + index, atom);
     }
+
+    outlet_anything(x->outl_mess, sym_seeders, (short)(atom - x->mess_arr), x->mess_arr);
+    return;
+  }
+
+  // Check the validity of the arguments
+  t_int16 index = granular_check_args(x, "get_seeder", argc, argv, 1);
+  if (index == ERR_ARG) { return; }
+
+  granular_seeder_atoms(x->seeders_arr + index, x->mess_arr);
+
+  outlet_anything(x->outl_mess, sym_seeder, MESS_SEEDER_LEN, x->mess_arr);
+}
+
+// ====  PROCEDURE: GRANULAR_SEEDER_ATOMS  ====
+// Write the MESS_SEEDER_LEN atoms describing a seeder, in the order of the get_seeder reply.
+// RETURNS: The atom following the last one written
+
+t_atom* granular_seeder_atoms(t_seeder* seeder, t_atom* atom) {
+
+  atom_setlong (atom++, seeder->index);
+  atom_setsym  (atom++, (seeder->on_msg ? sym_on : sym_off));
+  atom_setfloat(atom++, seeder->ampl);
+  atom_setfloat(atom++, seeder->src_begin);
+  atom_setfloat(atom++, seeder->src_len_ms);
+  atom_setfloat(atom++, seeder->shift);
+  atom_setfloat(atom++, seeder->period);
+  atom_setfloat(atom++, seeder->speed);
+  atom_setfloat(atom++, seeder->period_rand);
+  atom_setfloat(atom++, seeder->poly_cnt);
+  atom_setsym  (atom++, seeder->env_sym);
+  atom_setsym  (atom++, seeder->buff_sym);
+  atom_setsym  (atom++, seeder->buff_file);
+
+  return atom;
+}
+
+// ====  METHOD: GRANULAR_SEEDER_ON  ====
+
+void granular_seeder_on(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  TRACE("granular_seeder_on");
+
+  // Check the validity of the arguments
+  t_int16 index = granular_check_args(x, "seeder_on", argc, argv, 1);
+  if (index == ERR_ARG) {
+    outlet_bang(x->outl_compl);
+    return;
+  }
+
+  t_seeder* seeder = x->seeders_arr + index;
+
+  // Check if the seeder is already on, or about to be: the audio thread may not have applied the last change yet
+  if (seeder->on_msg == true) {
+    //POST("seeder_on:  Arg 0 (index of the seeder):  Seeder %i is already on.", index);
+    outlet_bang(x->outl_compl);
+    return;
+  }
+
+  // Check that a file has been loaded in the buffer, unless the seeder uses an oscillator source
+  if ((seeder->src_mode_msg == SRC_MODE_BUFFER) && (seeder->buff_state == BUFF_NO_FILE)) {
+    POST("seeder_on:  Source buffer for seeder %i has no file loaded in.", index);
+    outlet_bang(x->outl_compl);
+    return;
+  }
+
+  // Check that the seeder has a buffer linked to it
+  if ((seeder->src_mode_msg == SRC_MODE_BUFFER) && (seeder->buff_state != BUFF_READY)) {
+    POST("seeder_on:  Source buffer for seeder %i is not ready to be used.", index);
+    outlet_bang(x->outl_compl);
+    return;
+  }
+
+  // The audio thread adds the seeder to the active list before the next sub-block
+  seeder->on_msg = true;
+  granular_param_push(x, index, PARAM_ON, 1);
+
+  outlet_bang(x->outl_compl);
 }
 
-// ====  METHOD: GRANULAR_PERIOD_RAND  ====
+// ====  METHOD: GRANULAR_SEEDER_OFF  ====
+
+void granular_seeder_off(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  TRACE("granular_seeder_off");
+
+  // Check the validity of the arguments
+  t_int16 index = granular_check_args(x, "seeder_off", argc, argv, 1);
+  if (index == ERR_ARG) {
+    outlet_bang(x->outl_compl);
+    return;
+  }
+
+  // Check if the seeder is already off, or about to be
+  if (x->seeders_arr[index].on_msg == false) {
+    //POST("seeder_off:  Arg 0 (index of the seeder):  Seeder %i is already off.", index);
+    outlet_bang(x->outl_compl);
+    return;
+  }
+
+  // The audio thread removes the seeder from the active list before the next sub-block, its grains carry on
+  x->seeders_arr[index].on_msg = false;
+  granular_param_push(x, index, PARAM_OFF, 0);
+
+  outlet_bang(x->outl_compl);
+}
+
+// ====  METHOD: GRANULAR_FOCUS  ====
+
+void granular_focus(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  TRACE("granular_focus");
+
+  // Check the validity of the arguments
+  t_int16 index = granular_check_args(x, "focus", argc, argv, 1);
+  if (index == ERR_ARG) { return; }
+
+  x->seeders_foc = index;
+
+  outlet_bang(x->outl_compl);
+}
+
+// ====  METHOD: GRANULAR_AMPL  ====
+
+void granular_ampl(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  //TRACE("granular_ampl");
+
+  granular_param_push(x, (t_int16)atom_getlong(argv), PARAM_AMPL, (t_double)atom_getfloat(argv + 1));
+}
+
+// ====  METHOD: GRANULAR_BEGIN  ====
+// Argument comes in as a float between 0 and 1
+
+void granular_begin(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  //TRACE("granular_begin");
+
+  granular_param_push(x, (t_int16)atom_getlong(argv), PARAM_BEGIN, (t_double)atom_getfloat(argv + 1));
+}
+
+// ====  METHOD: GRANULAR_LENGTH  ====
+// Argument is the source length in ms
+
+void granular_length(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  //TRACE("granular_length");
+
+  granular_param_push(x, (t_int16)atom_getlong(argv), PARAM_LENGTH, (t_double)atom_getfloat(argv + 1));
+}
+
+// ====  METHOD: GRANULAR_SHIFT  ====
+
+void granular_shift(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  //TRACE("granular_shift");
+
+  granular_param_push(x, (t_int16)atom_getlong(argv), PARAM_SHIFT, (t_double)atom_getfloat(argv + 1));
+}
+
+// ====  METHOD: GRANULAR_PERIOD  ====
+
+void granular_period(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  //TRACE("granular_period");
+
+  granular_param_push(x, (t_int16)atom_getlong(argv), PARAM_PERIOD, (t_double)atom_getfloat(argv + 1));
+}
+
+// ====  METHOD: GRANULAR_SPEED  ====
+
+void granular_speed(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  //TRACE("granular_speed");
+
+  granular_param_push(x, (t_int16)atom_getlong(argv), PARAM_SPEED, (t_double)atom_getfloat(argv + 1));
+}
+
+// ====  METHOD: GRANULAR_POLY  ====
+
+void granular_poly(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  //TRACE("granular_poly");
+
+  t_int16 index    = (t_int16)atom_getlong(argv);
+  t_int16 poly_cnt = (t_int16)atom_getfloat(argv + 1);
+
+  if ((poly_cnt < 1) || (poly_cnt > x->poly_max)) {
+    MY_ERR("poly:  Arg 2 (number of grain streams):  Has to be between 1 and %i. Was %i instead.",
+      x->poly_max, poly_cnt);
+    return;
+  }
+
+  granular_param_push(x, index, PARAM_POLY, poly_cnt);
+}
+
+// ====  METHOD: GRANULAR_PERIOD_RAND  ====
+
+void granular_period_rand(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  //TRACE("granular_period_rand");
+
+  granular_param_push(x, (t_int16)atom_getlong(argv), PARAM_PERIOD_RAND, (t_double)atom_getfloat(argv + 1));
+}
+
+// ====  METHOD: GRANULAR_BUFFER  ====
+
+void granular_buffer(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  TRACE("granular_buffer");
+
+  //====== Check the number of arguments
+  if (argc == 2) {
+
+    //==== If the first atom is a symbol it has to be "env"
+    if ((atom_getsym(argv) == sym_env) && (atom_gettype(argv + 1) == A_SYM)) {
+
+      //== Create the envelope buffer reference and object
+      x->buff_env_sym = atom_getsym(argv + 1);
+
+      if (x->buff_env_ref) {
+        buffer_ref_set(x->buff_env_ref, x->buff_env_sym);
+      }
+      else {
+        x->buff_env_ref = buffer_ref_new((t_object*)x, x->buff_env_sym);
+      }
+
+      x->buff_env_obj = buffer_ref_getobject(x->buff_env_ref);
+
+      //== If the envelope buffer is successfully found
+      if (x->buff_env_obj) {
+
+        // Set the size of the envelope buffer
+        t_max_err max_err = object_method_long(x->buff_env_obj, gensym("sizeinsamps"), x->env_n_frm, NULL);
+        if (max_err != MAX_ERR_NONE) {
+          MY_ERR("buffer:  Unable to set the size of the envelope buffer \"%s\"", x->buff_env_sym->s_name); return;
+        }
+
+        POST("buffer:  Envelope buffer \"%s\" successfully linked to.", x->buff_env_sym->s_name); return;
+      }
+
+      else {
+        x->buff_env_ref = NULL;
+        MY_ERR("buffer:  Unable to link to envelope buffer \"%s\".", x->buff_env_sym->s_name);
+        return;
+      }
+    }
+
+    //==== Or "viz" to set the visualization buffer
+    else if ((atom_getsym(argv) == sym_viz) && (atom_gettype(argv + 1) == A_SYM)) {
+
+      //== Create the visualization buffer reference
+      x->buff_viz_sym = atom_getsym(argv + 1);
+
+      if (x->buff_viz_ref) {
+        buffer_ref_set(x->buff_viz_ref, x->buff_viz_sym);
+      }
+      else {
+        x->buff_viz_ref = buffer_ref_new((t_object*)x, x->buff_viz_sym);
+      }
+
+      t_buffer_obj* buff_viz_obj = buffer_ref_getobject(x->buff_viz_ref);
+
+      //== If the visualization buffer is successfully found
+      if (buff_viz_obj) {
+
+        // Set the size of the visualization buffer: the number of grains followed by the values for each grain
+        t_max_err max_err = object_method_long(buff_viz_obj, gensym("sizeinsamps"), 1 + VIZ_N_VAL * x->grains_max, NULL);
+        if (max_err != MAX_ERR_NONE) {
+          MY_ERR("buffer:  Unable to set the size of the visualization buffer \"%s\"", x->buff_viz_sym->s_name); return;
+        }
+
+        POST("buffer:  Visualization buffer \"%s\" successfully linked to.", x->buff_viz_sym->s_name); return;
+      }
+
+      else {
+        MY_ERR("buffer:  Unable to link to visualization buffer \"%s\".", x->buff_viz_sym->s_name);
+        return;
+      }
+    }
+
+    //==== If the first atom is an integer
+    else if ((atom_gettype(argv) == A_LONG) && (atom_gettype(argv + 1) == A_SYM)) {
+
+      //== Check that it is between 0 and (x->seeders_max - 1)
+      t_int16 index = (t_int16)atom_getlong(argv);
+      if ((index >= 0) && (index < x->seeders_max)) {
+
+        t_seeder* seeder = x->seeders_arr + index;
+
+        // Create the source buffer reference and object
+        seeder->buff_sym = atom_getsym(argv + 1);
+
+        // Test the name / symbol
+        if (seeder->buff_sym == sym_empty) {
+          seeder->buff_state = BUFF_NO_SYM;
+          MY_ERR("buffer:  Unable to link seeder %i to source buffer. Could not get a valid name.", index);
+          return;
+        }
+
+        // Test the buffer reference
+        if (seeder->buff_ref) { buffer_ref_set(seeder->buff_ref, seeder->buff_sym); }
+        else { seeder->buff_ref = buffer_ref_new((t_object*)x, seeder->buff_sym); }
+
+        if (seeder->buff_ref == NULL) {
+          seeder->buff_state = BUFF_NO_REF;
+          MY_ERR("buffer:  Unable to link seeder %i to source buffer \"%s\". Could not get a valid reference.", index, seeder->buff_sym->s_name);
+          return;
+        }
+
+        // Test the buffer object
+        seeder->buff_obj = buffer_ref_getobject(seeder->buff_ref);
+
+        if (seeder->buff_obj == NULL) {
+          seeder->buff_state = BUFF_NO_OBJ;
+          granular_src_publish(x, seeder, NULL);
+          MY_ERR("buffer:  Unable to link seeder %i to source buffer \"%s\". Could not get a valid object.", index, seeder->buff_sym->s_name);
+          return;
+        }
+
+        // Test if a file is loaded
+        seeder->buff_n_frm = (t_int32)buffer_getframecount(seeder->buff_obj);
+        seeder->buff_n_chn = (t_int16)buffer_getchannelcount(seeder->buff_obj);
+        seeder->buff_msr   = buffer_getmillisamplerate(seeder->buff_obj);
+
+        if ((seeder->buff_n_frm == 0) || (seeder->buff_n_chn == 0) || (seeder->buff_msr == 0)) {
+          seeder->buff_state = BUFF_NO_FILE;
+          granular_src_publish(x, seeder, NULL);
+          POST("buffer:  Seeder %i successfully linked to source buffer \"%s\". No file loaded yet.", index, seeder->buff_sym->s_name);
+          return;
+        }
+
+        // Otherwise the buffer is linked and a file is loaded.
+        seeder->buff_state = BUFF_READY;
+        POST("buffer:  Seeder %i successfully linked to source buffer \"%s\".", index, seeder->buff_sym->s_name);
+
+        if (seeder->mem_mode != MEM_MODE_OFF) { granular_memory_load(x, seeder); }
+        else { granular_src_publish(x, seeder, NULL); }
+        if (seeder->norm_target > 0) { granular_psum_load(x, seeder); }
+        granular_loop_update(x, seeder);
+        granular_param_push(x, index, PARAM_LENGTH, seeder->src_len_ms);
+        return;
+      }
+
+      //== Otherwise the index is out of bounds
+      else {
+        MY_ERR("buffer:  Arg 0 (index of the seeder):  Has to be between 0 and %i, was %i instead.", x->seeders_max - 1, index);
+        return;
+      }
+    }
+  }
+
+  MY_ERR("buffer:  Invalid arguments. The method expects:");
+  MY_ERR2("  Arg 0:  Int or Symbol - Seeder index to set a source buffer, \"env\" to set the envelope buffer,");
+  MY_ERR2("          or \"viz\" to set the visualization buffer.");
+  MY_ERR2("  Arg 1:  Symbol - The name of the buffer");
+}
+
+// ====  METHOD: GRANULAR_FILE  ====
+
+void granular_file(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  TRACE("granular_file");
+
+  // Check the validity of the arguments
+  t_int16 index = granular_check_args(x, "file", argc, argv, 3);
+  if (index == ERR_ARG) { outlet_bang(x->outl_compl); return; }
+
+  t_seeder* seeder = x->seeders_arr + index;
+
+  // The audio thread sets the seeder off and removes its grains before the next sub-block,
+  // also when it is off already, as the grains of a seeder turned off carry on
+  seeder->on_msg = false;
+  granular_param_push(x, index, PARAM_OFF, 1);
+
+  // Get the file name and full name with path, the seeder cannot be turned on until the file is loaded
+  seeder->buff_file   = atom_getsym(argv + 1);
+  seeder->buff_path   = atom_getsym(argv + 2);
+  seeder->buff_state  = BUFF_LOADING;
+
+  // Read the file once the grains are removed
+  t_atom av[2];
+  atom_setlong(av, index);
+  atom_setlong(av + 1, ATOMIC_LOAD(x->epoch));
+  granular_file_read(x, sym, 2, av);
+}
+
+// ====  PROCEDURE: GRANULAR_FILE_READ  ====
+// Read the file of a seeder into its buffer, once the audio thread removed the grains that read the buffer.
+// With the DSP off the removal was applied at once, or will be before the next render. With the DSP on, the read
+// is deferred until the audio thread finished two vector cycles from the file message: the one that may have
+// drained the queue before the removal was pushed, and the one that drained it. If the perform routine does not
+// run (muted or disabled subpatcher), after FILE_WAIT_MS the read takes the engine and drains the queue itself.
+// Arguments: Int Int [Float]
+//   Arg 0:  Int   - Seeder index
+//   Arg 1:  Int   - Audio epoch when the removal was pushed
+//   Arg 2:  Float - Time of the first deferral in ms, set when the read is first deferred
+
+void granular_file_read(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  TRACE("granular_file_read");
+
+  t_int16   index  = (t_int16)atom_getlong(argv);
+  t_int32   epoch  = (t_int32)atom_getlong(argv + 1);
+  t_seeder* seeder = x->seeders_arr + index;
+  t_atom    av[3];
+
+  if (sys_getdspobjdspstate((t_object*)x) && ((t_int32)(ATOMIC_LOAD(x->epoch) - epoch) < 2)) {
+
+    t_double time_now   = systimer_gettime();
+    t_double time_begin = ((argc > 2) ? (t_double)atom_getfloat(argv + 2) : time_now);
+    t_bool   drained    = false;
+
+    // The perform routine does not run: apply the removal while owning the engine
+    if ((time_now - time_begin >= FILE_WAIT_MS) && granular_engine_acquire(x)) {
+      granular_param_drain(x);
+      granular_engine_release(x);
+      drained = true;
+    }
+
+    if (!drained) {
+      av[0] = argv[0];
+      av[1] = argv[1];
+      atom_setfloat(av + 2, time_begin);
+      defer_low(x, (method)granular_file_read, sym, 3, av);
+      return;
+    }
+  }
+
+  // The buffer was changed meanwhile, or a later file message already read the file
+  if (seeder->buff_state != BUFF_LOADING) { outlet_bang(x->outl_compl); return; }
+
+  seeder->buff_state  = BUFF_READY;
+  seeder->buff_is_chg = true;
+
+  // Send out a read message to the buffer object
+  atom_setsym  (x->mess_arr, seeder->buff_path);
+  atom_setfloat(x->mess_arr + 1, 0);
+  atom_setlong (x->mess_arr + 2, -1);
+  atom_setlong (x->mess_arr + 3, 1);
+
+  t_atom ret;
+  object_method_typed(seeder->buff_obj, gensym("read"), 4, x->mess_arr, &ret);
+  buffer_setdirty(seeder->buff_obj);
+  granular_param_push(x, index, PARAM_BEGIN, 0);
+
+  outlet_bang(x->outl_compl);
+}
+
+// ====  PROCEDURE: GRANULAR_GRAINS_REMOVE  ====
+// Remove all the grains of a seeder. Called by the audio thread, or by the message thread while the DSP is off.
+
+void granular_grains_remove(t_granular* x, t_int16 index) {
+
+  t_int16* node = x->grains_list->first_used;
+  t_grain* grain;
+
+  while (*node != LIST_END) {
+
+    grain = x->grains_arr + *node;
+
+    if (grain->index == index) {
+      ATOMIC_DECREMENT(&grain->env_table->grain_cnt);
+      if (grain->src_handle) { ATOMIC_DECREMENT(&grain->src_handle->grain_cnt); }
+      if (grain->block) { ATOMIC_DECREMENT(&grain->block->grain_cnt); }
+      x->grains_cnt--;
+      list_remove_node(x->grains_list, node);
+    }
+    else {
+      node = x->grains_list->array + *node;
+    }
+  }
+}
+
+// ====  METHOD: GRANULAR_MEMORY  ====
+// Sets where the grains of a seeder read their source samples. Called by memory message.
+// Arguments: Int Int
+//   Arg 0:  Int - Seeder index
+//   Arg 1:  Int - 0: read from the buffer, 1: read from a locked copy, 2: read from a locked copy on huge pages
+
+void granular_memory(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  TRACE("granular_memory");
+
+  // Check the validity of the arguments
+  t_int16 index = granular_check_args(x, "memory", argc, argv, 2);
+  if (index == ERR_ARG) { return; }
+
+  t_seeder* seeder = x->seeders_arr + index;
+  t_int8    mode   = (t_int8)atom_getlong(argv + 1);
+
+  if ((mode < MEM_MODE_OFF) || (mode > MEM_MODE_HUGE)) {
+    MY_ERR("memory:  Arg 1 (memory mode):  Has to be 0 (buffer), 1 (locked) or 2 (locked, huge pages). Was %i instead.", mode);
+    return;
+  }
+
+  seeder->mem_mode = mode;
+
+  // Publish a handle without copy, the old copy is freed once its grains end
+  if (mode == MEM_MODE_OFF) {
+    granular_src_publish(x, seeder, NULL);
+    POST("memory:  Seeder %i reads directly from the source buffer.", index);
+    return;
+  }
+
+  // Otherwise copy the source now if it is ready, or when it becomes ready
+  if (seeder->buff_state == BUFF_READY) { granular_memory_load(x, seeder); }
+  else { POST("memory:  Seeder %i:  The source will be copied once a file is loaded.", index); }
+}
+
+// ====  PROCEDURE: GRANULAR_MEMORY_LOAD  ====
+// Copy the source buffer of a seeder into an engine owned memory block, locked in RAM where possible,
+// and touch all its pages so that grains never cause page faults. Posts a report of what succeeded.
+// The copy is published with a new source handle. If anything fails the seeder reads from the buffer directly.
+
+void granular_memory_load(t_granular* x, t_seeder* seeder) {
+
+  TRACE("granular_memory_load");
+
+  t_mem_block mem_new;
+
+  TL_BEGIN(tl_memory);
+
+  t_buffer_obj* buff_obj = buffer_ref_getobject(seeder->buff_ref);
+  size_t n_smp = (buff_obj ? (size_t)buffer_getframecount(buff_obj) * (size_t)buffer_getchannelcount(buff_obj) : 0);
+
+  if (n_smp == 0) {
+    granular_src_publish(x, seeder, NULL);
+    MY_ERR("memory:  Seeder %i:  The source buffer is empty. Reading from the buffer directly.", seeder->index);
+    return;
+  }
+
+  // Allocate one extra frame as a zeroed guard for interpolation at the end of the source
+  size_t size = (n_smp + buffer_getchannelcount(buff_obj)) * sizeof(float);
+  t_uint8 flags = mem_alloc(&mem_new, size, (seeder->mem_mode == MEM_MODE_HUGE), true);
+
+  if (!(flags & MEM_ALLOCATED)) {
+    granular_src_publish(x, seeder, NULL);
+    MY_ERR("memory:  Seeder %i:  Unable to allocate %.1f MB. Reading from the buffer directly.", seeder->index, size / 1048576.);
+    return;
+  }
+
+  float* buff_src = buffer_locksamples(buff_obj);
+
+  if (buff_src == NULL) {
+    mem_free(&mem_new);
+    granular_src_publish(x, seeder, NULL);
+    MY_ERR("memory:  Seeder %i:  Unable to access the source buffer. Reading from the buffer directly.", seeder->index);
+    return;
+  }
+
+  memcpy(mem_new.ptr, buff_src, n_smp * sizeof(float));
+  buffer_unlocksamples(buff_obj);
+
+  mem_pretouch(&mem_new);
+
+  t_uint8 mem_flags = mem_new.flags;
+  granular_src_publish(x, seeder, &mem_new);
+
+  TL_END(tl_memory, TL_MAIN, TL_MEMORY, seeder->index);
+
+  POST("memory:  Seeder %i:  %.1f MB copied - Huge pages: %s - Locked: %s - Touched: %s", seeder->index, size / 1048576.,
+    ((mem_flags & MEM_HUGE_PAGES) ? "yes" : "no"), ((mem_flags & MEM_LOCKED) ? "yes" : "no"),
+    ((mem_flags & MEM_TOUCHED) ? "yes" : "no"));
+}
+
+// ====  PROCEDURE: GRANULAR_SRC_PUBLISH  ====
+// Publish a new source handle for a seeder from its current buffer and metadata, taking ownership of the copy
+// if one is given. Grains added from now on read the new handle, live grains finish with the old one, which is retired.
+// Publishes no handle when the source is not ready. If the handle cannot be published the copy is freed.
+
+void granular_src_publish(t_granular* x, t_seeder* seeder, t_mem_block* mem) {
+
+  TRACE("granular_src_publish");
+
+  // Free the handles that no grain reads anymore, and make room for the one that is replaced
+  granular_src_reclaim(x, false);
+
+  if ((seeder->src_handle != NULL) && (x->src_retired_cnt == SRC_RETIRED_MAX)) {
+    if (mem) { mem_free(mem); }
+    MY_ERR("Seeder %i:  Too many source changes are waiting for their grains to end. Keeping the previous source.", seeder->index);
+    return;
+  }
+
+  t_src_handle* handle_new = NULL;
+  t_src_handle* handle_old = seeder->src_handle;
+
+  if ((seeder->buff_obj != NULL) && (seeder->buff_n_frm > 0) && (seeder->buff_n_chn > 0)) {
+
+    handle_new = (t_src_handle*)sysmem_newptr(sizeof(t_src_handle));
+
+    if (handle_new == NULL) {
+      if (mem) { mem_free(mem); }
+      MY_ERR("Seeder %i:  Unable to allocate the source handle. Keeping the previous source.", seeder->index);
+      return;
+    }
+
+    handle_new->grain_cnt = 0;
+    handle_new->epoch     = 0;
+    handle_new->buff_obj  = seeder->buff_obj;
+    handle_new->n_chn     = seeder->buff_n_chn;
+    handle_new->n_frm     = seeder->buff_n_frm;
+    handle_new->msr       = seeder->buff_msr;
+
+    if (mem) { handle_new->mem = *mem; }
+    else { mem_init(&handle_new->mem); }
+  }
+
+  else if (mem) { mem_free(mem); }
+
+  // Publish the new handle
+  PTR_PUBLISH(seeder->src_handle, handle_new);
+
+  if (handle_old != NULL) {
+    handle_old->epoch = ATOMIC_LOAD(x->epoch);
+    x->src_retired[x->src_retired_cnt++] = handle_old;
+  }
+}
+
+// ====  PROCEDURE: GRANULAR_SRC_RECLAIM  ====
+// Free the retired source handles and their copies once they are safe to free, as for envelope tables.
+
+void granular_src_reclaim(t_granular* x, t_bool force) {
+
+  t_bool        dsp_on = (sys_getdspobjdspstate((t_object*)x) != 0);
+  t_src_handle* handle;
+  t_int16       cnt = 0;
+
+  for (t_int16 i = 0; i < x->src_retired_cnt; i++) {
+
+    handle = x->src_retired[i];
+
+    if (force || (((!dsp_on) || (ATOMIC_LOAD(x->epoch) != handle->epoch)) && (ATOMIC_LOAD(handle->grain_cnt) == 0))) {
+      mem_free(&handle->mem);
+      sysmem_freeptr(handle);
+    }
+    else {
+      x->src_retired[cnt++] = handle;
+    }
+  }
+
+  x->src_retired_cnt = cnt;
+}
+
+// ====  PROCEDURE: GRANULAR_SRC_NEW  ====
+// Allocate a source handle reading a buffer directly, from its current metadata.
+// RETURNS: The handle, or NULL if the buffer has no samples or the allocation failed
+
+t_src_handle* granular_src_new(t_buffer_obj* buff_obj) {
+
+  if (buff_obj == NULL) { return NULL; }
+
+  t_int16      n_chn = (t_int16)buffer_getchannelcount(buff_obj);
+  t_int32      n_frm = (t_int32)buffer_getframecount(buff_obj);
+  t_atom_float msr   = buffer_getmillisamplerate(buff_obj);
+
+  if ((n_chn <= 0) || (n_frm <= 0) || (msr <= 0)) { return NULL; }
+
+  t_src_handle* handle = (t_src_handle*)sysmem_newptr(sizeof(t_src_handle));
+
+  if (handle == NULL) { return NULL; }
+
+  handle->grain_cnt = 0;
+  handle->epoch     = 0;
+  handle->buff_obj  = buff_obj;
+  handle->n_chn     = n_chn;
+  handle->n_frm     = n_frm;
+  handle->msr       = msr;
+  mem_init(&handle->mem);
+
+  return handle;
+}
+
+// ====  PROCEDURE: GRANULAR_BLOCK_NEW  ====
+// Allocate a shared block with size bytes of data, covering n_frm frames
+
+t_shared_block* granular_block_new(t_int32 n_frm, size_t size) {
+
+  t_shared_block* block = (t_shared_block*)sysmem_newptr(sizeof(t_shared_block) + size);
+
+  if (block == NULL) { return NULL; }
+
+  block->grain_cnt = 0;
+  block->epoch     = 0;
+  block->n_frm     = n_frm;
+  block->n_chn     = 1;
+  block->offset    = 0;
+  block->data      = block + 1;
+
+  return block;
+}
+
+// ====  PROCEDURE: GRANULAR_BLOCK_PUBLISH  ====
+// Publish a shared block, or NULL, in place of the one at dst, which is retired.
+// Returns false and frees the new block if too many blocks are waiting for their grains to end.
+
+t_bool granular_block_publish(t_granular* x, t_shared_block** dst, t_shared_block* block) {
+
+  t_shared_block* block_old = *dst;
+
+  // Free the blocks that no grain reads anymore, and make room for the one that is replaced
+  granular_block_reclaim(x, false);
+
+  if ((block_old != NULL) && (x->blk_retired_cnt == BLK_RETIRED_MAX)) {
+    if (block) { sysmem_freeptr(block); }
+    return false;
+  }
+
+  PTR_PUBLISH(*dst, block);
+
+  if (block_old != NULL) {
+    block_old->epoch = ATOMIC_LOAD(x->epoch);
+    x->blk_retired[x->blk_retired_cnt++] = block_old;
+  }
+
+  return true;
+}
+
+// ====  PROCEDURE: GRANULAR_BLOCK_RECLAIM  ====
+// Free the retired shared blocks once they are safe to free, as for envelope tables.
+
+void granular_block_reclaim(t_granular* x, t_bool force) {
+
+  t_bool          dsp_on = (sys_getdspobjdspstate((t_object*)x) != 0);
+  t_shared_block* block;
+  t_int16         cnt = 0;
+
+  for (t_int16 i = 0; i < x->blk_retired_cnt; i++) {
+
+    block = x->blk_retired[i];
+
+    if (force || (((!dsp_on) || (ATOMIC_LOAD(x->epoch) != block->epoch)) && (ATOMIC_LOAD(block->grain_cnt) == 0))) {
+      sysmem_freeptr(block);
+    }
+    else {
+      x->blk_retired[cnt++] = block;
+    }
+  }
+
+  x->blk_retired_cnt = cnt;
+}
+
+// ====  METHOD: GRANULAR_INTERP  ====
+// Sets the interpolation of the source samples for the grains of a seeder. Called by interp message.
+// Arguments: Int Int
+//   Arg 0:  Int - Seeder index
+//   Arg 1:  Int - 0: no interpolation, 1: linear interpolation
+
+void granular_interp(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  TRACE("granular_interp");
+
+  // Check the validity of the arguments
+  t_int16 index = granular_check_args(x, "interp", argc, argv, 2);
+  if (index == ERR_ARG) { return; }
+
+  t_atom_long interp = atom_getlong(argv + 1);
+
+  if ((interp < INTERP_NONE) || (interp >= INTERP_LAST)) {
+    MY_ERR("interp:  Arg 1 (interpolation):  Has to be 0 (none) or 1 (linear). Was %i instead.", (t_int16)interp);
+    return;
+  }
+
+  granular_param_push(x, index, PARAM_INTERP, (t_double)interp);
+}
+
+// ====  METHOD: GRANULAR_OVERSAMPLE  ====
+// Sets the oversampling factor for the grains of a seeder. Called by oversample message.
+// Grains of oversampled seeders are rendered with the same kernels at 2 or 4 times the samplerate,
+// then decimated by half-band filters. Seeders that are not oversampled do not pay for it.
+// Arguments: Int Int
+//   Arg 0:  Int - Seeder index
+//   Arg 1:  Int - Oversampling factor: 1, 2 or 4
+
+void granular_oversample(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  TRACE("granular_oversample");
+
+  // Check the validity of the arguments
+  t_int16 index = granular_check_args(x, "oversample", argc, argv, 2);
+  if (index == ERR_ARG) { return; }
+
+  t_atom_long factor = atom_getlong(argv + 1);
+
+  switch (factor) {
+  case 1: granular_param_push(x, index, PARAM_OVERSAMPLE, 0); break;
+  case 2: granular_param_push(x, index, PARAM_OVERSAMPLE, 1); break;
+  case 4: granular_param_push(x, index, PARAM_OVERSAMPLE, 2); break;
+  default:
+    MY_ERR("oversample:  Arg 1 (oversampling factor):  Has to be 1, 2 or 4. Was %i instead.", (t_int16)factor);
+    break;
+  }
+}
+
+// ====  METHOD: GRANULAR_POOL  ====
+// Sets the sample pool of a seeder. Called by pool message.
+// Arguments: Int Symbol [Symbol [Float] ...]
+//   Arg 0:  Int    - Seeder index
+//   Arg 1:  Symbol - Selection mode: off, random, sequential or weighted
+//   Then:   Symbol - Optional: names of the pool buffers, each one optionally followed by its weight (default 1).
+//                    Without any buffer only the mode changes.
+
+void granular_pool(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  TRACE("granular_pool");
+
+  // Check the validity of the seeder index and mode
+  if ((argc < 2) || (atom_gettype(argv + 1) != A_SYM)) {
+    MY_ERR("pool:  Invalid arguments. The method expects:");
+    MY_ERR2("  Arg 0:  Int - Seeder index");
+    MY_ERR2("  Arg 1:  Symbol - Mode: off, random, sequential or weighted");
+    MY_ERR2("  Then:   Symbol [Float] - Optional: pool buffers, each one optionally followed by its weight");
+    return;
+  }
+
+  t_int16 index = granular_check_args(x, "pool", 1, argv, 1);
+  if (index == ERR_ARG) { return; }
+
+  t_seeder* seeder   = x->seeders_arr + index;
+  t_symbol* mode_sym = atom_getsym(argv + 1);
+  t_int8    mode;
+
+  if      (mode_sym == sym_off)                 { mode = POOL_OFF; }
+  else if (mode_sym == gensym("random"))        { mode = POOL_RANDOM; }
+  else if (mode_sym == gensym("sequential"))    { mode = POOL_SEQUENTIAL; }
+  else if (mode_sym == gensym("weighted"))      { mode = POOL_WEIGHTED; }
+  else {
+    MY_ERR("pool:  Arg 1 (mode):  Has to be off, random, sequential or weighted. Was %s instead.", mode_sym->s_name);
+    return;
+  }
+
+  // Only change the mode
+  if (argc == 2) {
+    if ((mode != POOL_OFF) && (seeder->pool_cnt == 0)) {
+      MY_ERR("pool:  Seeder %i:  The pool is empty. Grains read from the seeder's buffer.", index);
+    }
+    granular_param_push(x, index, PARAM_POOL_MODE, mode);
+    return;
+  }
+
+  // Allocate the pool array once, it is only used by the message threads
+  if (seeder->pool_arr == NULL) {
+
+    seeder->pool_arr = (t_pool_src*)sysmem_newptrclear(POOL_MAX * sizeof(t_pool_src));
+
+    if (seeder->pool_arr == NULL) {
+      MY_ERR("pool:  Seeder %i:  Unable to allocate the pool.", index);
+      return;
+    }
+  }
+
+  t_int16       cnt = 0;
+  t_double      weight_sum = 0;
+  t_pool_src*   src;
+  t_buffer_obj* buff_obj;
+
+  for (t_int16 arg = 2; arg < argc; arg++) {
+
+    if (atom_gettype(argv + arg) != A_SYM) {
+      MY_ERR("pool:  Arg %i:  Has to be a buffer name.", arg);
+      continue;
+    }
+
+    if (cnt == POOL_MAX) {
+      MY_ERR("pool:  Seeder %i:  The pool is limited to %i buffers.", index, POOL_MAX);
+      break;
+    }
+
+    src = seeder->pool_arr + cnt;
+    src->buff_sym = atom_getsym(argv + arg);
+
+    // Weight: the next atom if it is a number
+    t_double weight = 1;
+    if ((arg + 1 < argc) && (atom_gettype(argv + arg + 1) != A_SYM)) {
+      weight = (t_double)atom_getfloat(argv + arg + 1);
+      if (weight < 0) { weight = 0; }
+      arg++;
+    }
+
+    weight_sum += weight;
+    src->weight = weight;
+
+    if (src->buff_ref) { buffer_ref_set(src->buff_ref, src->buff_sym); }
+    else { src->buff_ref = buffer_ref_new((t_object*)x, src->buff_sym); }
+
+    buff_obj = buffer_ref_getobject(src->buff_ref);
+
+    if ((buff_obj == NULL) || (buffer_getframecount(buff_obj) == 0)) {
+      POST("pool:  Seeder %i:  Buffer \"%s\" has no file loaded yet.", index, src->buff_sym->s_name);
+    }
+
+    cnt++;
+  }
+
+  if ((mode == POOL_WEIGHTED) && (weight_sum == 0)) {
+    MY_ERR("pool:  Seeder %i:  The sum of the weights is 0. Using random mode instead.", index);
+    mode = POOL_RANDOM;
+  }
+
+  // Publish the new table before the mode, so that the first grains of the mode read the new sources
+  seeder->pool_cnt = cnt;
+  granular_pool_publish(x, seeder, NULL);
+  granular_param_push(x, index, PARAM_POOL_MODE, mode);
+
+  POST("pool:  Seeder %i:  %i buffers - Mode: %s", index, cnt, mode_sym->s_name);
+}
+
+// ====  PROCEDURE: GRANULAR_POOL_PUBLISH  ====
+// Publish a new pool table for a seeder from its pool array, with new handles for the buffer that changed,
+// or for all the buffers if changed is NULL. The replaced handles and table are retired.
+// If the table cannot be published the previous one is kept.
+
+void granular_pool_publish(t_granular* x, t_seeder* seeder, t_symbol* changed) {
+
+  TRACE("granular_pool_publish");
+
+  t_pool_table*   table_old = (seeder->pool_table ? (t_pool_table*)seeder->pool_table->data : NULL);
+  t_shared_block* block = NULL;
+  t_pool_table*   table = NULL;
+  t_src_handle*   created[POOL_MAX];
+  t_src_handle*   retired[POOL_MAX];
+  t_int16         n_created = 0;
+  t_int16         n_retired = 0;
+  t_double        weight_sum = 0;
+
+  if (seeder->pool_cnt > 0) {
+
+    block = granular_block_new(0, sizeof(t_pool_table));
+
+    if (block == NULL) {
+      MY_ERR("pool:  Seeder %i:  Unable to allocate the pool table. Keeping the previous pool.", seeder->index);
+      return;
+    }
+
+    table = (t_pool_table*)block->data;
+    table->cnt = seeder->pool_cnt;
+
+    for (t_int16 i = 0; i < table->cnt; i++) {
+
+      weight_sum += seeder->pool_arr[i].weight;
+      table->weight_sum[i] = weight_sum;
+
+      // Carry the handle over if the buffer is the same and did not change
+      if ((changed != NULL) && table_old && (i < table_old->cnt) && (seeder->pool_arr[i].buff_sym != changed)) {
+        table->handle[i] = table_old->handle[i];
+      }
+      else {
+        table->handle[i] = granular_src_new(buffer_ref_getobject(seeder->pool_arr[i].buff_ref));
+        if (table->handle[i] != NULL) { created[n_created++] = table->handle[i]; }
+      }
+    }
+  }
+
+  // The handles of the previous table that are not carried over are retired
+  for (t_int16 i = 0; table_old && (i < table_old->cnt); i++) {
+    if ((table_old->handle[i] != NULL) && (!table || (i >= table->cnt) || (table->handle[i] != table_old->handle[i]))) {
+      retired[n_retired++] = table_old->handle[i];
+    }
+  }
+
+  // Make room for them, then publish the table, which frees it if it cannot be published
+  granular_src_reclaim(x, false);
+
+  t_bool published = false;
+
+  if (x->src_retired_cnt + n_retired <= SRC_RETIRED_MAX) { published = granular_block_publish(x, &seeder->pool_table, block); }
+  else if (block) { sysmem_freeptr(block); }
+
+  if (!published) {
+    for (t_int16 i = 0; i < n_created; i++) { sysmem_freeptr(created[i]); }
+    MY_ERR("pool:  Seeder %i:  Too many changes are waiting for their grains to end. Keeping the previous pool.", seeder->index);
+    return;
+  }
+
+  for (t_int16 i = 0; i < n_retired; i++) {
+    retired[i]->epoch = ATOMIC_LOAD(x->epoch);
+    x->src_retired[x->src_retired_cnt++] = retired[i];
+  }
+}
+
+// ====  PROCEDURE: GRANULAR_POOL_CHOOSE  ====
+// Choose the pool source of the next grain of a seeder. Used by the audio thread, the table is never empty.
+// RETURNS: The index of the source in the pool
+
+t_int16 granular_pool_choose(t_seeder* seeder, t_pool_table* table) {
+
+  t_int16 cnt = table->cnt;
+  t_int16 ind;
+
+  switch (seeder->pool_mode) {
+
+  case POOL_SEQUENTIAL:
+    ind = ((seeder->pool_next < cnt) ? seeder->pool_next : 0);
+    seeder->pool_next = ind + 1;
+    return ind;
+
+  case POOL_WEIGHTED: {
+    // Binary search of the first source whose cumulative weight is above a random value
+    t_double r  = table->weight_sum[cnt - 1] * rand() / ((t_double)RAND_MAX + 1);
+    t_int16  lo = 0;
+    t_int16  hi = cnt - 1;
+
+    while (lo < hi) {
+      ind = (lo + hi) / 2;
+      if (table->weight_sum[ind] > r) { hi = ind; }
+      else { lo = ind + 1; }
+    }
+    return lo;
+  }
+
+  default:
+    return (t_int16)(rand() % cnt);
+  }
+}
+
+// ====  METHOD: GRANULAR_LOOP  ====
+// Sets the loop region of a seeder. Called by loop message.
+// Arguments: Int Float Float
+//   Arg 0:  Int   - Seeder index
+//   Arg 1:  Float - Beginning of the loop region in ms
+//   Arg 2:  Float - End of the loop region in ms, 0 for the end of the buffer
+
+void granular_loop(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  TRACE("granular_loop");
+
+  // Check the validity of the arguments
+  t_int16 index = granular_check_args(x, "loop", argc, argv, 3);
+  if (index == ERR_ARG) { return; }
+
+  t_seeder* seeder   = x->seeders_arr + index;
+  t_double  begin_ms = (t_double)atom_getfloat(argv + 1);
+  t_double  end_ms   = (t_double)atom_getfloat(argv + 2);
+
+  if ((begin_ms < 0) || (end_ms < 0) || ((end_ms > 0) && (end_ms <= begin_ms))) {
+    MY_ERR("loop:  The loop region has to begin at 0 or more, and end after its beginning or at 0.");
+    return;
+  }
+
+  seeder->loop_begin_ms = begin_ms;
+  seeder->loop_end_ms   = end_ms;
+
+  granular_loop_update(x, seeder);
+}
+
+// ====  METHOD: GRANULAR_BOUNDARY  ====
+// Sets what the play position of a seeder does at the ends of its loop region. Called by boundary message.
+// Arguments: Int Symbol
+//   Arg 0:  Int    - Seeder index
+//   Arg 1:  Symbol - wrap, pingpong, clamp or stop
+
+void granular_boundary(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  TRACE("granular_boundary");
+
+  // Check the validity of the arguments
+  t_int16 index = granular_check_args(x, "boundary", argc, argv, 2);
+  if (index == ERR_ARG) { return; }
+
+  t_seeder* seeder   = x->seeders_arr + index;
+  t_symbol* mode_sym = atom_getsym(argv + 1);
+  t_int8    mode;
+
+  if      (mode_sym == gensym("wrap"))      { mode = BOUND_WRAP; }
+  else if (mode_sym == gensym("pingpong"))  { mode = BOUND_PINGPONG; }
+  else if (mode_sym == gensym("clamp"))     { mode = BOUND_CLAMP; }
+  else if (mode_sym == gensym("stop"))      { mode = BOUND_STOP; }
+  else {
+    MY_ERR("boundary:  Arg 1 (mode):  Has to be wrap, pingpong, clamp or stop. Was %s instead.", mode_sym->s_name);
+    return;
+  }
+
+  // The message side keeps the mode to build the loop copy, the audio thread gets it through the queue
+  seeder->bound_msg = mode;
+
+  // The loop copy is only used in wrap mode
+  granular_loop_update(x, seeder);
+  granular_param_push(x, index, PARAM_BOUND_MODE, mode);
+}
+
+// ====  PROCEDURE: GRANULAR_LOOP_UPDATE  ====
+// Calculate the loop region of a seeder in frames, and build or release its loop copy.
+// In wrap mode with a loop region set, the copy holds the loop region twice, plus one frame for interpolation,
+// so that grains starting anywhere in the region read across the loop point without being clamped.
+// The copy is published as a shared block that grains keep, and the region goes through the parameter queue.
+
+void granular_loop_update(t_granular* x, t_seeder* seeder) {
+
+  TRACE("granular_loop_update");
+
+  TL_BEGIN(tl_loop);
+
+  t_int32 begin = (t_int32)(seeder->loop_begin_ms * seeder->buff_msr);
+  t_int32 end   = ((seeder->loop_end_ms > 0) ? (t_int32)(seeder->loop_end_ms * seeder->buff_msr) : seeder->buff_n_frm);
+
+  if (end > seeder->buff_n_frm) { end = seeder->buff_n_frm; }
+  if (begin >= end) { begin = 0; end = seeder->buff_n_frm; }
+
+  t_buffer_obj*   buff_obj = buffer_ref_getobject(seeder->buff_ref);
+  t_int32         n_chn = seeder->buff_n_chn;
+  t_int32         len   = end - begin;
+  t_shared_block* loop  = NULL;
+  float*          buff_src = NULL;
+  float*          copy;
+
+  // No copy unless a loop region is set in wrap mode
+  if ((seeder->bound_msg == BOUND_WRAP) && (seeder->buff_state == BUFF_READY) && (buff_obj != NULL) && (n_chn > 0)
+    && ((seeder->loop_begin_ms != 0) || (seeder->loop_end_ms != 0)) && (len >= 2)) {
+
+    loop = granular_block_new(len, (2 * len + 1) * n_chn * sizeof(float));
+
+    if (loop == NULL) {
+      MY_ERR("loop:  Seeder %i:  Unable to allocate the loop copy. Grains are clamped to the loop region.", seeder->index);
+    }
+
+    buff_src = (loop ? buffer_locksamples(buff_obj) : NULL);
+    if (loop && (buff_src == NULL)) { sysmem_freeptr(loop); loop = NULL; }
+  }
+
+  if (loop != NULL) {
+
+    loop->n_chn  = (t_int16)n_chn;
+    loop->offset = begin;
+    copy = (float*)loop->data;
+
+    memcpy(copy, buff_src + begin * n_chn, len * n_chn * sizeof(float));
+    buffer_unlocksamples(buff_obj);
+
+    memcpy(copy + len * n_chn, copy, len * n_chn * sizeof(float));
+    memcpy(copy + 2 * len * n_chn, copy, n_chn * sizeof(float));
+  }
+
+  // Grains added from now on read the new copy, or none
+  if (!granular_block_publish(x, &seeder->loop, loop)) {
+    MY_ERR("loop:  Seeder %i:  Too many changes are waiting for their grains to end. Keeping the previous loop copy.", seeder->index);
+  }
+
+  granular_param_push(x, seeder->index, PARAM_LOOP_BEGIN, begin);
+  granular_param_push(x, seeder->index, PARAM_LOOP_END,   end);
+
+  TL_END(tl_loop, TL_MAIN, TL_LOOP, seeder->index);
+}
+
+// ====  PROCEDURE: GRANULAR_BOUND  ====
+// Apply the boundary mode of a seeder to its play position, and update the beginning of the next grain.
+// Only called by the thread that drains the parameter queue.
+// In all modes but wrap with a loop copy, the play position is kept so that grains end in the loop region.
+
+void granular_bound(t_seeder* seeder) {
+
+  t_int64 begin = (t_int64)seeder->loop_begin << POS_FRAC_BITS;
+  t_int64 end   = (t_int64)seeder->loop_end << POS_FRAC_BITS;
+  t_int64 last  = (t_int64)(seeder->loop_end - seeder->src_len) << POS_FRAC_BITS;
+  t_int64 pos   = seeder->src_pos;
+
+  if (last < begin) { last = begin; }
+
+  switch (seeder->bound_mode) {
+
+  case BOUND_WRAP:
+    if ((PTR_ACQUIRE(seeder->loop) != NULL) && (end > begin)) {
+      pos = (pos - begin) % (end - begin);
+      pos += ((pos < 0) ? end : begin);
+    }
+    else {
+      if (pos < begin) { pos = last; }
+      if (pos > last)  { pos = begin; }
+    }
+    break;
+
+  case BOUND_PINGPONG:
+    if (last == begin) { pos = begin; break; }
+    while ((pos < begin) || (pos > last)) {
+      if (pos > last) { pos = 2 * last - pos;  seeder->play_dir = -1; }
+      else            { pos = 2 * begin - pos; seeder->play_dir =  1; }
+    }
+    break;
+
+  case BOUND_CLAMP:
+    if (pos < begin) { pos = begin; }
+    if (pos > last)  { pos = last; }
+    break;
+
+  case BOUND_STOP:
+    if ((pos < begin) || (pos > last)) {
+      pos = ((pos < begin) ? begin : last);
+      seeder->play_dir = 0;
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  seeder->src_pos   = pos;
+  seeder->src_begin = (t_int32)(pos >> POS_FRAC_BITS);
+}
+
+// ====  METHOD: GRANULAR_GLISSON  ====
+// Sets the glisson mode of a seeder: the playback rate of each grain ramps from a start shift to an end shift.
+// Called by glisson message. The seeder adds regular grains when both shifts and the deviation are 0.
+// Arguments: Int Float Float [Float]
+//   Arg 0:  Int   - Seeder index
+//   Arg 1:  Float - Start shift in octaves, relative to the shift of the seeder
+//   Arg 2:  Float - End shift in octaves, relative to the shift of the seeder
+//   Arg 3:  Float - Optional: random deviation of each shift in octaves (default 0)
+
+void granular_glisson(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  TRACE("granular_glisson");
+
+  // Check the validity of the arguments
+  t_int16 index = granular_check_args(x, "glisson", argc, argv, ((argc == 4) ? 4 : 3));
+  if (index == ERR_ARG) { return; }
+
+  t_double  rand_v = ((argc == 4) ? (t_double)atom_getfloat(argv + 3) : 0);
+
+  if (rand_v < 0) {
+    MY_ERR("glisson:  Arg 3 (random deviation):  Has to be 0 or more.");
+    return;
+  }
+
+  granular_param_push(x, index, PARAM_GLIDE_BEGIN, (t_double)atom_getfloat(argv + 1));
+  granular_param_push(x, index, PARAM_GLIDE_END,   (t_double)atom_getfloat(argv + 2));
+  granular_param_push(x, index, PARAM_GLIDE_RAND,  rand_v);
+}
+
+// ====  METHOD: GRANULAR_SOURCE  ====
+// Sets where the grains of a seeder take their content from. Called by source message.
+// Oscillator grains are generated from a small single-cycle wavetable and never read the source buffer.
+// Arguments: Int Symbol [Symbol Float [Float] [Float]]
+//   Arg 0:  Int    - Seeder index
+//   Arg 1:  Symbol - buffer, wavetable, pulsar or ring
+//   Arg 2:  Float  - Ring: time in ms between the end of the grain windows and the write head
+//   Arg 2:  Symbol - Wavetable and pulsar: waveform: sine, triangle, saw, square or pulse
+//   Arg 3:  Float  - Wavetable and pulsar: frequency in Hz
+//   Arg 4:  Float  - Pulsar: duty cycle, from 0 (excluded) to 1
+//   Last:   Float  - Optional: random deviation of the frequency in octaves (default 0)
+
+void granular_source(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  TRACE("granular_source");
+
+  // Check the validity of the seeder index and mode
+  if ((argc < 2) || (atom_gettype(argv + 1) != A_SYM)) {
+    MY_ERR("source:  Invalid arguments. The method expects:");
+    MY_ERR2("  Arg 0:  Int - Seeder index");
+    MY_ERR2("  Arg 1:  Symbol - buffer, wavetable, pulsar or ring");
+    MY_ERR2("  Then:   Float - Ring: read-behind time in ms");
+    MY_ERR2("  Then:   Symbol Float [Float] [Float] - Waveform, frequency, pulsar duty cycle, frequency deviation");
+    return;
+  }
+
+  t_int16 index = granular_check_args(x, "source", 1, argv, 1);
+  if (index == ERR_ARG) { return; }
+
+  t_seeder* seeder   = x->seeders_arr + index;
+  t_symbol* mode_sym = atom_getsym(argv + 1);
+  t_int8    mode;
+  t_int16   argc_exp;
+
+  if      (mode_sym == gensym("buffer"))    { mode = SRC_MODE_BUFFER;    argc_exp = 2; }
+  else if (mode_sym == gensym("wavetable")) { mode = SRC_MODE_WAVETABLE; argc_exp = 4; }
+  else if (mode_sym == gensym("pulsar"))    { mode = SRC_MODE_PULSAR;    argc_exp = 5; }
+  else if (mode_sym == gensym("ring"))      { mode = SRC_MODE_RING;      argc_exp = 3; }
+  else {
+    MY_ERR("source:  Arg 1 (mode):  Has to be buffer, wavetable, pulsar or ring. Was %s instead.", mode_sym->s_name);
+    return;
+  }
+
+  if ((argc != argc_exp) && ((mode == SRC_MODE_BUFFER) || (mode == SRC_MODE_RING) || (argc != argc_exp + 1))) {
+    MY_ERR("source:  Invalid arguments. The %s mode expects %i or %i arguments.", mode_sym->s_name, argc_exp, argc_exp + 1);
+    return;
+  }
+
+  // Back to the source buffer: the seeder has to be turned off if the buffer is not ready
+  if (mode == SRC_MODE_BUFFER) {
+    if (seeder->on_msg && (seeder->buff_state != BUFF_READY)) {
+      MY_ERR("source:  Seeder %i:  The source buffer is not ready. Turn the seeder off first.", index);
+      return;
+    }
+    seeder->src_mode_msg = mode;
+    granular_param_push(x, index, PARAM_SRC_MODE, mode);
+    return;
+  }
+
+  // Record ring
+  if (mode == SRC_MODE_RING) {
+
+    t_double behind_ms = (t_double)atom_getfloat(argv + 2);
+
+    if (behind_ms < 0) {
+      MY_ERR("source:  Arg 2 (read-behind time):  Has to be 0 or more.");
+      return;
+    }
+
+    if (x->ring == NULL) { POST("source:  Seeder %i:  No record ring yet. Use the \"ring\" message to set one.", index); }
+
+    seeder->src_mode_msg = mode;
+    granular_param_push(x, index, PARAM_RING_BEHIND, behind_ms);
+    granular_param_push(x, index, PARAM_SRC_MODE,    mode);
+    return;
+  }
+
+  // Waveform
+  t_symbol*   wave_sym = atom_getsym(argv + 2);
+  t_wave_type wave;
+
+  if      (wave_sym == gensym("sine"))      { wave = WAVE_SINE; }
+  else if (wave_sym == gensym("triangle"))  { wave = WAVE_TRIANGLE; }
+  else if (wave_sym == gensym("saw"))       { wave = WAVE_SAW; }
+  else if (wave_sym == gensym("square"))    { wave = WAVE_SQUARE; }
+  else if (wave_sym == gensym("pulse"))     { wave = WAVE_PULSE; }
+  else {
+    MY_ERR("source:  Arg 2 (waveform):  Has to be sine, triangle, saw, square or pulse.");
+    return;
+  }
+
+  t_double freq      = (t_double)atom_getfloat(argv + 3);
+  t_double duty      = ((mode == SRC_MODE_PULSAR) ? (t_double)atom_getfloat(argv + 4) : 1);
+  t_double freq_rand = ((argc == argc_exp + 1) ? (t_double)atom_getfloat(argv + argc_exp) : 0);
+
+  if ((freq <= 0) || (duty <= 0) || (duty > 1) || (freq_rand < 0)) {
+    MY_ERR("source:  The frequency has to be more than 0, the duty cycle in ]0, 1] and the deviation 0 or more.");
+    return;
+  }
+
+  granular_param_push(x, index, PARAM_WAVE,      wave);
+  granular_param_push(x, index, PARAM_FREQ,      freq);
+  granular_param_push(x, index, PARAM_DUTY,      duty);
+  granular_param_push(x, index, PARAM_FREQ_RAND, freq_rand);
+  seeder->src_mode_msg = mode;
+  granular_param_push(x, index, PARAM_SRC_MODE,  mode);
+}
+
+// ====  METHOD: GRANULAR_RING  ====
+// Sets the record ring. Called by ring message.
+// The ring records the signal input plus the output scaled by the feedback gain, for seeders in ring source mode.
+// Grains only read what was recorded before they started, so the loop has a delay of at least one sub-block.
+// The ring has to be longer than the read-behind time plus the duration of the grains.
+// Arguments: Float Float
+//   Arg 0:  Float - Length of the ring in ms, 0 to release it
+//   Arg 1:  Float - Feedback gain of the output, from 0 to 0.99
+
+void granular_ring(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  TRACE("granular_ring");
+
+  if ((argc != 2) || (atom_gettype(argv) == A_SYM) || (atom_gettype(argv + 1) == A_SYM)) {
+    MY_ERR("ring:  Invalid arguments. The method expects:");
+    MY_ERR2("  Arg 0:  Float - Length of the ring in ms, 0 to release it");
+    MY_ERR2("  Arg 1:  Float - Feedback gain, from 0 to %.2f", RING_FB_MAX);
+    return;
+  }
+
+  t_double len_ms = (t_double)atom_getfloat(argv);
+  t_double fb     = (t_double)atom_getfloat(argv + 1);
+
+  if ((len_ms < 0) || (fb < 0) || (fb > RING_FB_MAX)) {
+    MY_ERR("ring:  The length has to be 0 or more, and the feedback gain from 0 to %.2f.", RING_FB_MAX);
+    return;
+  }
+
+  x->ring_fb = fb;
+
+  // Only the feedback gain changes
+  if (len_ms == x->ring_len_ms) { return; }
+
+  x->ring_len_ms = len_ms;
+  granular_ring_alloc(x);
+}
+
+// ====  PROCEDURE: GRANULAR_RING_ALLOC  ====
+// Publish a cleared record ring for the current length and samplerate, or none, and retire the previous one.
+// Grains reading the previous ring finish with it, the audio thread records into the new one from its beginning.
+
+void granular_ring_alloc(t_granular* x) {
+
+  TRACE("granular_ring_alloc");
+
+  t_int32         len  = (t_int32)(x->ring_len_ms * x->msamplerate);
+  t_shared_block* ring = NULL;
+
+  // Twice the length, plus one frame as a guard for interpolation
+  if (len >= 2) {
+
+    ring = granular_block_new(len, (2 * len + 1) * sizeof(float));
+
+    if (ring == NULL) { MY_ERR("ring:  Unable to allocate a record ring of %i frames.", len); }
+    else { memset(ring->data, 0, (2 * len + 1) * sizeof(float)); }
+  }
+
+  if (!granular_block_publish(x, &x->ring, ring)) {
+    MY_ERR("ring:  Too many changes are waiting for their grains to end. Keeping the previous ring.");
+    return;
+  }
+
+  x->ring_len = (ring ? len : 0);
+}
+
+// ====  PROCEDURE: GRANULAR_RING_WRITE  ====
+// Record one sub-block of the signal input plus the output scaled by the feedback gain, called by granular_perform64.
+// Each frame is written twice, so that windows starting in the first half can be read without wrapping.
+// The recorded values are folded back into [-1, 1] like the output.
+
+void granular_ring_write(t_granular* x, t_double* in, t_double* out, t_int32 n) {
+
+  t_shared_block* block = PTR_ACQUIRE(x->ring);
+
+  if (block == NULL) { x->ring_rec = NULL; return; }
+
+  // A new ring is recorded from its beginning
+  if ((block != x->ring_rec) || (x->ring_w >= block->n_frm)) {
+    x->ring_rec = block;
+    x->ring_w   = 0;
+  }
+
+  float*   ring = (float*)block->data;
+  t_int32  len  = block->n_frm;
+  t_int32  w    = x->ring_w;
+  t_double fb   = x->ring_fb;
+  t_double smp;
+
+  while (n--) {
+
+    smp = *in++ + fb * *out++;
+    if (smp > 1)  { smp = 2 - smp; }
+    if (smp < -1) { smp = -2 - smp; }
+
+    ring[w] = ring[w + len] = (float)smp;
+    if (w == 0) { ring[2 * len] = (float)smp; }
+
+    if (++w == len) { w = 0; }
+  }
+
+  x->ring_w = w;
+}
+
+// ====  METHOD: GRANULAR_RENDER  ====
+// Renders the engine offline into a buffer, as fast as possible, and posts the realtime factor.
+// Called by render message. Only available while the DSP is off, as the render advances the live engine state.
+// The samplerate and vector size are the ones of the last DSP run. The record ring receives a silent input.
+// With "score", the messages of a score file are sent to the object at their time in the render, see granular_score_load.
+// Parameter changes take effect at the exact frame: the render blocks end at the time of each message.
+// Arguments: Symbol Float [Symbol Symbol]
+//   Arg 0:  Symbol - Name of the buffer to render into, resized to the duration
+//   Arg 1:  Float  - Duration in ms
+//   Arg 2:  Symbol - Optional, "score"
+//   Arg 3:  Symbol - Absolute path of the score file
+
+void granular_render(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  TRACE("granular_render");
+
+  if (((argc != 2) && (argc != 4)) || (atom_gettype(argv) != A_SYM) || (atom_gettype(argv + 1) == A_SYM)
+    || ((argc == 4) && ((atom_getsym(argv + 2) != gensym("score")) || (atom_gettype(argv + 3) != A_SYM)))) {
+    MY_ERR("render:  Invalid arguments. The method expects:");
+    MY_ERR2("  Arg 0:  Symbol - Name of the buffer to render into");
+    MY_ERR2("  Arg 1:  Float - Duration in ms");
+    MY_ERR2("  Arg 2:  Symbol - Optional, \"score\"");
+    MY_ERR2("  Arg 3:  Symbol - Path of the score file");
+    outlet_bang(x->outl_compl); return;
+  }
+
+  if (sys_getdspobjdspstate((t_object*)x)) {
+    MY_ERR("render:  Only available while the DSP is off.");
+    outlet_bang(x->outl_compl); return;
+  }
+
+  if (x->vector_max == 0) {
+    MY_ERR("render:  Turn the DSP on once first, to set the samplerate and vector size.");
+    outlet_bang(x->outl_compl); return;
+  }
+
+  t_symbol* buff_sym = atom_getsym(argv);
+  t_int32   n_frm    = (t_int32)(atom_getfloat(argv + 1) * x->msamplerate);
+
+  if (n_frm <= 0) {
+    MY_ERR("render:  Arg 1 (duration):  Has to be more than 0.");
+    outlet_bang(x->outl_compl); return;
+  }
+
+  // Link to the buffer and set its size
+  t_buffer_ref* buff_ref = buffer_ref_new((t_object*)x, buff_sym);
+  t_buffer_obj* buff_obj = buffer_ref_getobject(buff_ref);
+
+  if (buff_obj == NULL) {
+    MY_ERR("render:  Unable to link to buffer \"%s\".", buff_sym->s_name);
+    object_free(buff_ref); outlet_bang(x->outl_compl); return;
+  }
+
+  if (object_method_long(buff_obj, gensym("sizeinsamps"), n_frm, NULL) != MAX_ERR_NONE) {
+    MY_ERR("render:  Unable to set the size of buffer \"%s\".", buff_sym->s_name);
+    object_free(buff_ref); outlet_bang(x->outl_compl); return;
+  }
+
+  t_int32 n_chn = (t_int32)buffer_getchannelcount(buff_obj);
+  float*  buff_out = buffer_locksamples(buff_obj);
+
+  if ((buff_out == NULL) || (n_chn == 0) || ((t_int32)buffer_getframecount(buff_obj) < n_frm)) {
+    if (buff_out) { buffer_unlocksamples(buff_obj); }
+    MY_ERR("render:  Unable to access buffer \"%s\".", buff_sym->s_name);
+    object_free(buff_ref); outlet_bang(x->outl_compl); return;
+  }
+
+  // Render in sub-blocks no longer than the vector size, that the oversampled buses are allocated for
+  t_int32  block_len = ((x->vector_max < SUBBLOCK_LEN) ? x->vector_max : SUBBLOCK_LEN);
+  t_double block[SUBBLOCK_LEN];
+  t_double silence[SUBBLOCK_LEN];
+  t_double smp;
+  t_int32  n;
+
+  for (t_int32 i = 0; i < SUBBLOCK_LEN; i++) { silence[i] = 0; }
+
+  // Read the score, with the times of the messages in frames
+  t_score_event* score = NULL;
+  t_int32        score_cnt = 0;
+  t_int32        ev = 0;
+
+  if (argc == 4) {
+
+    score_cnt = granular_score_load(x, atom_getsym(argv + 3), &score);
+
+    if (score_cnt < 0) {
+      buffer_unlocksamples(buff_obj);
+      object_free(buff_ref); outlet_bang(x->outl_compl); return;
+    }
+  }
+
+  // Own the engine for the whole render, in case the DSP is turned on meanwhile.
+  // The parameter changes of the score are queued, and drained before each block.
+  if (!granular_engine_acquire(x)) {
+    MY_ERR("render:  The engine is busy. Try again.");
+    granular_score_free(score, score_cnt);
+    buffer_unlocksamples(buff_obj);
+    object_free(buff_ref); outlet_bang(x->outl_compl); return;
+  }
+
+  t_double time_begin = systimer_gettime();
+
+  TL_BEGIN(tl_render);
+
+  for (t_int32 frm = 0; frm < n_frm; frm += n) {
+
+    n = ((n_frm - frm < block_len) ? (n_frm - frm) : block_len);
+
+    // Send the messages of the score due at this frame, and end the block at the next one
+    while ((ev < score_cnt) && (score[ev].frm <= frm)) {
+      object_method_typed(x, score[ev].sym, score[ev].argc, score[ev].argv, NULL);
+      ev++;
+    }
+
+    if ((ev < score_cnt) && (score[ev].frm - frm < n)) { n = score[ev].frm - frm; }
+
+    granular_param_drain(x);
+    granular_perform_block(x, block, n);
+    granular_ring_write(x, silence, block, n);
+
+    // Fold back the values out of bounds like the outlet, and write the first channel
+    for (t_int32 i = 0; i < n; i++) {
+      smp = block[i];
+      if (smp > 1)  { smp = 2 - smp; }
+      if (smp < -1) { smp = -2 - smp; }
+      buff_out[(frm + i) * n_chn] = (float)smp;
+    }
+  }
+
+  TL_END(tl_render, TL_MAIN, TL_RENDER, -1);
+
+  if (ATOMIC_LOAD(x->load_on)) { granular_load_publish(x); }
+  granular_engine_release(x);
+
+  if (score_cnt > 0) { POST("render:  %i of the %i messages of the score sent.", ev, score_cnt); }
+  granular_score_free(score, score_cnt);
+
+  t_double time_ms = systimer_gettime() - time_begin;
+
+  buffer_unlocksamples(buff_obj);
+  buffer_setdirty(buff_obj);
+  object_free(buff_ref);
+
+  POST("render:  %.0f ms rendered into \"%s\" in %.1f ms - Realtime factor: %.1f", n_frm / x->msamplerate,
+    buff_sym->s_name, time_ms, ((time_ms > 0) ? n_frm / x->msamplerate / time_ms : 0));
+
+  outlet_bang(x->outl_compl);
+}
+
+// ====  PROCEDURE: GRANULAR_SCORE_LOAD  ====
+// Read a render score: a text file with one message per line, preceded by its time in ms, like the text of a coll:
+//   <time>, <message> <arguments>;
+// Commas and semicolons are optional, empty lines and lines starting with # are skipped. Any message of the object
+// can be used but render, soak and bench. The events are sorted by time, keeping the order of the lines.
+// RETURNS: The number of events, or -1 if the score cannot be read. The array has to be freed with granular_score_free.
+
+static int granular_score_cmp(const void* a, const void* b) {
+
+  const t_score_event* ev_a = (const t_score_event*)a;
+  const t_score_event* ev_b = (const t_score_event*)b;
+
+  if (ev_a->frm != ev_b->frm) { return ((ev_a->frm < ev_b->frm) ? -1 : 1); }
+  return ((ev_a->line < ev_b->line) ? -1 : (ev_a->line > ev_b->line));
+}
+
+t_int32 granular_score_load(t_granular* x, t_symbol* path, t_score_event** score) {
+
+  TRACE("granular_score_load");
+
+  char path_native[MAX_PATH_CHARS];
+  path_nameconform(path->s_name, path_native, PATH_STYLE_NATIVE, PATH_TYPE_BOOT);
+
+  FILE* file = fopen(path_native, "r");
+
+  if (file == NULL) {
+    MY_ERR("render:  Unable to read the score \"%s\".", path_native);
+    return -1;
+  }
+
+  char           line[SCORE_LINE_MAX];
+  t_int32        line_n = 0;
+  t_int32        cnt = 0;
+  t_int32        cap = 0;
+  t_score_event* events = NULL;
+  t_score_event* ev;
+  long           ac;
+  t_atom*        av;
+  t_symbol*      msg;
+  t_bool         ok = true;
+
+  while (ok && fgets(line, SCORE_LINE_MAX, file)) {
+
+    line_n++;
+
+    for (char* c = line; *c; c++) { if ((*c == ',') || (*c == ';') || (*c == '\n') || (*c == '\r')) { *c = ' '; } }
+
+    char* start = line;
+    while ((*start == ' ') || (*start == '\t')) { start++; }
+    if ((*start == 0) || (*start == '#')) { continue; }
+
+    ac = 0;
+    av = NULL;
+    atom_setparse(&ac, &av, start);
+
+    msg = (((ac >= 2) && (atom_gettype(av + 1) == A_SYM)) ? atom_getsym(av + 1) : NULL);
+
+    if ((msg == NULL) || (atom_gettype(av) == A_SYM) || (atom_getfloat(av) < 0)
+      || (msg == gensym("render")) || (msg == gensym("soak")) || (msg == gensym("bench"))) {
+      MY_ERR("render:  Score line %i:  Has to be a time of 0 or more in ms, then a message but render, soak or bench.", line_n);
+      if (av) { sysmem_freeptr(av); }
+      ok = false;
+      break;
+    }
+
+    // Grow the array by doubling
+    if (cnt == cap) {
+      cap = (cap ? 2 * cap : 64);
+      ev = (t_score_event*)(events ? sysmem_resizeptr(events, cap * sizeof(t_score_event)) : sysmem_newptr(cap * sizeof(t_score_event)));
+      if (ev == NULL) {
+        MY_ERR("render:  Unable to allocate the score.");
+        sysmem_freeptr(av);
+        ok = false;
+        break;
+      }
+      events = ev;
+    }
+
+    ev = events + cnt++;
+    ev->frm  = (t_int32)(atom_getfloat(av) * x->msamplerate + 0.5);
+    ev->line = line_n;
+    ev->sym  = msg;
+    ev->argc = ac - 2;
+    ev->argv = av + 2;
+    ev->atoms = av;
+  }
+
+  fclose(file);
+
+  if (!ok) {
+    granular_score_free(events, cnt);
+    return -1;
+  }
+
+  qsort(events, cnt, sizeof(t_score_event), granular_score_cmp);
+
+  *score = events;
+  return cnt;
+}
+
+// ====  PROCEDURE: GRANULAR_SCORE_FREE  ====
+
+void granular_score_free(t_score_event* score, t_int32 cnt) {
+
+  if (score == NULL) { return; }
+
+  for (t_int32 i = 0; i < cnt; i++) { sysmem_freeptr(score[i].atoms); }
+  sysmem_freeptr(score);
+}
+
+// ====  METHOD: GRANULAR_SOAK  ====
+// Runs the engine offline for a long simulated time, as fast as possible, with random parameter changes
+// every SOAK_CHANGE_MS and random envelope, source and loop changes every SOAK_SOURCE_MS, on the seeders that are on.
+// Checks after each vector cycle that:
+//   - the number of grains stays within grains_max and matches the grain list
+//   - the begin of each seeder reading a buffer stays within the buffer
+//   - the play position of each seeder reading a buffer matches its speed integrated since the last reset,
+//     within the rounding of the fixed-point steps: see granular_soak_drift
+//   - the output stays finite and within the range folded back by the outlet
+//   - the retired envelope tables, source handles and shared blocks are freed, so that the memory use stays flat
+//   - the render time of the vector cycle stays within the budget
+// Renders in slices of SOAK_SLICE_MS from a queue element, so the message thread keeps running and the hourly
+// reports are posted as they happen. The changes use a private random generator, and the seeders are restored
+// to their state before the run at the end. Changes sent to the object during the run are applied between
+// two vector cycles, and may be reported as drift.
+// Posts a summary at the end, then outputs "soak 1" if all checks passed, "soak 0" otherwise.
+// Only available while the DSP is off, and stopped if the DSP is turned on.
+// Arguments: Float [Int [Float]] or "stop"
+//   Arg 0:  Float - Simulated duration in s, or "stop" to end the run in progress
+//   Arg 1:  Int   - Optional, seed of the random changes, for reproducible runs, 1 by default
+//   Arg 2:  Float - Optional, budget of the render time as a fraction of the vector duration, 1 by default
+
+void granular_soak(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+
+  TRACE("granular_soak");
+
+  if ((argc == 1) && (atom_gettype(argv) == A_SYM) && (atom_getsym(argv) == gensym("stop"))) {
+    if (x->soak == NULL) { MY_ERR("soak:  No run in progress."); return; }
+    POST("soak:  Stopped after %.1f h simulated.", x->soak->vec * x->soak->vec_ms / 3600000);
+    granular_soak_end(x);
+    return;
+  }
+
+  if ((argc < 1) || (argc > 3) || (atom_gettype(argv) == A_SYM) || ((argc > 1) && (atom_gettype(argv + 1) == A_SYM))
+    || ((argc > 2) && (atom_gettype(argv + 2) == A_SYM))) {
+    MY_ERR("soak:  Invalid arguments. The method expects:");
+    MY_ERR2("  Arg 0:  Float - Simulated duration in s, or \"stop\"");
+    MY_ERR2("  Arg 1:  Int - Optional, seed of the random changes");
+    MY_ERR2("  Arg 2:  Float - Optional, budget of the render time as a fraction of the vector duration");
+    outlet_bang(x->outl_compl); return;
+  }
+
+  if (x->soak != NULL) {
+    MY_ERR("soak:  A run is in progress. Use \"soak stop\" to end it.");
+    outlet_bang(x->outl_compl); return;
+  }
+
+  if (sys_getdspobjdspstate((t_object*)x)) {
+    MY_ERR("soak:  Only available while the DSP is off.");
+    outlet_bang(x->outl_compl); return;
+  }
+
+  if (x->vector_max == 0) {
+    MY_ERR("soak:  Turn the DSP on once first, to set the samplerate and vector size.");
+    outlet_bang(x->outl_compl); return;
+  }
+
+  t_double  dur_ms = 1000 * (t_double)atom_getfloat(argv);
+  t_double  budget = ((argc > 2) ? (t_double)atom_getfloat(argv + 2) : 1);
+  t_int32   vec_len = x->vector_max;
+  t_double  vec_ms  = vec_len / x->msamplerate;
+  t_int64   n_vec   = (t_int64)(dur_ms / vec_ms);
+
+  if ((n_vec <= 0) || (budget <= 0)) {
+    MY_ERR("soak:  The duration and the budget have to be more than 0.");
+    outlet_bang(x->outl_compl); return;
+  }
+
+  // The state with the seeder snapshots following it in the same block, and the vector buffers on the heap,
+  // the vector size can be large
+  t_soak*   soak = (t_soak*)sysmem_newptr(sizeof(t_soak) + x->seeders_max * sizeof(t_soak_seeder));
+  t_double* out  = (t_double*)sysmem_newptr(2 * vec_len * sizeof(t_double));
+
+  if ((soak == NULL) || (out == NULL)) {
+    MY_ERR("soak:  Unable to allocate the run state.");
+    if (soak) { sysmem_freeptr(soak); }
+    if (out) { sysmem_freeptr(out); }
+    outlet_bang(x->outl_compl); return;
+  }
+
+  // Own the engine for the whole run: the changes pushed meanwhile are queued and drained before each sub-block
+  if (!granular_engine_acquire(x)) {
+    MY_ERR("soak:  The engine is busy. Try again.");
+    sysmem_freeptr(soak); sysmem_freeptr(out);
+    outlet_bang(x->outl_compl); return;
+  }
+
+  soak->rand       = (t_uint32)((argc > 1) ? atom_getlong(argv + 1) : 1);
+  if (soak->rand == 0) { soak->rand = 1; }
+
+  soak->n_vec      = n_vec;
+  soak->vec        = 0;
+  soak->vec_len    = vec_len;
+  soak->vec_ms     = vec_ms;
+  soak->budget     = budget;
+  soak->change_vec = (t_int64)(SOAK_CHANGE_MS / vec_ms) + 1;
+  soak->source_vec = (t_int64)(SOAK_SOURCE_MS / vec_ms) + 1;
+  soak->report_vec = (t_int64)(SOAK_REPORT_MS / vec_ms) + 1;
+  soak->out        = out;
+  soak->in         = out + vec_len;
+
+  soak->err_grains = 0;
+  soak->err_begin  = 0;
+  soak->err_drift  = 0;
+  soak->err_out    = 0;
+  soak->err_mem    = 0;
+  soak->grains_hwm  = 0;
+  soak->retired_hwm = 0;
+  soak->drift_max  = 0;
+  soak->ticks_max  = 0;
+  soak->ticks_sum  = 0;
+  soak->n_over     = 0;
+  soak->time_ms    = 0;
+
+  // Measure the tick rate against the system timer, to check each vector cycle against the budget
+  t_double time_begin = systimer_gettime();
+  t_uint64 ticks_begin = CYCLE_COUNT();
+  t_double time_calib;
+  do { time_calib = systimer_gettime() - time_begin; } while (time_calib < SOAK_CALIB_MS);
+  soak->ticks_budget = (t_uint64)((CYCLE_COUNT() - ticks_begin) / time_calib * budget * vec_ms);
+  soak->seeders    = (t_soak_seeder*)(soak + 1);
+
+  for (t_int32 i = 0; i < vec_len; i++) { soak->in[i] = 0; }
+
+  // Snapshot the seeders, to restore them at the end
+  t_seeder*      seeder;
+  t_soak_seeder* snap;
+
+  for (t_int16 index = 0; index < x->seeders_max; index++) {
+
+    seeder = x->seeders_arr + index;
+    snap   = soak->seeders + index;
+
+    snap->ampl          = seeder->ampl;
+    snap->src_begin     = seeder->src_begin;
+    snap->src_len_ms    = seeder->src_len_ms;
+    snap->shift         = seeder->shift;
+    snap->period        = seeder->period;
+    snap->speed         = seeder->speed;
+    snap->poly_cnt      = seeder->poly_cnt;
+    snap->period_rand   = seeder->period_rand;
+    snap->src_pos       = seeder->src_pos;
+    snap->play_dir      = seeder->play_dir;
+    snap->env_sym       = seeder->env_sym;
+    snap->loop_begin_ms = seeder->loop_begin_ms;
+    snap->loop_end_ms   = seeder->loop_end_ms;
+    snap->ref_ok        = false;
+  }
+
+  x->soak = soak;
+
+  POST("soak:  %.1f h to simulate - Vector: %.2f ms. Use \"soak stop\" to end the run.", n_vec * vec_ms / 3600000, vec_ms);
+
+  qelem_set(x->soak_qelem);
+}
+
+// ====  PROCEDURE: GRANULAR_SOAK_SLICE  ====
+// Queue element of the soak run: renders vector cycles for SOAK_SLICE_MS, then sets itself again until the
+// simulated duration is reached.
+
+void granular_soak_slice(t_granular* x) {
+
+  t_soak* soak = x->soak;
+
+  if (soak == NULL) { return; }
+
+  if (sys_getdspobjdspstate((t_object*)x)) {
+    MY_ERR("soak:  The DSP was turned on. Stopping the run after %.1f h simulated.", soak->vec * soak->vec_ms / 3600000);
+    granular_soak_end(x);
+    return;
+  }
+
+  t_double time_begin = systimer_gettime();
+  t_double time_now   = time_begin;
+
+  while ((soak->vec < soak->n_vec) && (time_now - time_begin < SOAK_SLICE_MS)) {
+    granular_soak_vector(x, soak);
+    soak->vec++;
+    time_now = systimer_gettime();
+  }
+
+  soak->time_ms += time_now - time_begin;
+
+  if (soak->vec == soak->n_vec) { granular_soak_end(x); }
+  else { qelem_set(x->soak_qelem); }
+}
+
+// ====  PROCEDURE: GRANULAR_SOAK_VECTOR  ====
+// One vector cycle of the soak run: the random changes that are due, the render and the checks
+
+void granular_soak_vector(t_granular* x, t_soak* soak) {
+
+  t_int64   vec = soak->vec;
+  t_int32   vec_len = soak->vec_len;
+  t_double* out = soak->out;
+  t_uint64  ticks, ticks_vec;
+  t_double  smp;
+  t_int32   n;
+  t_int16   retired;
+  t_seeder* seeder;
+
+  //== Random changes, applied from the message thread paths as they would be from the patch
+  if (vec % soak->change_vec == 0) { granular_soak_change(x, soak, (vec % soak->source_vec == 0)); }
+
+  //== Render one vector cycle like the perform routine, without the outlets
+  ticks = CYCLE_COUNT();
+
+  for (t_int32 offset = 0; offset < vec_len; offset += SUBBLOCK_LEN) {
+    n = ((vec_len - offset < SUBBLOCK_LEN) ? (vec_len - offset) : SUBBLOCK_LEN);
+    granular_param_drain(x);
+    granular_perform_block(x, out + offset, n);
+    granular_ring_write(x, soak->in + offset, out + offset, n);
+  }
+
+  ATOMIC_INCREMENT_BARRIER(&x->epoch);
+
+  ticks_vec = CYCLE_COUNT() - ticks;
+  soak->ticks_sum += ticks_vec;
+  if (ticks_vec > soak->ticks_max) { soak->ticks_max = ticks_vec; }
+  if (soak->ticks_budget && (ticks_vec > soak->ticks_budget)) { soak->n_over++; }
+
+  //== Check the grains, against the length of the grain list
+  t_int16  n_node = 0;
+  t_int16* node = x->grains_list->first_used;
+  while ((*node != LIST_END) && (n_node <= x->grains_max)) { n_node++; node = x->grains_list->array + *node; }
+
+  if ((x->grains_cnt < 0) || (x->grains_cnt > x->grains_max) || (x->grains_cnt != n_node)) { soak->err_grains++; }
+  if (x->grains_cnt > soak->grains_hwm) { soak->grains_hwm = x->grains_cnt; }
+
+  //== Check the output, before it is folded back
+  for (t_int32 i = 0; i < vec_len; i++) {
+    smp = out[i];
+    if ((smp != smp) || (smp > 3) || (smp < -3)) { soak->err_out++; break; }
+  }
+
+  //== Check the positions of the seeders reading their buffer
+  for (t_int16 index = 0; index < x->seeders_max; index++) {
+
+    seeder = x->seeders_arr + index;
+
+    if (!seeder->is_on || (seeder->src_mode != SRC_MODE_BUFFER) || (seeder->buff_state != BUFF_READY)) {
+      soak->seeders[index].ref_ok = false;
+      continue;
+    }
+
+    if ((seeder->src_begin < 0) || (seeder->src_begin > seeder->buff_n_frm)) { soak->err_begin++; }
+    granular_soak_drift(x, soak, seeder);
+  }
+
+  //== Check that the retired tables and handles are freed once no grain reads them
+  if (vec % soak->change_vec == soak->change_vec - 1) {
+    granular_env_reclaim(x, false);
+    granular_src_reclaim(x, false);
+    granular_block_reclaim(x, false);
+    retired = x->env_retired_cnt + x->src_retired_cnt + x->blk_retired_cnt;
+    if (retired > soak->retired_hwm) { soak->retired_hwm = retired; }
+    if ((x->env_retired_cnt == ENV_RETIRED_MAX) || (x->src_retired_cnt == SRC_RETIRED_MAX) || (x->blk_retired_cnt == BLK_RETIRED_MAX)) {
+      soak->err_mem++;
+    }
+  }
+
+  //== Progress report
+  if (vec % soak->report_vec == soak->report_vec - 1) {
+    POST("soak:  %.1f h simulated - Grains: %i (max %i) - Retired: %i - Drift: %.3f frames at most"
+      " - Errors: grains %lli, begin %lli, drift %lli, output %lli, memory %lli",
+      (vec + 1) * soak->vec_ms / 3600000, x->grains_cnt, soak->grains_hwm,
+      x->env_retired_cnt + x->src_retired_cnt + x->blk_retired_cnt, soak->drift_max,
+      (long long)soak->err_grains, (long long)soak->err_begin, (long long)soak->err_drift,
+      (long long)soak->err_out, (long long)soak->err_mem);
+  }
+}
+
+// ====  PROCEDURE: GRANULAR_SOAK_DRIFT  ====
+// Compare the play position of a seeder with its speed integrated since the last reset of its reference.
+// Each grain period moves the position by the speed times the period, truncated to the fixed-point step, and the
+// periods added since the reset sum to the frames rendered plus the change of the period countdown. So the
+// position has to stay within one frame, plus the truncation of each step, of the exact integration.
+// The reference is reset when the seeder is changed, when its speed, direction, length or loop region change,
+// and when the position may have reached the loop boundaries, where the boundary mode moves it.
+
+void granular_soak_drift(t_granular* x, t_soak* soak, t_seeder* seeder) {
+
+  t_soak_seeder* ref = soak->seeders + seeder->index;
+  t_double       unit = (t_double)(1 << POS_FRAC_BITS);
+
+  if (ref->ref_ok && (ref->ref_speed == seeder->speed) && (ref->ref_dir == seeder->play_dir) && (ref->ref_msr == seeder->buff_msr)
+    && (ref->ref_len == seeder->src_len) && (ref->ref_loop_begin == seeder->loop_begin) && (ref->ref_loop_end == seeder->loop_end)) {
+
+    ref->ref_frm += soak->vec_len;
+
+    t_double frm      = (t_double)(ref->ref_frm + seeder->period_cntd[0] - ref->ref_cntd);
+    t_double step     = seeder->play_dir * seeder->speed * seeder->buff_msr / x->msamplerate;
+    t_double expected = ref->ref_pos / unit + step * frm;
+    t_double last     = (t_double)(seeder->loop_end - seeder->src_len);
+    t_double period   = seeder->period_len * (1 - seeder->period_rand);
+    t_double tol      = SOAK_DRIFT_FRM + frm / ((period > 1) ? period : 1) / unit;
+
+    // Away from the boundaries the position moved in a straight line since the reset
+    if ((expected > seeder->loop_begin + tol) && (expected < last - tol)) {
+
+      t_double drift = seeder->src_pos / unit - expected;
+      if (drift < 0) { drift = -drift; }
+
+      if (drift > soak->drift_max) { soak->drift_max = drift; }
+      if (drift <= tol) { return; }
+
+      soak->err_drift++;
+    }
+  }
+
+  ref->ref_ok         = true;
+  ref->ref_pos        = seeder->src_pos;
+  ref->ref_cntd       = seeder->period_cntd[0];
+  ref->ref_frm        = 0;
+  ref->ref_speed      = seeder->speed;
+  ref->ref_dir        = seeder->play_dir;
+  ref->ref_msr        = seeder->buff_msr;
+  ref->ref_len        = seeder->src_len;
+  ref->ref_loop_begin = seeder->loop_begin;
+  ref->ref_loop_end   = seeder->loop_end;
+}
+
+// ====  PROCEDURE: GRANULAR_SOAK_END  ====
+// End the soak run: post the summary, restore the seeders to their state before the run, release the engine
+// and output the result. Also called when the run is stopped.
+
+void granular_soak_end(t_granular* x) {
+
+  t_soak* soak = x->soak;
+
+  if (soak == NULL) { return; }
+
+  // Convert the worst render time with the tick rate measured over the run
+  t_double ms_per_tick = ((soak->ticks_sum > 0) ? soak->time_ms / soak->ticks_sum : 0);
+  t_double worst_ms = soak->ticks_max * ms_per_tick;
+  t_double vec_ms = soak->vec_ms;
+  t_int64  n_over = soak->n_over;
+
+  t_bool passed = ((soak->err_grains + soak->err_begin + soak->err_drift + soak->err_out + soak->err_mem + n_over) == 0);
+
+  POST("soak:  %.1f h simulated in %.1f s - Realtime factor: %.0f - Vector: %.2f ms - Worst render: %.3f ms (%.0f%% of the vector)",
+    soak->vec * vec_ms / 3600000, soak->time_ms / 1000, ((soak->time_ms > 0) ? soak->vec * vec_ms / soak->time_ms : 0), vec_ms,
+    worst_ms, 100 * worst_ms / vec_ms);
+  POST("soak:  Grains at most %i of %i - Retired tables and blocks at most %i - Drift at most %.3f frames",
+    soak->grains_hwm, x->grains_max, soak->retired_hwm, soak->drift_max);
+
+  if (ms_per_tick == 0) { POST("soak:  No tick counter on this platform, the render time was not checked."); }
+
+  if (passed) { POST("soak:  PASSED"); }
+  else {
+    MY_ERR("soak:  FAILED - Errors: grains %lli, begin %lli, drift %lli, output %lli, memory %lli, budget %lli",
+      (long long)soak->err_grains, (long long)soak->err_begin, (long long)soak->err_drift, (long long)soak->err_out,
+      (long long)soak->err_mem, (long long)n_over);
+  }
+
+  // Restore the seeders, still owning the engine: the parameters directly, the envelope and loop region
+  // through their methods, and the loop pushes drained before the release
+  t_seeder*      seeder;
+  t_soak_seeder* snap;
+  t_atom         argv[2];
+
+  granular_param_drain(x);
+
+  for (t_int16 index = 0; index < x->seeders_max; index++) {
+
+    seeder = x->seeders_arr + index;
+    snap   = soak->seeders + index;
+
+    granular_param_apply(x, index, PARAM_AMPL,        snap->ampl);
+    granular_param_apply(x, index, PARAM_LENGTH,      snap->src_len_ms);
+    seeder->src_len_ms = snap->src_len_ms;
+    granular_param_apply(x, index, PARAM_SHIFT,       snap->shift);
+    granular_param_apply(x, index, PARAM_PERIOD,      snap->period);
+    granular_param_apply(x, index, PARAM_SPEED,       snap->speed);
+    granular_param_apply(x, index, PARAM_PERIOD_RAND, snap->period_rand);
+    if (seeder->poly_cnt != snap->poly_cnt) { granular_param_apply(x, index, PARAM_POLY, snap->poly_cnt); }
+
+    seeder->src_begin = snap->src_begin;
+    seeder->src_pos   = snap->src_pos;
+    seeder->play_dir  = snap->play_dir;
+
+    if ((seeder->env_sym != snap->env_sym) && (snap->env_sym != NULL)) {
+      atom_setlong(argv, index);
+      atom_setsym (argv + 1, snap->env_sym);
+      granular_envelope(x, gensym("envelope"), 2, argv);
+    }
+
+    if ((seeder->loop_begin_ms != snap->loop_begin_ms) || (seeder->loop_end_ms != snap->loop_end_ms)) {
+      seeder->loop_begin_ms = snap->loop_begin_ms;
+      seeder->loop_end_ms   = snap->loop_end_ms;
+      granular_loop_update(x, seeder);
+    }
+  }
+
+  granular_param_drain(x);
+  if (ATOMIC_LOAD(x->load_on)) { granular_load_publish(x); }
+  granular_engine_release(x);
+
+  granular_soak_free(x);
+
+  t_atom result;
+  atom_setlong(&result, passed);
+  outlet_anything(x->outl_mess, gensym("soak"), 1, &result);
+  outlet_bang(x->outl_compl);
+}
 
-void granular_period_rand(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+// ====  PROCEDURE: GRANULAR_SOAK_FREE  ====
 
-  //TRACE("granular_period_rand");
+void granular_soak_free(t_granular* x) {
 
-  t_int16 index = (t_int16)atom_getlong(argv);
+  if (x->soak == NULL) { return; }
 
-  x->seeders_arr[index].period_rand = (t_double)atom_getfloat(argv + 1);
+  sysmem_freeptr(x->soak->out);
+  sysmem_freeptr(x->soak);
+  x->soak = NULL;
 }
 
-// ====  METHOD: GRANULAR_BUFFER  ====
+// ====  PROCEDURE: GRANULAR_SOAK_RAND  ====
+// Private random generator of the soak changes (xorshift32), so that the run neither reseeds nor draws from rand()
+// RETURNS: A random integer from 0 to SOAK_RAND_MAX
 
-void granular_buffer(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+t_uint32 granular_soak_rand(t_soak* soak) {
 
-  TRACE("granular_buffer");
+  t_uint32 r = soak->rand;
 
-  //====== Check the number of arguments
-  if (argc == 2) {
+  r ^= r << 13;
+  r ^= r >> 17;
+  r ^= r << 5;
+  soak->rand = r;
 
-    //==== If the first atom is a symbol it has to be "env"
-    if ((atom_getsym(argv) == sym_env) && (atom_gettype(argv + 1) == A_SYM)) {
+  return (r & SOAK_RAND_MAX);
+}
 
-      //== Create the envelope buffer reference and object
-      x->buff_env_sym = atom_getsym(argv + 1);
+// ====  PROCEDURE: GRANULAR_SOAK_CHANGE  ====
+// One random change of a parameter of a random seeder that is on, through the parameter queue.
+// With source, also a random envelope, a new source handle and a random loop region or no loop.
+// The drift reference of the changed seeder is reset.
 
-      if (x->buff_env_ref) {
-        buffer_ref_set(x->buff_env_ref, x->buff_env_sym);
-      }
-      else {
-        x->buff_env_ref = buffer_ref_new((t_object*)x, x->buff_env_sym);
-      }
+void granular_soak_change(t_granular* x, t_soak* soak, t_bool source) {
 
-      x->buff_env_obj = buffer_ref_getobject(x->buff_env_ref);
+  static const char* env_names[] = { "hann", "sine", "tukey", "expodec", "rexpodec", "trapezoidal", "rectangular" };
 
-      //== If the envelope buffer is successfully found
-      if (x->buff_env_obj) {
+  t_int16   index = (t_int16)(granular_soak_rand(soak) % x->seeders_max);
+  t_seeder* seeder = x->seeders_arr + index;
+  t_double  f = (t_double)granular_soak_rand(soak) / SOAK_RAND_MAX;
+
+  if (!seeder->is_on) { return; }
+
+  soak->seeders[index].ref_ok = false;
+
+  switch (granular_soak_rand(soak) % (PARAM_PERIOD_RAND + 1)) {
+  case PARAM_AMPL:        granular_param_push(x, index, PARAM_AMPL, f); break;
+  case PARAM_BEGIN:       granular_param_push(x, index, PARAM_BEGIN, f); break;
+  case PARAM_LENGTH:      granular_param_push(x, index, PARAM_LENGTH, 5 + 495 * f); break;
+  case PARAM_SHIFT:       granular_param_push(x, index, PARAM_SHIFT, 4 * f - 2); break;
+  case PARAM_PERIOD:      granular_param_push(x, index, PARAM_PERIOD, 0.1 + 1.9 * f); break;
+  case PARAM_SPEED:       granular_param_push(x, index, PARAM_SPEED, 4 * f - 2); break;
+  case PARAM_POLY:        granular_param_push(x, index, PARAM_POLY, 1 + (t_int16)(f * (POLY_MAX - 1))); break;
+  case PARAM_PERIOD_RAND: granular_param_push(x, index, PARAM_PERIOD_RAND, f); break;
+  default: break;
+  }
 
-        // Set the size of the envelope buffer
-        t_max_err max_err = object_method_long(x->buff_env_obj, gensym("sizeinsamps"), x->env_n_frm, NULL);
-        if (max_err != MAX_ERR_NONE) {
-          MY_ERR("buffer:  Unable to set the size of the envelope buffer \"%s\"", x->buff_env_sym->s_name); return;
-        }
+  if (!source) { return; }
 
-        POST("buffer:  Envelope buffer \"%s\" successfully linked to.", x->buff_env_sym->s_name); return;
-      }
+  t_atom argv[2];
+  atom_setlong(argv, index);
+  atom_setsym (argv + 1, gensym(env_names[granular_soak_rand(soak) % (sizeof(env_names) / sizeof(env_names[0]))]));
+  granular_envelope(x, gensym("envelope"), 2, argv);
 
-      else {
-        x->buff_env_ref = NULL;
-        MY_ERR("buffer:  Unable to link to envelope buffer \"%s\".", x->buff_env_sym->s_name);
-        return;
-      }
-    }
+  if (seeder->buff_state != BUFF_READY) { return; }
 
-    //==== If the first atom is an integer
-    else if ((atom_gettype(argv) == A_LONG) && (atom_gettype(argv + 1) == A_SYM)) {
+  if (seeder->mem_mode == MEM_MODE_OFF) { granular_src_publish(x, seeder, NULL); }
 
-      //== Check that it is between 0 and (x->seeders_max - 1)
-      t_int16 index = (t_int16)atom_getlong(argv);
-      if ((index >= 0) && (index < x->seeders_max)) {
+  t_double len_ms = seeder->buff_n_frm / seeder->buff_msr;
+  t_double begin_ms = len_ms * granular_soak_rand(soak) / SOAK_RAND_MAX;
+  t_double end_ms = begin_ms + (len_ms - begin_ms) * granular_soak_rand(soak) / SOAK_RAND_MAX;
 
-        t_seeder* seeder = x->seeders_arr + index;
+  seeder->loop_begin_ms = ((granular_soak_rand(soak) % 2) ? begin_ms : 0);
+  seeder->loop_end_ms   = ((seeder->loop_begin_ms > 0) && (end_ms > begin_ms) ? end_ms : 0);
+  granular_loop_update(x, seeder);
+}
 
-        // Create the source buffer reference and object
-        seeder->buff_sym = atom_getsym(argv + 1);
+// ====  METHOD: GRANULAR_BENCH  ====
+// Runs the microbenchmarks of the list, envelope, ramp and crossfade primitives and posts the ticks per operation.
+// The lists have grains_max nodes and the envelopes env_n_frm values, the sizes the engine uses.
+// Best run with the DSP off, as the audio thread competes for the CPU otherwise.
+// Arguments: [Int]
+//   Arg 0:  Int - Optional, number of repetitions of each benchmark, 100 by default
 
-        // Test the name / symbol
-        if (seeder->buff_sym == sym_empty) {
-          seeder->buff_state = BUFF_NO_SYM;
-          MY_ERR("buffer:  Unable to link seeder %i to source buffer. Could not get a valid name.", index);
-          return;
-        }
+void granular_bench(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
 
-        // Test the buffer reference
-        if (x->buff_env_ref) { buffer_ref_set(seeder->buff_ref, seeder->buff_sym); }
-        else { seeder->buff_ref = buffer_ref_new((t_object*)x, seeder->buff_sym); }
+  TRACE("granular_bench");
 
-        if (seeder->buff_ref == NULL) {
-          seeder->buff_state = BUFF_NO_REF;
-          MY_ERR("buffer:  Unable to link seeder %i to source buffer \"%s\". Could not get a valid reference.", index, seeder->buff_sym->s_name);
-          return;
-        }
+  t_int32 n_rep = ((argc > 0) ? (t_int32)atom_getlong(argv) : 100);
 
-        // Test the buffer object
-        seeder->buff_obj = buffer_ref_getobject(seeder->buff_ref);
+  if (n_rep <= 0) {
+    MY_ERR("bench:  Arg 0 (repetitions):  Has to be more than 0.");
+    return;
+  }
 
-        if (seeder->buff_obj == NULL) {
-          seeder->buff_state = BUFF_NO_OBJ;
-          MY_ERR("buffer:  Unable to link seeder %i to source buffer \"%s\". Could not get a valid object.", index, seeder->buff_sym->s_name);
-          return;
-        }
+  t_bench_result res[BENCH_N_RESULT];
+  t_int16 cnt;
 
-        // Test if a file is loaded
-        seeder->buff_n_frm = (t_int32)buffer_getframecount(seeder->buff_obj);
-        seeder->buff_n_chn = (t_int16)buffer_getchannelcount(seeder->buff_obj);
-        seeder->buff_msr   = buffer_getmillisamplerate(seeder->buff_obj);
-        seeder->src_len    = (t_int32)(seeder->src_len_ms * seeder->buff_msr);
+  if (CYCLE_COUNT() == 0) {
+    MY_ERR("bench:  No tick counter on this platform.");
+    return;
+  }
 
-        if ((seeder->buff_n_frm == 0) || (seeder->buff_n_chn == 0) || (seeder->buff_msr == 0)) {
-          seeder->buff_state = BUFF_NO_FILE;
-          POST("buffer:  Seeder %i successfully linked to source buffer \"%s\". No file loaded yet.", index, seeder->buff_sym->s_name);
-          return;
-        }
+  cnt = bench_list(res, x->grains_max, n_rep);
+  if (cnt == 0) { MY_ERR("bench:  Unable to allocate the lists."); }
 
-        // Otherwise the buffer is linked and a file is loaded.
-        seeder->buff_state = BUFF_READY;
-        POST("buffer:  Seeder %i successfully linked to source buffer \"%s\".", index, seeder->buff_sym->s_name);
-        return;
-      }
+  POST("bench:  Lists of %i nodes - ticks per operation:", x->grains_max);
+  for (t_int16 i = 0; i < cnt; i++) { POST("bench:    %-28s %8.2f", res[i].name, res[i].ticks); }
 
-      //== Otherwise the index is out of bounds
-      else {
-        MY_ERR("buffer:  Arg 0 (index of the seeder):  Has to be between 0 and %i, was %i instead.", x->seeders_max - 1, index);
-        return;
-      }
-    }
-  }
+  cnt = bench_env(res, x->env_n_frm, n_rep);
+  if (cnt == 0) { MY_ERR("bench:  Unable to allocate the envelope table."); }
 
-  MY_ERR("buffer:  Invalid arguments. The method expects:");
-  MY_ERR2("  Arg 0:  Int or Symbol - Seeder index to set a source buffer or \"env\" to set the envelope buffer.");
-  MY_ERR2("  Arg 1:  Symbol - The name of the buffer");
+  POST("bench:  Envelopes of %i values - ticks per value:", x->env_n_frm);
+  for (t_int16 i = 0; i < cnt; i++) { POST("bench:    %-28s %8.2f", res[i].name, res[i].ticks); }
+
+  outlet_bang(x->outl_compl);
 }
 
-// ====  METHOD: GRANULAR_FILE  ====
+// ====  METHOD: GRANULAR_NORMALIZE  ====
+// Sets the per-grain loudness normalization of a seeder. Called by normalize message.
+// Each grain is scaled toward the target RMS level, using the RMS of its source window calculated in O(1)
+// from prefix sums of the squared samples, which are built when the source is loaded.
+// Arguments: Int Float [Float]
+//   Arg 0:  Int   - Seeder index
+//   Arg 1:  Float - Target RMS level, 0 to turn the normalization off
+//   Arg 2:  Float - Optional: maximum normalization gain (default 8)
 
-void granular_file(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
+void granular_normalize(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv) {
 
-  TRACE("granular_file");
+  TRACE("granular_normalize");
 
   // Check the validity of the arguments
-  t_int16 index = granular_check_args(x, "file", argc, argv, 3);
-  if (index == ERR_ARG) { outlet_bang(x->outl_compl); return; }
+  t_int16 index = granular_check_args(x, "normalize", argc, argv, ((argc == 3) ? 3 : 2));
+  if (index == ERR_ARG) { return; }
 
-  t_seeder* seeder = x->seeders_arr + index;
+  t_seeder* seeder   = x->seeders_arr + index;
+  t_double  target   = (t_double)atom_getfloat(argv + 1);
+  t_double  gain_max = ((argc == 3) ? (t_double)atom_getfloat(argv + 2) : NORM_MAX);
 
-  // If the seeder is on
-  if (seeder->is_on == true) {
+  if ((target < 0) || (gain_max <= 0)) {
+    MY_ERR("normalize:  The target level has to be 0 or more and the maximum gain more than 0.");
+    return;
+  }
 
-    // Remove all grains linked to the seeder
-    t_int16* node = x->grains_list->first_used;
-    t_grain* grain;
+  granular_param_push(x, index, PARAM_NORM_MAX, gain_max);
 
-    while (*node != LIST_END) {
+  // Turn off: release the prefix sums
+  if (target == 0) {
+    granular_param_push(x, index, PARAM_NORM_TARGET, 0);
+    if (!granular_block_publish(x, &seeder->psum, NULL)) {
+      MY_ERR("normalize:  Seeder %i:  Too many changes are waiting for their grains to end. Keeping the prefix sums.", index);
+    }
+    return;
+  }
 
-      grain = x->grains_arr + *node;
+  // Turn on: build the prefix sums now if the source is ready, or when it becomes ready
+  if ((seeder->psum == NULL) && (seeder->buff_state == BUFF_READY)) { granular_psum_load(x, seeder); }
+  granular_param_push(x, index, PARAM_NORM_TARGET, target);
+}
 
-      if (grain->index == index) {
-        x->grains_cnt--;
-        list_remove_node(x->grains_list, node);
-      }
-      else {
-        node = x->grains_list->array + *node;
-      }
-    }
+// ====  PROCEDURE: GRANULAR_PSUM_LOAD  ====
+// Build the prefix sums of the squared samples of the first channel of the source buffer
 
-    // Remove the seeder from the active list
-    list_remove_index(x->seeders_list, index);
+void granular_psum_load(t_granular* x, t_seeder* seeder) {
 
-    // Update the seeder counter and set the seeder off
-    x->seeders_cnt--;
-    seeder->is_on = false;
-  }
+  TRACE("granular_psum_load");
 
-  // Get the file name and full name with path
+  TL_BEGIN(tl_psum);
 
-  t_symbol* file   = atom_getsym(argv + 1);
-  t_symbol* path   = atom_getsym(argv + 2);
+  t_buffer_obj* buff_obj = buffer_ref_getobject(seeder->buff_ref);
+  t_int32 n_frm = (buff_obj ? (t_int32)buffer_getframecount(buff_obj) : 0);
+  t_int32 n_chn = (buff_obj ? (t_int32)buffer_getchannelcount(buff_obj) : 0);
+  float*  buff_src = NULL;
 
-  seeder->buff_file   = file;
-  seeder->buff_path   = path;
-  seeder->buff_state  = BUFF_READY;
-  seeder->buff_is_chg = true;
+  // Build the new prefix sums while the grains still use the previous ones. Stop normalizing if the source is empty.
+  t_shared_block* block = (((n_frm > 0) && (n_chn > 0)) ? granular_block_new(n_frm, (n_frm + 1) * sizeof(t_double)) : NULL);
 
-  // Send out a read message to the buffer object
-  atom_setsym  (x->mess_arr, seeder->buff_path);
-  atom_setfloat(x->mess_arr + 1, 0);
-  atom_setlong (x->mess_arr + 2, -1);
-  atom_setlong (x->mess_arr + 3, 1);
+  if ((n_frm > 0) && (n_chn > 0) && (block == NULL)) {
+    MY_ERR("normalize:  Seeder %i:  Unable to allocate the prefix sums for %i frames.", seeder->index, n_frm);
+  }
 
-  t_atom ret;
-  object_method_typed(seeder->buff_obj, gensym("read"), 4, x->mess_arr, &ret);
-  buffer_setdirty(seeder->buff_obj);
-  seeder->src_begin = 0;
+  if (block != NULL) {
+    buff_src = buffer_locksamples(buff_obj);
+    if (buff_src == NULL) { sysmem_freeptr(block); block = NULL; }
+  }
 
-  outlet_bang(x->outl_compl);
+  if (block != NULL) {
+    t_double* psum = (t_double*)block->data;
+    psum[0] = 0;
+    for (t_int32 i = 0; i < n_frm; i++) { psum[i + 1] = psum[i] + (t_double)buff_src[i * n_chn] * buff_src[i * n_chn]; }
+    buffer_unlocksamples(buff_obj);
+  }
+
+  if (!granular_block_publish(x, &seeder->psum, block)) {
+    MY_ERR("normalize:  Seeder %i:  Too many changes are waiting for their grains to end. Keeping the previous prefix sums.", seeder->index);
+  }
+
+  TL_END(tl_psum, TL_MAIN, TL_PSUM, seeder->index);
 }
 
 // ========  ENVELOPES  ========
@@ -1517,62 +5210,155 @@ void granular_envelope(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* argv)
   t_seeder* seeder = x->seeders_arr + index;
   t_symbol* env_sym = atom_getsym(argv + 1);
 
-  if (env_sym == gensym("none"))                  { seeder->env_func = env_rectangular;     seeder->env_type = ENV_NONE; }
-  else if (env_sym == gensym("rectangular"))      { seeder->env_func = env_rectangular;     seeder->env_type = ENV_RECTANGULAR; }
-  else if (env_sym == gensym("welch"))            { seeder->env_func = env_welch;           seeder->env_type = ENV_WELCH; }
-  else if (env_sym == gensym("sine"))             { seeder->env_func = env_sine;            seeder->env_type = ENV_SINE; }
-  else if (env_sym == gensym("hann"))             { seeder->env_func = env_hann;            seeder->env_type = ENV_HANN; }
-  else if (env_sym == gensym("hamming"))          { seeder->env_func = env_hamming;         seeder->env_type = ENV_HAMMING; }
-  else if (env_sym == gensym("blackman"))         { seeder->env_func = env_blackman;        seeder->env_type = ENV_BLACKMAN; }
-  else if (env_sym == gensym("nuttal"))           { seeder->env_func = env_nuttal;          seeder->env_type = ENV_NUTTAL; }
-  else if (env_sym == gensym("blackman-nuttal"))  { seeder->env_func = env_blackman_nuttal; seeder->env_type = ENV_BLACKMAN_NUTTAL; }
-  else if (env_sym == gensym("blackman-harris"))  { seeder->env_func = env_blackman_harris; seeder->env_type = ENV_BLACKMAN_HARRIS; }
-  else if (env_sym == gensym("flat top"))         { seeder->env_func = env_flat_top;        seeder->env_type = ENV_FLAT_TOP; }
+  // Parse into locals: the seeder only changes once the new table is published
+  t_double (*env_func) (t_double, t_double, t_double);
+  t_env_type env_type;
+  t_double   env_alpha = seeder->env_alpha;
+  t_double   env_beta  = seeder->env_beta;
+
+  if (env_sym == gensym("none"))                  { env_func = env_rectangular;     env_type = ENV_NONE; }
+  else if (env_sym == gensym("rectangular"))      { env_func = env_rectangular;     env_type = ENV_RECTANGULAR; }
+  else if (env_sym == gensym("welch"))            { env_func = env_welch;           env_type = ENV_WELCH; }
+  else if (env_sym == gensym("sine"))             { env_func = env_sine;            env_type = ENV_SINE; }
+  else if (env_sym == gensym("hann"))             { env_func = env_hann;            env_type = ENV_HANN; }
+  else if (env_sym == gensym("hamming"))          { env_func = env_hamming;         env_type = ENV_HAMMING; }
+  else if (env_sym == gensym("blackman"))         { env_func = env_blackman;        env_type = ENV_BLACKMAN; }
+  else if (env_sym == gensym("nuttal"))           { env_func = env_nuttal;          env_type = ENV_NUTTAL; }
+  else if (env_sym == gensym("blackman-nuttal"))  { env_func = env_blackman_nuttal; env_type = ENV_BLACKMAN_NUTTAL; }
+  else if (env_sym == gensym("blackman-harris"))  { env_func = env_blackman_harris; env_type = ENV_BLACKMAN_HARRIS; }
+  else if (env_sym == gensym("flat top"))         { env_func = env_flat_top;        env_type = ENV_FLAT_TOP; }
 
   else if (env_sym == gensym("triangular")) {
-    seeder->env_func = env_triangular;
-    seeder->env_type = ENV_TRIANGULAR;
-    seeder->env_alpha = 0.5;
+    env_func = env_triangular;
+    env_type = ENV_TRIANGULAR;
+    env_alpha = 0.5;
   }
 
   else if (env_sym == gensym("trapezoidal")) {
-    seeder->env_func = env_trapezoidal;
-    seeder->env_type = ENV_TRAPEZOIDAL;
-    seeder->env_alpha = 0.1;
-    seeder->env_beta = 0.9;
+    env_func = env_trapezoidal;
+    env_type = ENV_TRAPEZOIDAL;
+    env_alpha = 0.1;
+    env_beta = 0.9;
   }
 
   else if (env_sym == gensym("tukey")) {
-    seeder->env_func = env_tukey;
-    seeder->env_type = ENV_TUKEY;
-    seeder->env_alpha = 0.2;
-    seeder->env_beta = 0.8;
+    env_func = env_tukey;
+    env_type = ENV_TUKEY;
+    env_alpha = 0.2;
+    env_beta = 0.8;
   }
 
   else if (env_sym == gensym("expodec")) {
-    seeder->env_func = env_expodec;
-    seeder->env_type = ENV_EXPODEC;
-    seeder->env_alpha = 0.9;
-    seeder->env_beta = 0.2;
+    env_func = env_expodec;
+    env_type = ENV_EXPODEC;
+    env_alpha = 0.9;
+    env_beta = 0.2;
   }
 
   else if (env_sym == gensym("rexpodec")) {
-    seeder->env_func = env_rexpodec;
-    seeder->env_type = ENV_REXPODEC;
-    seeder->env_alpha = 0.1;
-    seeder->env_beta = 0.2;
+    env_func = env_rexpodec;
+    env_type = ENV_REXPODEC;
+    env_alpha = 0.1;
+    env_beta = 0.2;
+  }
+
+  else { MY_ERR("The envelope type \"%s\" is not recognized", env_sym->s_name); return; }
+
+  // Free the tables that no grain reads anymore, and make room for the one that is replaced
+  granular_env_reclaim(x, false);
+
+  if (x->env_retired_cnt == ENV_RETIRED_MAX) {
+    MY_ERR("envelope:  Too many envelope changes are waiting for their grains to end. Try again later.");
+    return;
   }
 
-  else { MY_ERR("The envelope type \"%s\" is not recognized", sym->s_name); return; }
+  t_env_table* table_new = granular_env_new(x);
+  t_env_table* table_old = seeder->env_table;
 
-  seeder->env_sym = env_sym;
+  if (table_new == NULL) {
+    MY_ERR("envelope:  Unable to allocate the envelope table.");
+    return;
+  }
 
-  // Calculate the envelope values (unless the type is unrecognized)
+  // Calculate the envelope values in the new table (unless the type is unrecognized)
   t_double f;
   for (t_int16 i = 0; i < x->env_n_frm; i++) {
     f = (t_double)i / (x->env_n_frm - 1);
-    seeder->env_values[i] = (float)seeder->env_func(f, seeder->env_alpha, seeder->env_beta);
+    table_new->values[i] = (float)env_func(f, env_alpha, env_beta);
+  }
+
+  table_new->mode = (((env_type == ENV_NONE) || (env_type == ENV_RECTANGULAR)) ? ENV_MODE_FLAT : ENV_MODE_TABLE);
+  granular_env_ms(x, table_new);
+
+  // Publish the new table: grains added from now on use it, live grains finish with the old one
+  PTR_PUBLISH(seeder->env_table, table_new);
+
+  table_old->epoch = ATOMIC_LOAD(x->epoch);
+  x->env_retired[x->env_retired_cnt++] = table_old;
+
+  seeder->env_func  = env_func;
+  seeder->env_type  = env_type;
+  seeder->env_alpha = env_alpha;
+  seeder->env_beta  = env_beta;
+  seeder->env_sym   = env_sym;
+}
+
+// ====  PROCEDURE: GRANULAR_ENV_NEW  ====
+// Allocate an envelope table, with the values following the header in the same block
+// RETURNS: The table, or NULL if the allocation failed
+
+t_env_table* granular_env_new(t_granular* x) {
+
+  t_env_table* table = (t_env_table*)sysmem_newptr(sizeof(t_env_table) + x->env_n_frm * sizeof(float));
+  if (table == NULL) { return NULL; }
+
+  table->grain_cnt = 0;
+  table->epoch     = 0;
+  table->mode      = ENV_MODE_TABLE;
+  table->ms        = 1;
+  table->values    = (float*)(table + 1);
+
+  return table;
+}
+
+// ====  PROCEDURE: GRANULAR_ENV_RECLAIM  ====
+// Free the retired envelope tables that are safe to free: the audio thread finished a vector cycle since
+// the table was retired, so no grain can still be taking it, and no live grain reads it.
+// With the DSP off no grain is added, so only the grain count matters. Forced when the object is freed.
+
+void granular_env_reclaim(t_granular* x, t_bool force) {
+
+  t_bool       dsp_on = (sys_getdspobjdspstate((t_object*)x) != 0);
+  t_env_table* table;
+  t_int16      cnt = 0;
+
+  for (t_int16 i = 0; i < x->env_retired_cnt; i++) {
+
+    table = x->env_retired[i];
+
+    if (force || (((!dsp_on) || (ATOMIC_LOAD(x->epoch) != table->epoch)) && (ATOMIC_LOAD(table->grain_cnt) == 0))) {
+      sysmem_freeptr(table);
+    }
+    else {
+      x->env_retired[cnt++] = table;
+    }
   }
+
+  x->env_retired_cnt = cnt;
+}
+
+// ====  PROCEDURE: GRANULAR_ENV_MS  ====
+// Calculate the mean square of an envelope table, once when it is built and before it is published
+
+void granular_env_ms(t_granular* x, t_env_table* table) {
+
+  t_double sum = 0;
+
+  if (table->mode == ENV_MODE_FLAT) { table->ms = 1; return; }
+
+  for (t_int16 i = 0; i < x->env_n_frm; i++) { sum += table->values[i] * table->values[i]; }
+
+  table->ms = sum / x->env_n_frm;
 }
 
 // ====  METHOD: GRANULAR_OUTPUT_ENV  ====
@@ -1597,7 +5383,7 @@ void granular_output_env(t_granular* x, t_symbol* sym, t_int16 argc, t_atom* arg
   }
 
   float*   buffer = buffer_locksamples(x->buff_env_obj);
-  float*   env_values = seeder->env_values;
+  float*   env_values = seeder->env_table->values;
   t_int32  cntd = x->env_n_frm;
 
   while (cntd--) { *buffer++ = *env_values++; }
@@ -1617,25 +5403,156 @@ t_grain* granular_add_grain_fs(t_granular* x, t_seeder* seeder, t_int32 src_offs
   //TRACE("granular_add_grain_fs");
 
   if (x->grains_cnt == x->grains_max) {
+    x->hist.dropped++;
     MY_ERR("Impossible to add grain:  Maximum number already reached.");
     return NULL;
   }
 
   x->grains_cnt++;
+  x->hist.spawn_cnt++;
   t_grain* grain = (x->grains_arr + list_insert_first(x->grains_list));
 
   grain->index      = seeder->index;
   grain->is_new     = true;
 
-  grain->ampl       = seeder->ampl;
-  grain->src_begin  = seeder->src_begin + src_offset;
+  grain->src_begin  = seeder->src_begin + ((seeder->play_dir < 0) ? -src_offset : src_offset);
   grain->src_len    = seeder->src_len;
+  grain->pool_ind   = POOL_NONE;
+  grain->block      = NULL;
+
+  // Grains reading the seeder's own buffer are bounded by the published source, not by the seeder's metadata
+  t_src_handle* handle = PTR_ACQUIRE(seeder->src_handle);
+
+  t_int16 n_chn = (handle ? handle->n_chn : 1);
+  t_int32 n_frm = (handle ? handle->n_frm : 0);
+
+  // Grains reading a pool source keep the handle of the source from the pool table
+  t_shared_block* pool = PTR_ACQUIRE(seeder->pool_table);
+  t_src_handle*   pool_handle = NULL;
+  t_shared_block* loop = PTR_ACQUIRE(seeder->loop);
+  t_shared_block* ring = PTR_ACQUIRE(x->ring);
+
+  // Record ring: the grain reads the window that ends the read-behind time before the write head.
+  // Only from the ring already recorded into, and the grain keeps it.
+  if ((seeder->src_mode == SRC_MODE_RING) && (ring != NULL) && (ring == x->ring_rec)) {
+
+    t_int32 len    = ring->n_frm;
+    t_int32 behind = (t_int32)(seeder->ring_behind_ms * x->msamplerate);
+    t_int32 span;
+
+    grain->pool_ind = POOL_RING;
+    grain->block    = ring;
+    grain->src_len  = (t_int32)(seeder->len_ms * x->msamplerate);
+    if (grain->src_len > len - 1) { grain->src_len = len - 1; }
+
+    // The write head must not reach the frames of the window before the grain reads them: both the first frame,
+    // read at once, and the last one, read after the output length, so behind + max(src_len, out_len) < len.
+    // A grain longer than the ring reads frames recorded while it plays.
+    span = ((grain->src_len > seeder->out_len) ? grain->src_len : seeder->out_len);
+    if (behind > len - 1 - span) { behind = len - 1 - span; }
+    if (behind < 0) { behind = 0; }
+
+    grain->src_begin = (x->ring_w - behind - grain->src_len) % len;
+    if (grain->src_begin < 0) { grain->src_begin += len; }
+
+    n_chn = 1;
+    n_frm = 2 * len;
+  }
+
+  // Sample pool: choose the source, and map the position and length in ms to its samplerate and length
+  else if ((seeder->pool_mode != POOL_OFF) && (pool != NULL) && (seeder->src_mode == SRC_MODE_BUFFER)) {
+
+    t_pool_table* table = (t_pool_table*)pool->data;
+    t_int16       pool_ind = granular_pool_choose(seeder, table);
+
+    pool_handle = table->handle[pool_ind];
+
+    if (pool_handle != NULL) {
+      grain->pool_ind  = pool_ind;
+      grain->src_begin = (t_int32)(grain->src_begin * pool_handle->msr / (handle ? handle->msr : x->msamplerate));
+      grain->src_len   = (t_int32)(seeder->len_ms * pool_handle->msr);
+      if (grain->src_len > pool_handle->n_frm) { grain->src_len = pool_handle->n_frm; }
+      n_chn = pool_handle->n_chn;
+      n_frm = pool_handle->n_frm;
+    }
+  }
+
+  // Loop region with a loop copy: the grain reads across the loop point, from its position in the copy it keeps
+  else if (loop != NULL) {
+    grain->pool_ind  = POOL_LOOP;
+    grain->block     = loop;
+    grain->src_begin = (grain->src_begin - loop->offset) % loop->n_frm;
+    if (grain->src_begin < 0) { grain->src_begin += loop->n_frm; }
+    if (grain->src_len > loop->n_frm) { grain->src_len = loop->n_frm; }
+    n_chn = loop->n_chn;
+    n_frm = 2 * loop->n_frm;
+  }
+
+  // Otherwise the grain is kept in the loop region
+  else if (seeder->loop_end > seeder->loop_begin) {
+    if (grain->src_begin + grain->src_len > seeder->loop_end) { grain->src_begin = seeder->loop_end - grain->src_len; }
+    if (grain->src_begin < seeder->loop_begin) { grain->src_begin = seeder->loop_begin; }
+  }
 
   if (grain->src_begin < 0) { grain->src_begin = 0; }
-  if (grain->src_begin + grain->src_len > seeder->buff_n_frm) { grain->src_begin = seeder->buff_n_frm - grain->src_len; }
+  if (grain->src_begin + grain->src_len > n_frm) { grain->src_begin = n_frm - grain->src_len; }
+
+  grain->ampl       = seeder->ampl;
+
+  // Keep the current envelope table for the whole grain: its mode and mean square are read from the same table
+  grain->env_table = PTR_ACQUIRE(seeder->env_table);
+  ATOMIC_INCREMENT(&grain->env_table->grain_cnt);
+
+  // Loudness normalization: scale the grain toward the target, from the RMS of its source window in O(1)
+  t_shared_block* psum = PTR_ACQUIRE(seeder->psum);
+
+  if ((psum != NULL) && (grain->pool_ind == POOL_NONE) && (seeder->src_mode == SRC_MODE_BUFFER) && (grain->src_len > 0) && (grain->src_begin >= 0)
+    && (grain->src_begin + grain->src_len <= psum->n_frm)) {
+    t_double* sum = (t_double*)psum->data;
+    t_double  ms = (sum[grain->src_begin + grain->src_len] - sum[grain->src_begin]) / grain->src_len;
+    t_double gain = seeder->norm_target / sqrt((ms > NORM_MIN_MS) ? ms : NORM_MIN_MS);
+    grain->ampl *= ((gain < seeder->norm_max) ? gain : seeder->norm_max);
+  }
+
+  grain->energy     = grain->ampl * grain->ampl * grain->env_table->ms;
+
+  // Automatic gain: scale the grain so that the energy of all overlapping grains, itself included, reaches the target
+  if (x->autogain_target > 0) {
+    x->overlap_e += grain->energy;
+    t_double gain = x->autogain_target / sqrt((x->overlap_e > AUTOGAIN_MIN_E) ? x->overlap_e : AUTOGAIN_MIN_E);
+    grain->ampl *= ((gain < x->autogain_max) ? gain : x->autogain_max);
+  }
+
+  grain->os_ind     = seeder->os_ind;
+  grain->out_begin  = out_offset << grain->os_ind;
+  grain->out_len    = seeder->out_len << grain->os_ind;
+  grain->glide      = false;
 
-  grain->out_begin  = out_offset;
-  grain->out_len    = seeder->out_len;
+  // Glisson: the rate ramps linearly from the start to the end shift, the output length is set by the mean rate,
+  // and the increments are scaled so that the phase reaches the end of the source window on the last sample
+  if (seeder->glide) {
+
+    t_double rate_0 = exp(LN2 * (seeder->glide_begin + seeder->glide_rand * (2.0 * rand() / RAND_MAX - 1)));
+    t_double rate_1 = exp(LN2 * (seeder->glide_end   + seeder->glide_rand * (2.0 * rand() / RAND_MAX - 1)));
+
+    grain->out_len = (t_int32)(seeder->out_len * 2 / (rate_0 + rate_1)) << grain->os_ind;
+
+    if ((grain->out_len > 2) && (grain->src_len > 1)) {
+
+      t_int32  steps = grain->out_len - 1;
+      t_double scale = (grain->src_len - 1) / (steps * rate_0 + (rate_1 - rate_0) * (steps - 1) / 2);
+
+      grain->glide         = true;
+      grain->phase         = 0;
+      grain->phase_inc     = rate_0 * scale;
+      grain->phase_inc_inc = (rate_1 - rate_0) * scale / steps;
+    }
+    else { grain->out_len = seeder->out_len << grain->os_ind; }
+  }
+
+  // At least two output samples, as the kernels step through the envelope by the length minus one:
+  // a short grain shifted far up would otherwise never end
+  if (grain->out_len < 2) { grain->out_len = 2; }
 
   grain->out_cntd   = grain->out_len;
 
@@ -1645,9 +5562,78 @@ t_grain* granular_add_grain_fs(t_granular* x, t_seeder* seeder, t_int32 src_offs
   grain->env_I  = 0;
   grain->env_R  = 0;
 
+  grain->fading     = false;
+  grain->fade_cntd  = 0;
+  grain->fade_len   = 0;
+  grain->played     = 0;
+
+  grain->kernel = kernel_select(seeder->interp, grain->env_table->mode, n_chn, grain->glide);
+
+  // Oscillator sources: the length is not shifted, the shift transposes the frequency instead
+  if ((seeder->src_mode == SRC_MODE_WAVETABLE) || (seeder->src_mode == SRC_MODE_PULSAR)) {
+
+    t_double freq = seeder->freq / seeder->shift_r * exp(LN2 * seeder->freq_rand * (2.0 * rand() / RAND_MAX - 1));
+    t_double nyquist = 500 * (x->msamplerate * (1 << grain->os_ind));
+
+    if (freq > nyquist) { freq = nyquist; }
+
+    // The table is band-limited for the fundamental of the cycle as played: a pulsar cycle is compressed by the duty
+    grain->pool_ind   = POOL_OSC;
+    grain->block      = NULL;
+    grain->src_begin  = 0;
+    grain->src_len    = WT_LEN;
+    grain->out_len    = (t_int32)(seeder->len_ms * x->msamplerate) << grain->os_ind;
+    grain->out_len    = ((grain->out_len < 2) ? 2 : grain->out_len);
+    grain->out_cntd   = grain->out_len;
+    grain->glide      = false;
+    grain->table      = wt_get(seeder->wave, nyquist * seeder->duty / freq);
+    grain->phase      = 0;
+    grain->phase_inc  = freq * WT_LEN / (1000 * x->msamplerate * (1 << grain->os_ind));
+    grain->duty_inv   = 1 / seeder->duty;
+    grain->kernel     = kernel_osc_select(seeder->src_mode, grain->env_table->mode);
+  }
+
+  // Keep the current source handle for the whole grain
+  grain->src_handle = ((grain->pool_ind >= 0) ? pool_handle : ((grain->pool_ind == POOL_NONE) ? handle : NULL));
+  if (grain->src_handle) { ATOMIC_INCREMENT(&grain->src_handle->grain_cnt); }
+  if (grain->block) { ATOMIC_INCREMENT(&grain->block->grain_cnt); }
+
+  if (ATOMIC_LOAD(x->load_on)) { seeder->load.grains++; }
+
   return grain;
 }
 
+// ====  PROCEDURE: GRANULAR_PREFETCH_FS  ====
+// Prefetch the first cache lines of the source window of a grain that the seeder will add in the next vector cycle.
+// Uses the same offset and boundary adjustment as granular_add_grain_fs so the prefetched lines are the ones read first.
+
+void granular_prefetch_fs(t_granular* x, t_seeder* seeder, float* buff_src, t_int32 src_offset) {
+
+  t_int32 src_begin = seeder->src_begin + ((seeder->play_dir < 0) ? -src_offset : src_offset);
+
+  // Grains of a pool read from another source, grains of a loop read from the loop copy
+  if ((seeder->pool_mode != POOL_OFF) && (PTR_ACQUIRE(seeder->pool_table) != NULL)) { return; }
+
+  t_shared_block* loop = PTR_ACQUIRE(seeder->loop);
+
+  if (loop != NULL) {
+    src_begin = (src_begin - loop->offset) % loop->n_frm;
+    if (src_begin < 0) { src_begin += loop->n_frm; }
+    buff_src = (float*)loop->data;
+  }
+
+  t_src_handle* handle = PTR_ACQUIRE(seeder->src_handle);
+  if (handle == NULL) { return; }
+
+  if (src_begin < 0) { src_begin = 0; }
+  if (src_begin + seeder->src_len > handle->n_frm) { src_begin = handle->n_frm - seeder->src_len; }
+  if (src_begin < 0) { return; }
+
+  char* addr = (char*)(buff_src + src_begin * handle->n_chn);
+
+  for (t_int16 line = 0; line < PREFETCH_LINES; line++) { PREFETCH(addr + line * CACHE_LINE); }
+}
+
 // ====  METHOD: GRANULAR_ADD_GRAIN  ====
 // Add a grain directly without using a seeder. Called by add_grain message. Validity is checked.
 // Args:  Float Float Float Float
@@ -1773,3 +5759,245 @@ void granular_bang(t_granular* x) {
 
   TRACE("granular_bang");
 }
+
+// ========  OVERSAMPLING  ========
+
+// ====  PROCEDURE: GRANULAR_OS_BUS  ====
+// Get an oversampled bus for the current vector cycle, clearing it the first time it is used in the cycle
+// RETURNS: The bus, with (sampleframes << os_ind) samples
+
+t_double* granular_os_bus(t_granular* x, t_int8 os_ind, t_int32 sampleframes) {
+
+  t_double* bus = x->os_bus[os_ind];
+
+  if (!x->os_used[os_ind]) {
+    t_int32 n = sampleframes << os_ind;
+    while (n--) { *bus++ = 0; }
+    x->os_used[os_ind] = true;
+  }
+
+  return x->os_bus[os_ind];
+}
+
+// ====  PROCEDURE: GRANULAR_OS_MIX  ====
+// Decimate each oversampled bus into the bus at half its rate, from the highest rate down to the output.
+// A bus is only processed when grains were written to it, and for one filter length afterwards to flush the decimator.
+
+void granular_os_mix(t_granular* x, t_double* out, t_int32 sampleframes) {
+
+  t_int32 n_in;
+
+  for (t_int8 i = OS_N_BUS - 1; i > 0; i--) {
+
+    n_in = sampleframes << i;
+
+    if (x->os_used[i]) { x->os_tail[i] = HB_LEN; }
+    else if (x->os_tail[i] > 0) { x->os_tail[i] -= n_in; granular_os_bus(x, i, sampleframes); }
+    else { continue; }
+
+    hb_process(x->os_hb[i], x->os_bus[i], n_in, ((i > 1) ? granular_os_bus(x, i - 1, sampleframes) : out));
+    x->os_used[i] = false;
+  }
+}
+
+// ========  RENDER KERNELS  ========
+// Each kernel writes n samples of a grain to the output, with n no larger than the grain countdown.
+// The gain starts at mult and changes by mult_inc every sample, so that a fade out ramps smoothly.
+// KERNEL_DEFINE generates one kernel per combination of source interpolation, envelope mode, channel stride and glide.
+// Glisson kernels step the source with a phase whose increment itself changes by a constant every sample.
+// All configuration arguments are constants, so the compiler removes the tests and the loop has no runtime branches
+// on the configuration. A stride of 0 means that the stride is read from n_chn at runtime.
+
+#define KERNEL_DEFINE(NAME, INTERP, ENV_MODE, STRIDE, GLIDE)                                                        \
+static void NAME(t_grain* grain, t_double* out, t_int32 n, float* buff_src, float* env_values,                     \
+  t_int32 n_chn, t_int32 env_len, t_double mult, t_double mult_inc) {                                               \
+                                                                                                                    \
+  const t_int32  stride  = ((STRIDE) ? (STRIDE) : n_chn);                                                           \
+  const t_int32  src_len = grain->src_len - 1;                                                                      \
+  const t_int32  out_len = grain->out_len - 1;                                                                      \
+  const t_double inv_out_len = 1 / (t_double)out_len;                                                               \
+  const float*   src = buff_src + grain->src_begin * stride;                                                        \
+  const t_double phase_inc_inc = grain->phase_inc_inc;                                                              \
+                                                                                                                    \
+  t_int32  src_I = grain->src_I, src_R = grain->src_R;                                                              \
+  t_int32  env_I = grain->env_I, env_R = grain->env_R;                                                              \
+  t_double phase = grain->phase, phase_inc = grain->phase_inc;                                                      \
+  t_double smp, env;                                                                                                \
+                                                                                                                    \
+  while (n--) {                                                                                                     \
+                                                                                                                    \
+    if (GLIDE) { src_I = (t_int32)phase; }                                                                          \
+                                                                                                                    \
+    if (((INTERP) == INTERP_LINEAR) && (GLIDE)) {                                                                   \
+      smp = src[src_I * stride] + (phase - src_I) * (src[(src_I + 1) * stride] - src[src_I * stride]); }            \
+    else if ((INTERP) == INTERP_LINEAR) {                                                                           \
+      smp = src[src_I * stride] + src_R * inv_out_len * (src[(src_I + 1) * stride] - src[src_I * stride]); }       \
+    else { smp = src[src_I * stride]; }                                                                             \
+                                                                                                                    \
+    if ((ENV_MODE) == ENV_MODE_TABLE) {                                                                             \
+      env = env_values[env_I] + env_R * inv_out_len * (env_values[env_I + 1] - env_values[env_I]); }               \
+    else { env = 1; }                                                                                               \
+                                                                                                                    \
+    *out++ += mult * env * smp;                                                                                     \
+    mult   += mult_inc;                                                                                             \
+                                                                                                                    \
+    if (GLIDE) { phase += phase_inc; phase_inc += phase_inc_inc; }                                                  \
+    else {                                                                                                          \
+      src_R += src_len;                                                                                             \
+      while (src_R >= out_len) { src_R -= out_len; src_I++; } }                                                     \
+                                                                                                                    \
+    if ((ENV_MODE) == ENV_MODE_TABLE) {                                                                             \
+      env_R += env_len;                                                                                             \
+      while (env_R >= out_len) { env_R -= out_len; env_I++; } }                                                     \
+  }                                                                                                                 \
+                                                                                                                    \
+  if (GLIDE) { src_I = (t_int32)phase; grain->phase = phase; grain->phase_inc = phase_inc; }                        \
+                                                                                                                    \
+  grain->src_I = src_I; grain->src_R = src_R;                                                                       \
+  grain->env_I = env_I; grain->env_R = env_R;                                                                       \
+}
+
+KERNEL_DEFINE(kernel_none_flat_1,          INTERP_NONE,   ENV_MODE_FLAT,  1, false)
+KERNEL_DEFINE(kernel_none_flat_2,          INTERP_NONE,   ENV_MODE_FLAT,  2, false)
+KERNEL_DEFINE(kernel_none_flat_n,          INTERP_NONE,   ENV_MODE_FLAT,  0, false)
+KERNEL_DEFINE(kernel_none_table_1,         INTERP_NONE,   ENV_MODE_TABLE, 1, false)
+KERNEL_DEFINE(kernel_none_table_2,         INTERP_NONE,   ENV_MODE_TABLE, 2, false)
+KERNEL_DEFINE(kernel_none_table_n,         INTERP_NONE,   ENV_MODE_TABLE, 0, false)
+KERNEL_DEFINE(kernel_linear_flat_1,        INTERP_LINEAR, ENV_MODE_FLAT,  1, false)
+KERNEL_DEFINE(kernel_linear_flat_2,        INTERP_LINEAR, ENV_MODE_FLAT,  2, false)
+KERNEL_DEFINE(kernel_linear_flat_n,        INTERP_LINEAR, ENV_MODE_FLAT,  0, false)
+KERNEL_DEFINE(kernel_linear_table_1,       INTERP_LINEAR, ENV_MODE_TABLE, 1, false)
+KERNEL_DEFINE(kernel_linear_table_2,       INTERP_LINEAR, ENV_MODE_TABLE, 2, false)
+KERNEL_DEFINE(kernel_linear_table_n,       INTERP_LINEAR, ENV_MODE_TABLE, 0, false)
+
+KERNEL_DEFINE(kernel_glide_none_flat_1,    INTERP_NONE,   ENV_MODE_FLAT,  1, true)
+KERNEL_DEFINE(kernel_glide_none_flat_2,    INTERP_NONE,   ENV_MODE_FLAT,  2, true)
+KERNEL_DEFINE(kernel_glide_none_flat_n,    INTERP_NONE,   ENV_MODE_FLAT,  0, true)
+KERNEL_DEFINE(kernel_glide_none_table_1,   INTERP_NONE,   ENV_MODE_TABLE, 1, true)
+KERNEL_DEFINE(kernel_glide_none_table_2,   INTERP_NONE,   ENV_MODE_TABLE, 2, true)
+KERNEL_DEFINE(kernel_glide_none_table_n,   INTERP_NONE,   ENV_MODE_TABLE, 0, true)
+KERNEL_DEFINE(kernel_glide_linear_flat_1,  INTERP_LINEAR, ENV_MODE_FLAT,  1, true)
+KERNEL_DEFINE(kernel_glide_linear_flat_2,  INTERP_LINEAR, ENV_MODE_FLAT,  2, true)
+KERNEL_DEFINE(kernel_glide_linear_flat_n,  INTERP_LINEAR, ENV_MODE_FLAT,  0, true)
+KERNEL_DEFINE(kernel_glide_linear_table_1, INTERP_LINEAR, ENV_MODE_TABLE, 1, true)
+KERNEL_DEFINE(kernel_glide_linear_table_2, INTERP_LINEAR, ENV_MODE_TABLE, 2, true)
+KERNEL_DEFINE(kernel_glide_linear_table_n, INTERP_LINEAR, ENV_MODE_TABLE, 0, true)
+
+// ====  KERNEL TABLE  ====
+// Indexed by glide, interpolation, envelope mode and stride
+
+static const t_kernel kernel_table[2][INTERP_LAST][ENV_MODE_LAST][KERNEL_STRIDES] = {
+  { { { kernel_none_flat_1,   kernel_none_flat_2,   kernel_none_flat_n   },
+      { kernel_none_table_1,  kernel_none_table_2,  kernel_none_table_n  } },
+    { { kernel_linear_flat_1, kernel_linear_flat_2, kernel_linear_flat_n },
+      { kernel_linear_table_1, kernel_linear_table_2, kernel_linear_table_n } } },
+  { { { kernel_glide_none_flat_1,   kernel_glide_none_flat_2,   kernel_glide_none_flat_n   },
+      { kernel_glide_none_table_1,  kernel_glide_none_table_2,  kernel_glide_none_table_n  } },
+    { { kernel_glide_linear_flat_1, kernel_glide_linear_flat_2, kernel_glide_linear_flat_n },
+      { kernel_glide_linear_table_1, kernel_glide_linear_table_2, kernel_glide_linear_table_n } } }
+};
+
+// ====  PROCEDURE: KERNEL_SELECT  ====
+// Choose the render kernel for a grain, from the seeder configuration and the number of channels of the source
+// RETURNS: The specialized kernel, or the generic kernel if KERNEL_SPECIALIZED is false.
+//          Glisson grains always use a specialized kernel, the generic kernel has a constant rate.
+
+t_kernel kernel_select(t_interp_type interp, t_env_mode env_mode, t_int16 n_chn, t_bool glide) {
+
+  if (!KERNEL_SPECIALIZED && !glide) { return kernel_generic; }
+
+  return kernel_table[glide ? 1 : 0][interp][env_mode][(n_chn == 1) ? 0 : ((n_chn == 2) ? 1 : 2)];
+}
+
+// ========  OSCILLATOR KERNELS  ========
+// Each kernel writes n samples of an oscillator grain: the phase loops over the wavetable with a constant increment.
+// In pulsar mode each period holds one cycle of the table compressed by the duty cycle, followed by silence.
+
+#define KERNEL_OSC_DEFINE(NAME, ENV_MODE, PULSAR)                                                                   \
+static void NAME(t_grain* grain, t_double* out, t_int32 n, float* buff_src, float* env_values,                     \
+  t_int32 n_chn, t_int32 env_len, t_double mult, t_double mult_inc) {                                               \
+                                                                                                                    \
+  const t_int32  out_len = grain->out_len - 1;                                                                      \
+  const t_double inv_out_len = 1 / (t_double)out_len;                                                               \
+  const t_double phase_inc = grain->phase_inc;                                                                      \
+  const t_double duty_inv = grain->duty_inv;                                                                        \
+  const float*   table = buff_src;                                                                                  \
+                                                                                                                    \
+  t_int32  env_I = grain->env_I, env_R = grain->env_R;                                                              \
+  t_double phase = grain->phase, ind;                                                                               \
+  t_int32  I;                                                                                                       \
+  t_double smp, env;                                                                                                \
+                                                                                                                    \
+  while (n--) {                                                                                                     \
+                                                                                                                    \
+    ind = ((PULSAR) ? phase * duty_inv : phase);                                                                    \
+                                                                                                                    \
+    if (!(PULSAR) || (ind < WT_LEN)) {                                                                              \
+      I = (t_int32)ind;                                                                                             \
+      smp = table[I] + (ind - I) * (table[I + 1] - table[I]); }                                                     \
+    else { smp = 0; }                                                                                               \
+                                                                                                                    \
+    if ((ENV_MODE) == ENV_MODE_TABLE) {                                                                             \
+      env = env_values[env_I] + env_R * inv_out_len * (env_values[env_I + 1] - env_values[env_I]); }               \
+    else { env = 1; }                                                                                               \
+                                                                                                                    \
+    *out++ += mult * env * smp;                                                                                     \
+    mult   += mult_inc;                                                                                             \
+                                                                                                                    \
+    phase += phase_inc;                                                                                             \
+    if (phase >= WT_LEN) { phase -= WT_LEN; }                                                                       \
+                                                                                                                    \
+    if ((ENV_MODE) == ENV_MODE_TABLE) {                                                                             \
+      env_R += env_len;                                                                                             \
+      while (env_R >= out_len) { env_R -= out_len; env_I++; } }                                                     \
+  }                                                                                                                 \
+                                                                                                                    \
+  grain->phase = phase; grain->src_I = (t_int32)phase;                                                              \
+  grain->env_I = env_I; grain->env_R = env_R;                                                                       \
+}
+
+KERNEL_OSC_DEFINE(kernel_wavetable_flat,   ENV_MODE_FLAT,  false)
+KERNEL_OSC_DEFINE(kernel_wavetable_table,  ENV_MODE_TABLE, false)
+KERNEL_OSC_DEFINE(kernel_pulsar_flat,      ENV_MODE_FLAT,  true)
+KERNEL_OSC_DEFINE(kernel_pulsar_table,     ENV_MODE_TABLE, true)
+
+// ====  PROCEDURE: KERNEL_OSC_SELECT  ====
+// Choose the render kernel for an oscillator grain
+// RETURNS: The kernel for the source mode and envelope mode
+
+t_kernel kernel_osc_select(t_int8 src_mode, t_env_mode env_mode) {
+
+  if (src_mode == SRC_MODE_PULSAR) { return ((env_mode == ENV_MODE_TABLE) ? kernel_pulsar_table : kernel_pulsar_flat); }
+
+  return ((env_mode == ENV_MODE_TABLE) ? kernel_wavetable_table : kernel_wavetable_flat);
+}
+
+// ====  PROCEDURE: KERNEL_GENERIC  ====
+// Generic render loop, used as the reference for timing comparisons with the specialized kernels:
+// interpolated source and envelope, with the stride read at runtime
+
+void kernel_generic(t_grain* grain, t_double* out, t_int32 n, float* buff_src, float* env_values,
+  t_int32 n_chn, t_int32 env_len, t_double mult, t_double mult_inc) {
+
+  t_int32  ind;
+  t_int32  src_len = grain->src_len - 1;
+  t_int32  out_len = grain->out_len - 1;
+  t_double inv_out_len = 1 / (t_double)out_len;
+
+  while (n--) {
+
+    //== Calculate interpolated values from buffer and envelope
+    ind = (grain->src_begin + grain->src_I) * n_chn;
+    *out++ += mult
+      * (env_values[grain->env_I] + grain->env_R * inv_out_len * (env_values[grain->env_I + 1] - env_values[grain->env_I]))
+      * (buff_src[ind] + grain->src_R * inv_out_len * (buff_src[ind + n_chn] - buff_src[ind]));
+    mult += mult_inc;
+
+    //== Iterate integer and fractional values
+    grain->src_R += src_len;
+    while (grain->src_R >= out_len) { grain->src_R -= out_len; grain->src_I++; }
+
+    grain->env_R += env_len;
+    while (grain->env_R >= out_len) { grain->env_R -= out_len; grain->env_I++; }
+  }
+}
@@ -0,0 +1,80 @@
+#include "halfband.h"
+#include "envelopes.h"
+
+// ========  HALF-BAND DECIMATOR  ========
+
+// ====  CONSTRUCTOR: HB_NEW  ====
+// Initializes a decimator accepting up to n_in_max input samples per call.
+// The coefficients are a Blackman windowed sinc with its cutoff at a quarter of the input samplerate:
+//   h(c + k) = sin(PI * k / 2) / (PI * k) * w(c + k),  nonzero for odd k only
+// normalized so that the DC gain is 1.
+
+t_halfband* hb_new(t_int32 n_in_max) {
+
+  t_halfband* hb = (t_halfband*)sysmem_newptr(sizeof(t_halfband));
+  if (hb == NULL) { return NULL; }
+
+  hb->n_in_max = n_in_max;
+  hb->buff     = (t_double*)sysmem_newptr((HB_LEN - 1 + n_in_max) * sizeof(t_double));
+  if (hb->buff == NULL) { sysmem_freeptr(hb); return NULL; }
+
+  t_double sum = 0;
+  t_int32  k;
+
+  for (t_int32 j = 0; j < HB_N_COEF; j++) {
+    k = 2 * j + 1;
+    hb->coef[j] = ((j % 2) ? -1 : 1) / (PI * k) * env_blackman((t_double)(2 * HB_N_COEF - 1 + k) / (HB_LEN - 1), 0, 0);
+    sum += 2 * hb->coef[j];
+  }
+
+  for (t_int32 j = 0; j < HB_N_COEF; j++) { hb->coef[j] *= 0.5 / sum; }
+
+  hb_reset(hb);
+
+  return hb;
+}
+
+// ====  DESTRUCTOR: HB_FREE  ====
+
+void hb_free(t_halfband* hb) {
+
+  if (hb == NULL) { return; }
+
+  sysmem_freeptr(hb->buff);
+  sysmem_freeptr(hb);
+}
+
+// ====  PROCEDURE: HB_RESET  ====
+// Clear the history
+
+void hb_reset(t_halfband* hb) {
+
+  for (t_int32 i = 0; i < HB_LEN - 1; i++) { hb->buff[i] = 0; }
+}
+
+// ====  PROCEDURE: HB_PROCESS  ====
+// Decimate n_in samples (even, at most n_in_max) and ADD the n_in / 2 output samples to out
+
+void hb_process(t_halfband* hb, t_double* in, t_int32 n_in, t_double* out) {
+
+  t_double* hist = hb->buff + HB_LEN - 1;
+  t_double* ctr;
+  t_double  acc;
+
+  // Append the input block to the history
+  for (t_int32 i = 0; i < n_in; i++) { hist[i] = in[i]; }
+
+  // Each output uses the delay branch at the center, and the symmetric branch on both sides of it
+  for (t_int32 m = 0; m < n_in / 2; m++) {
+
+    ctr = hb->buff + 2 * m + 2 * HB_N_COEF;
+    acc = 0.5 * *ctr;
+
+    for (t_int32 j = 0; j < HB_N_COEF; j++) { acc += hb->coef[j] * (ctr[-(2 * j + 1)] + ctr[2 * j + 1]); }
+
+    *out++ += acc;
+  }
+
+  // Keep the last (HB_LEN - 1) samples as history for the next call
+  for (t_int32 i = 0; i < HB_LEN - 1; i++) { hb->buff[i] = hb->buff[n_in + i]; }
+}
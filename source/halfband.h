@@ -0,0 +1,38 @@
+#ifndef YC_HALFBAND_H_
+#define YC_HALFBAND_H_
+
+// ======== DESCRIPTION ======== //
+// Polyphase half-band FIR decimator, to bring an oversampled signal back to half its rate.
+// Half of the coefficients of a half-band filter are zero, apart from the center tap which is 0.5,
+// so each output sample costs one multiplication for the delay branch and HB_N_COEF for the symmetric branch.
+
+// ========  HEADER FILE FOR HALF-BAND DECIMATION  ========
+
+#include "ext.h"      // Header file for all objects, should always be first
+#include "z_dsp.h"    // Header file for MSP objects, included here for t_double type
+
+// ========  DEFINES  ========
+
+#define HB_N_COEF  8                    // Number of nonzero coefficients on each side of the center tap
+#define HB_LEN     (4 * HB_N_COEF - 1)  // Length of the filter
+
+// ====  STRUCTURE DECLARATION  ====
+
+typedef struct _halfband {
+
+  t_double  coef[HB_N_COEF];  // Coefficients of the symmetric branch, from the center outwards
+  t_int32   n_in_max;         // Maximum number of input samples per call
+  t_double* buff;             // History of (HB_LEN - 1) samples followed by the current input block
+
+} t_halfband;
+
+// ====  PROCEDURE DECLARATIONS  ====
+
+t_halfband* hb_new     (t_int32 n_in_max);
+void        hb_free    (t_halfband* hb);
+void        hb_reset   (t_halfband* hb);
+void        hb_process (t_halfband* hb, t_double* in, t_int32 n_in, t_double* out);
+
+// ========  END OF HEADER FILE  ========
+
+#endif
@@ -0,0 +1,156 @@
+#include "locked_mem.h"
+
+#ifdef WIN_VERSION
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef MAC_VERSION
+#include <mach/vm_statistics.h>
+#endif
+#endif
+
+// ========  DEFINES  ========
+
+#define MEM_PAGE_MIN   4096                 // Smallest page size, used as the stride for touching pages
+#define MEM_HUGE_SIZE  (2 * 1024 * 1024)    // Huge page size used on Linux and macOS
+
+// ====  PROCEDURE: MEM_ROUND  ====
+// Round a size up to a multiple of the page size
+
+static size_t mem_round(size_t size, size_t page) {
+
+  return ((size + page - 1) / page) * page;
+}
+
+// ====  PROCEDURE: MEM_INIT  ====
+// Initialize a block descriptor to an empty block
+
+void mem_init(t_mem_block* block) {
+
+  block->ptr      = NULL;
+  block->size     = 0;
+  block->size_map = 0;
+  block->flags    = MEM_NONE;
+}
+
+// ====  PROCEDURE: MEM_ALLOC  ====
+// Allocate a block of memory, trying huge pages first if requested, then regular pages,
+// and lock it in physical memory if requested. Each step falls back gracefully.
+// RETURNS: The flags describing what succeeded, MEM_NONE if the allocation failed
+
+t_uint8 mem_alloc(t_mem_block* block, size_t size, t_bool huge, t_bool lock) {
+
+  mem_init(block);
+  if (size == 0) { return MEM_NONE; }
+
+  block->size = size;
+
+#ifdef WIN_VERSION
+
+  // Large pages require the "Lock pages in memory" privilege and are always non pageable
+  SIZE_T large = GetLargePageMinimum();
+
+  if (huge && large) {
+    block->size_map = mem_round(size, large);
+    block->ptr = VirtualAlloc(NULL, block->size_map, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (block->ptr) {
+      block->flags = MEM_ALLOCATED | MEM_HUGE_PAGES | MEM_LOCKED;
+      return block->flags;
+    }
+  }
+
+  // Otherwise fall back on regular pages
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+
+  block->size_map = mem_round(size, info.dwPageSize);
+  block->ptr = VirtualAlloc(NULL, block->size_map, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+  if (block->ptr == NULL) { mem_init(block); return MEM_NONE; }
+
+  block->flags = MEM_ALLOCATED;
+
+  if (lock) {
+
+    // The default working set is small: if locking fails, grow it by the size of the block and try again
+    if (VirtualLock(block->ptr, block->size_map)) { block->flags |= MEM_LOCKED; }
+    else {
+      SIZE_T ws_min, ws_max;
+      HANDLE process = GetCurrentProcess();
+      if (GetProcessWorkingSetSize(process, &ws_min, &ws_max)
+        && SetProcessWorkingSetSize(process, ws_min + block->size_map, ws_max + block->size_map)
+        && VirtualLock(block->ptr, block->size_map)) {
+        block->flags |= MEM_LOCKED;
+      }
+    }
+  }
+
+#else
+
+  block->ptr = MAP_FAILED;
+
+  // Explicit huge pages: only available when the system has reserved some
+  if (huge) {
+    block->size_map = mem_round(size, MEM_HUGE_SIZE);
+#if defined(MAP_HUGETLB)
+    block->ptr = mmap(NULL, block->size_map, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_HUGETLB, -1, 0);
+#elif defined(VM_FLAGS_SUPERPAGE_SIZE_2MB)
+    block->ptr = mmap(NULL, block->size_map, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, VM_FLAGS_SUPERPAGE_SIZE_2MB, 0);
+#endif
+    if (block->ptr != MAP_FAILED) { block->flags = MEM_ALLOCATED | MEM_HUGE_PAGES; }
+  }
+
+  // Otherwise fall back on regular pages
+  if (block->ptr == MAP_FAILED) {
+    block->size_map = mem_round(size, (size_t)sysconf(_SC_PAGESIZE));
+    block->ptr = mmap(NULL, block->size_map, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (block->ptr == MAP_FAILED) { mem_init(block); return MEM_NONE; }
+
+    block->flags = MEM_ALLOCATED;
+
+    // Ask for transparent huge pages, which is only a hint and is not reported
+#if defined(MADV_HUGEPAGE)
+    if (huge) { madvise(block->ptr, block->size_map, MADV_HUGEPAGE); }
+#endif
+  }
+
+  if (lock && (mlock(block->ptr, block->size_map) == 0)) { block->flags |= MEM_LOCKED; }
+
+#endif
+
+  return block->flags;
+}
+
+// ====  PROCEDURE: MEM_FREE  ====
+// Unlock and release a block allocated with mem_alloc. Does nothing on an empty block.
+
+void mem_free(t_mem_block* block) {
+
+  if (!(block->flags & MEM_ALLOCATED)) { return; }
+
+#ifdef WIN_VERSION
+  if ((block->flags & MEM_LOCKED) && !(block->flags & MEM_HUGE_PAGES)) { VirtualUnlock(block->ptr, block->size_map); }
+  VirtualFree(block->ptr, 0, MEM_RELEASE);
+#else
+  if (block->flags & MEM_LOCKED) { munlock(block->ptr, block->size_map); }
+  munmap(block->ptr, block->size_map);
+#endif
+
+  mem_init(block);
+}
+
+// ====  PROCEDURE: MEM_PRETOUCH  ====
+// Read one byte in every page of the block, so that all pages are mapped before the audio thread uses them
+
+void mem_pretouch(t_mem_block* block) {
+
+  if (!(block->flags & MEM_ALLOCATED)) { return; }
+
+  // The reads are volatile, so they are kept even though the values are not used
+  volatile char* ptr = (volatile char*)block->ptr;
+
+  for (size_t i = 0; i < block->size; i += MEM_PAGE_MIN) { (void)ptr[i]; }
+  (void)ptr[block->size - 1];
+
+  block->flags |= MEM_TOUCHED;
+}
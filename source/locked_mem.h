@@ -0,0 +1,41 @@
+#ifndef YC_LOCKED_MEM_H_
+#define YC_LOCKED_MEM_H_
+
+// ======== DESCRIPTION ======== //
+// Allocation of memory blocks that stay resident in physical memory:
+// backed by huge / large pages where available, and locked in RAM,
+// so that the audio thread never takes a page fault when reading them.
+
+// ========  HEADER FILE FOR LOCKED MEMORY ALLOCATION  ========
+
+#include "ext.h"      // Header file for all objects, should always be first
+
+// ========  DEFINES  ========
+
+#define MEM_NONE        0x00
+#define MEM_ALLOCATED   0x01    // The block is allocated
+#define MEM_HUGE_PAGES  0x02    // The block is backed by huge / large pages
+#define MEM_LOCKED      0x04    // The block is locked in physical memory
+#define MEM_TOUCHED     0x08    // All the pages of the block have been touched
+
+// ====  STRUCTURE DECLARATION  ====
+
+typedef struct _mem_block {
+
+  void*    ptr;       // Beginning of the usable memory
+  size_t   size;      // Size requested in bytes
+  size_t   size_map;  // Size actually mapped in bytes, rounded up to the page size
+  t_uint8  flags;     // What succeeded: combination of the MEM_* flags
+
+} t_mem_block;
+
+// ====  PROCEDURE DECLARATIONS  ====
+
+void     mem_init     (t_mem_block* block);
+t_uint8  mem_alloc    (t_mem_block* block, size_t size, t_bool huge, t_bool lock);
+void     mem_free     (t_mem_block* block);
+void     mem_pretouch (t_mem_block* block);
+
+// ========  END OF HEADER FILE  ========
+
+#endif
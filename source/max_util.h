@@ -27,6 +27,68 @@
 #define MY_ASSERT_ERR(test, err, ...) if (test) { object_post((t_object*)x, "ERROR:  " __VA_ARGS__); return err; }
 #define MY_ASSERT_RETURN(test, ret, ...) if (test) { object_post((t_object*)x, "ERROR:  " __VA_ARGS__); return ret; }
 
+// ====  CACHE PREFETCHING  ====
+// Hint to bring the cache line containing addr into all cache levels, for reading
+
+#define CACHE_LINE 64
+
+#ifdef WIN_VERSION
+#include <xmmintrin.h>
+#define PREFETCH(addr) _mm_prefetch((const char*)(addr), _MM_HINT_T0)
+#else
+#define PREFETCH(addr) __builtin_prefetch((const void*)(addr), 0, 3)
+#endif
+
+// ====  MEMORY BARRIER  ====
+// Full barrier, so that data written before it is visible to other threads before anything written after it
+
+#ifdef WIN_VERSION
+#include <emmintrin.h>
+#define MEMORY_BARRIER() _mm_mfence()
+#else
+#define MEMORY_BARRIER() __sync_synchronize()
+#endif
+
+// ====  POINTER HANDOFF  ====
+// Publish a pointer for another thread once the data it points to is written, and read it on the other side.
+// Release and acquire atomics with GCC and Clang, which ThreadSanitizer checks. A full barrier with MSVC.
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PTR_PUBLISH(dst, src) __atomic_store_n(&(dst), (src), __ATOMIC_RELEASE)
+#define PTR_ACQUIRE(src) __atomic_load_n(&(src), __ATOMIC_ACQUIRE)
+#else
+#define PTR_PUBLISH(dst, src) do { MEMORY_BARRIER(); (dst) = (src); } while (0)
+#define PTR_ACQUIRE(src) (src)
+#endif
+
+// ====  SHARED FLAGS AND COUNTERS  ====
+// Plain reads and writes of a flag or counter that the other thread changes, including with the ATOMIC_ operations.
+// Same orderings as the pointer handoff, so that ThreadSanitizer sees them.
+
+#if defined(__GNUC__) || defined(__clang__)
+#define ATOMIC_LOAD(src) __atomic_load_n(&(src), __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE(dst, val) __atomic_store_n(&(dst), (val), __ATOMIC_RELEASE)
+#else
+#define ATOMIC_LOAD(src) (src)
+#define ATOMIC_STORE(dst, val) do { MEMORY_BARRIER(); (dst) = (val); } while (0)
+#endif
+
+// ====  CYCLE COUNTER  ====
+// Cheap monotonic tick counter for profiling: CPU cycles on x86, the virtual counter on ARM64, 0 elsewhere
+
+#ifdef WIN_VERSION
+#include <intrin.h>
+#define CYCLE_COUNT() ((t_uint64)__rdtsc())
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLE_COUNT() ((t_uint64)__rdtsc())
+#elif defined(__aarch64__)
+static inline t_uint64 cycle_count_arm64(void) { t_uint64 t; __asm__ volatile("mrs %0, cntvct_el0" : "=r" (t)); return t; }
+#define CYCLE_COUNT() cycle_count_arm64()
+#else
+#define CYCLE_COUNT() ((t_uint64)0)
+#endif
+
 // ====  ENUM  ====
 
 typedef enum _my_err {
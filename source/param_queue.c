@@ -0,0 +1,89 @@
+#include "param_queue.h"
+#include "max_util.h"
+
+// ========  PARAMETER QUEUE  ========
+
+// ====  CONSTRUCTOR: PQ_NEW  ====
+// Initializes a queue which can hold up to len changes. len has to be a power of 2.
+// Slot i initially has sequence number i: free to write for position i.
+
+t_param_queue* pq_new(t_int32 len) {
+
+  t_param_queue* queue = (t_param_queue*)sysmem_newptr(sizeof(t_param_queue));
+  if (queue == NULL) { return NULL; }
+
+  queue->len   = len;
+  queue->head  = 0;
+  queue->tail  = 0;
+  queue->items = (t_param_item*)sysmem_newptr(len * sizeof(t_param_item));
+  if (queue->items == NULL) { sysmem_freeptr(queue); return NULL; }
+
+  for (t_int32 i = 0; i < len; i++) { queue->items[i].seq = i; }
+
+  return queue;
+}
+
+// ====  DESTRUCTOR: PQ_FREE  ====
+
+void pq_free(t_param_queue* queue) {
+
+  if (queue == NULL) { return; }
+
+  sysmem_freeptr(queue->items);
+  sysmem_freeptr(queue);
+}
+
+// ====  PROCEDURE: PQ_PUSH  ====
+// Add a change at the end of the queue. Lock-free, safe from any number of threads.
+// RETURNS: true if the change was added, false if the queue is full
+
+t_bool pq_push(t_param_queue* queue, t_int16 index, t_int16 param, t_double value) {
+
+  t_param_item* item;
+  t_int32       pos, seq;
+
+  // Reserve a position: the slot is free when its sequence number equals the position
+  while (true) {
+
+    pos  = ATOMIC_LOAD(queue->head);
+    item = queue->items + (pos & (queue->len - 1));
+    seq  = ATOMIC_LOAD(item->seq);
+
+    if (seq == pos) {
+      if (ATOMIC_COMPARE_SWAP32(pos, pos + 1, &queue->head)) { break; }
+    }
+    else if (seq - pos < 0) { return false; }
+  }
+
+  item->index = index;
+  item->param = param;
+  item->value = value;
+
+  // Publish the slot to the consumer, with a full barrier
+  ATOMIC_COMPARE_SWAP32(pos, pos + 1, &item->seq);
+
+  return true;
+}
+
+// ====  PROCEDURE: PQ_POP  ====
+// Take the change at the beginning of the queue. Only called by the audio thread. Does not block.
+// RETURNS: true if a change was taken, false if the queue is empty
+
+t_bool pq_pop(t_param_queue* queue, t_param_item* item) {
+
+  t_param_item* slot = queue->items + (queue->tail & (queue->len - 1));
+
+  // The slot is ready when its sequence number is one past the position.
+  // Compare and swap with the same value acts as a read with a full barrier.
+  if (!ATOMIC_COMPARE_SWAP32(queue->tail + 1, queue->tail + 1, &slot->seq)) { return false; }
+
+  item->index = slot->index;
+  item->param = slot->param;
+  item->value = slot->value;
+
+  // Free the slot for the position one lap later
+  ATOMIC_COMPARE_SWAP32(queue->tail + 1, queue->tail + queue->len, &slot->seq);
+  queue->tail++;
+
+  return true;
+}
@@ -0,0 +1,44 @@
+#ifndef YC_PARAM_QUEUE_H_
+#define YC_PARAM_QUEUE_H_
+
+// ======== DESCRIPTION ======== //
+// Bounded lock-free queue of parameter changes, from the message threads to the audio thread.
+// Any number of threads can push, only the audio thread pops.
+// Each slot holds a sequence number which tells whether it is free to write or ready to read.
+
+// ========  HEADER FILE FOR THE PARAMETER QUEUE  ========
+
+#include "ext.h"          // Header file for all objects, should always be first
+#include "ext_atomic.h"   // Atomic operations
+#include "z_dsp.h"        // Header file for MSP objects, included here for t_double type
+
+// ====  STRUCTURE DECLARATIONS  ====
+
+typedef struct _param_item {
+
+  t_int32_atomic  seq;      // Sequence number of the slot
+  t_int16         index;    // Index of the seeder
+  t_int16         param;    // Parameter to change
+  t_double        value;    // New value
+
+} t_param_item;
+
+typedef struct _param_queue {
+
+  t_int32         len;      // Number of slots, a power of 2
+  t_int32_atomic  head;     // Next position to write, shared by the producers
+  t_int32         tail;     // Next position to read, only used by the consumer
+  t_param_item*   items;    // Array of slots
+
+} t_param_queue;
+
+// ====  PROCEDURE DECLARATIONS  ====
+
+t_param_queue*  pq_new    (t_int32 len);
+void            pq_free   (t_param_queue* queue);
+t_bool          pq_push   (t_param_queue* queue, t_int16 index, t_int16 param, t_double value);
+t_bool          pq_pop    (t_param_queue* queue, t_param_item* item);
+
+// ========  END OF HEADER FILE  ========
+
+#endif
@@ -0,0 +1,120 @@
+#include "timeline.h"
+#include "max_util.h"
+
+#include <stdio.h>
+
+// ========  TIMELINE  ========
+
+static const char* tl_span_names[TL_SPAN_LAST] = {
+  "perform", "param drain", "seeders", "grains", "buffer lock", "ring write",
+  "memory copy", "prefix sums", "loop copy", "offline render" };
+
+static const char* tl_thread_names[TL_N_THREAD] = { "audio", "main" };
+
+// ====  CONSTRUCTOR: TL_NEW  ====
+// Allocates the rings. The timeline records nothing until tl_start is called.
+
+t_timeline* tl_new(void) {
+
+  t_timeline* tl = (t_timeline*)sysmem_newptrclear(sizeof(t_timeline));
+  if (tl == NULL) { return NULL; }
+
+  for (t_int16 th = 0; th < TL_N_THREAD; th++) {
+    tl->rings[th].events = (t_tl_event*)sysmem_newptrclear(TL_LEN * sizeof(t_tl_event));
+    if (tl->rings[th].events == NULL) { tl_free(tl); return NULL; }
+  }
+
+  return tl;
+}
+
+// ====  DESTRUCTOR: TL_FREE  ====
+
+void tl_free(t_timeline* tl) {
+
+  if (tl == NULL) { return; }
+
+  for (t_int16 th = 0; th < TL_N_THREAD; th++) {
+    if (tl->rings[th].events != NULL) { sysmem_freeptr(tl->rings[th].events); }
+  }
+
+  sysmem_freeptr(tl);
+}
+
+// ====  PROCEDURE: TL_START  ====
+// Empties the rings and sets the calibration origin. Not to be called while spans are recorded.
+
+void tl_start(t_timeline* tl, t_double ms_now) {
+
+  for (t_int16 th = 0; th < TL_N_THREAD; th++) { tl->rings[th].cnt = 0; }
+
+  tl->ms0   = ms_now;
+  tl->tick0 = CYCLE_COUNT();
+}
+
+// ====  PROCEDURE: TL_RECORD  ====
+// Records a span in the ring of a thread. Lock-free, safe from any number of threads.
+
+void tl_record(t_timeline* tl, t_tl_thread thread, t_tl_span span, t_int16 arg, t_uint64 begin, t_uint64 end) {
+
+  t_tl_ring*  ring  = tl->rings + thread;
+  t_tl_event* event = ring->events + ((t_uint32)(ATOMIC_INCREMENT(&ring->cnt) - 1) & (TL_LEN - 1));
+
+  event->begin = begin;
+  event->dur   = (t_uint32)(((end - begin) < 0xFFFFFFFF) ? (end - begin) : 0xFFFFFFFF);
+  event->span  = (t_int16)span;
+  event->arg   = arg;
+}
+
+// ====  PROCEDURE: TL_DUMP  ====
+// Writes the recorded spans as a Chrome trace JSON file, one track per thread, oldest first.
+// Spans are not locked while they are read: the oldest eighth of a full ring is skipped, since writers
+// may be overwriting it during the dump, and spans older than the calibration origin are dropped.
+// RETURNS: The number of spans written, -1 if the file could not be written, -2 if the tick counter does not run
+
+t_int32 tl_dump(t_timeline* tl, const char* path, t_double ms_now) {
+
+  t_uint64 ticks = CYCLE_COUNT() - tl->tick0;
+  t_double ms    = ms_now - tl->ms0;
+
+  if ((ticks == 0) || (ms <= 0)) { return -2; }
+
+  t_double us_per_tick = 1000 * ms / (t_double)ticks;
+
+  FILE* file = fopen(path, "w");
+  if (file == NULL) { return -1; }
+
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+  for (t_int16 th = 0; th < TL_N_THREAD; th++) {
+    fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%i,\"args\":{\"name\":\"%s\"}}",
+      (th ? ",\n" : ""), th, tl_thread_names[th]);
+  }
+
+  t_int32 written = 0;
+
+  for (t_int16 th = 0; th < TL_N_THREAD; th++) {
+
+    t_tl_ring*  ring = tl->rings + th;
+    t_uint32    cnt  = (t_uint32)ring->cnt;
+    t_uint32    first = ((cnt > TL_LEN) ? cnt - TL_LEN + TL_LEN / 8 : 0);
+    t_tl_event  event;
+
+    for (t_uint32 i = first; i < cnt; i++) {
+
+      event = ring->events[i & (TL_LEN - 1)];
+      if ((event.begin < tl->tick0) || (event.span < 0) || (event.span >= TL_SPAN_LAST)) { continue; }
+
+      fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%i,\"ts\":%.3f,\"dur\":%.3f",
+        tl_span_names[event.span], th, (event.begin - tl->tick0) * us_per_tick, event.dur * us_per_tick);
+
+      if (event.arg >= 0) { fprintf(file, ",\"args\":{\"seeder\":%i}", event.arg); }
+      fprintf(file, "}");
+      written++;
+    }
+  }
+
+  fprintf(file, "\n]}\n");
+
+  if (fclose(file) != 0) { return -1; }
+  return written;
+}
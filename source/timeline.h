@@ -0,0 +1,83 @@
+#ifndef YC_TIMELINE_H_
+#define YC_TIMELINE_H_
+
+// ======== DESCRIPTION ======== //
+// Timeline of engine activity for diagnosing dropouts: timestamped spans recorded into one ring per thread,
+// and dumped as Chrome trace JSON (chrome://tracing, Perfetto). Recording is lock-free: a writer claims a slot
+// with an atomic increment, and the oldest spans are overwritten once a ring is full.
+// Timestamps are ticks of CYCLE_COUNT, converted to microseconds with a calibration against a ms clock
+// given by the caller, so the module does not depend on the Max scheduler.
+
+// ========  HEADER FILE FOR THE TIMELINE  ========
+
+#include "ext.h"          // Header file for all objects, should always be first
+#include "ext_atomic.h"   // Atomic operations
+#include "z_dsp.h"        // Header file for MSP objects, included here for t_double type
+
+// ========  DEFINES  ========
+
+#define TL_LEN      65536   // Number of spans in each ring, a power of 2
+
+// ====  THREADS AND SPANS  ====
+
+typedef enum _tl_thread {
+
+  TL_AUDIO,       // Perform routine, and offline render
+  TL_MAIN,        // Message threads
+  TL_N_THREAD
+
+} t_tl_thread;
+
+typedef enum _tl_span {
+
+  TL_PERFORM,     // Whole perform call
+  TL_DRAIN,       // Parameter queue drain
+  TL_SEEDERS,     // Seeder scheduling of a sub-block
+  TL_GRAINS,      // Grain rendering of a sub-block
+  TL_LOCK,        // Wait to lock a source buffer, arg is the seeder index
+  TL_RING,        // Record ring write
+  TL_MEMORY,      // Copy of a source into engine owned memory, arg is the seeder index
+  TL_PSUM,        // Prefix sums for the loudness normalization, arg is the seeder index
+  TL_LOOP,        // Loop copy update, arg is the seeder index
+  TL_RENDER,      // Offline render
+  TL_SPAN_LAST
+
+} t_tl_span;
+
+// ====  STRUCTURE DECLARATIONS  ====
+
+typedef struct _tl_event {
+
+  t_uint64  begin;    // Ticks at the beginning of the span
+  t_uint32  dur;      // Duration in ticks
+  t_int16   span;     // t_tl_span
+  t_int16   arg;      // Span argument, -1 for none
+
+} t_tl_event;
+
+typedef struct _tl_ring {
+
+  t_int32_atomic  cnt;      // Number of spans claimed since the start
+  t_tl_event*     events;   // Array of TL_LEN spans
+
+} t_tl_ring;
+
+typedef struct _timeline {
+
+  t_tl_ring   rings[TL_N_THREAD];   // One ring per thread
+  t_uint64    tick0;                // Ticks at the start
+  t_double    ms0;                  // Time in ms at the start
+
+} t_timeline;
+
+// ====  PROCEDURE DECLARATIONS  ====
+
+t_timeline* tl_new    (void);
+void        tl_free   (t_timeline* tl);
+void        tl_start  (t_timeline* tl, t_double ms_now);
+void        tl_record (t_timeline* tl, t_tl_thread thread, t_tl_span span, t_int16 arg, t_uint64 begin, t_uint64 end);
+t_int32     tl_dump   (t_timeline* tl, const char* path, t_double ms_now);
+
+// ========  END OF HEADER FILE  ========
+
+#endif
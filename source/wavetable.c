@@ -0,0 +1,85 @@
+#include "wavetable.h"
+
+// ========  WAVETABLES  ========
+
+static float  wt_tables[WAVE_LAST][WT_N_OCT][WT_LEN + 1];
+static t_bool wt_is_init = false;
+
+// ====  PROCEDURE: WT_INIT  ====
+// Builds all the tables by additive synthesis, each one normalized to a peak of 1. Called once from main.
+// The harmonics are summed once per sample, and the partial sum is stored in each table whose limit is reached.
+
+void wt_init(void) {
+
+  if (wt_is_init) { return; }
+
+  t_double phase, smp, peak;
+  t_int16  oct;
+
+  for (t_int16 wave = 0; wave < WAVE_LAST; wave++) {
+
+    for (t_int32 i = 0; i < WT_LEN; i++) {
+
+      phase = 2 * PI * i / WT_LEN;
+      smp   = 0;
+      oct   = WT_N_OCT - 1;
+
+      for (t_int32 k = 1; k <= WT_N_HARM; k++) {
+
+        switch (wave) {
+
+        case WAVE_SINE:
+          if (k == 1) { smp = sin(phase); }
+          break;
+
+        case WAVE_TRIANGLE:
+          if (k % 2) { smp += (((k / 2) % 2) ? -1 : 1) * sin(k * phase) / (k * k); }
+          break;
+
+        case WAVE_SAW:
+          smp += sin(k * phase) / k;
+          break;
+
+        case WAVE_SQUARE:
+          if (k % 2) { smp += sin(k * phase) / k; }
+          break;
+
+        case WAVE_PULSE:
+          smp += cos(k * phase);
+          break;
+
+        default:
+          break;
+        }
+
+        // Table oct holds the harmonics up to WT_N_HARM >> oct
+        if (k == (WT_N_HARM >> oct)) { wt_tables[wave][oct--][i] = (float)smp; }
+      }
+    }
+
+    for (oct = 0; oct < WT_N_OCT; oct++) {
+
+      peak = 0;
+      for (t_int32 i = 0; i < WT_LEN; i++) { if (fabs(wt_tables[wave][oct][i]) > peak) { peak = fabs(wt_tables[wave][oct][i]); } }
+      for (t_int32 i = 0; i < WT_LEN; i++) { wt_tables[wave][oct][i] = (float)(wt_tables[wave][oct][i] / peak); }
+
+      wt_tables[wave][oct][WT_LEN] = wt_tables[wave][oct][0];
+    }
+  }
+
+  wt_is_init = true;
+}
+
+// ====  PROCEDURE: WT_GET  ====
+// Chooses the table of a waveform with the most harmonics that stay below harm_max, the ratio of the Nyquist
+// frequency to the fundamental. Below one harmonic the table with a single one is used.
+// RETURNS: The table, WT_LEN + 1 samples
+
+float* wt_get(t_wave_type wave, t_double harm_max) {
+
+  t_int16 oct = 0;
+
+  while ((oct < WT_N_OCT - 1) && ((WT_N_HARM >> oct) > harm_max)) { oct++; }
+
+  return wt_tables[wave][oct];
+}
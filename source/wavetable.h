@@ -0,0 +1,40 @@
+#ifndef YC_WAVETABLE_H_
+#define YC_WAVETABLE_H_
+
+// ======== DESCRIPTION ======== //
+// Single-cycle wavetables for oscillator grain sources. Each waveform has one table per octave of the fundamental,
+// band-limited so that its harmonics stay below the Nyquist frequency, and each table is small enough to stay
+// in the L1 cache. The tables are shared by all instances and built once.
+
+// ========  HEADER FILE FOR WAVETABLES  ========
+
+#include "ext.h"      // Header file for all objects, should always be first
+#include "z_dsp.h"    // Header file for MSP objects, included here for t_double type
+
+// ========  DEFINES  ========
+
+#define WT_LEN      512   // Number of samples in one cycle, a guard sample repeating the first one follows
+#define WT_N_OCT    8     // Number of band-limited tables per waveform, one per octave
+#define WT_N_HARM   128   // Number of harmonics of the first table, halved at each octave up to a single one
+
+// ====  WAVEFORMS  ====
+
+typedef enum _wave_type {
+
+  WAVE_SINE,
+  WAVE_TRIANGLE,
+  WAVE_SAW,
+  WAVE_SQUARE,
+  WAVE_PULSE,       // Band-limited impulse, for trainlets
+  WAVE_LAST
+
+} t_wave_type;
+
+// ====  PROCEDURE DECLARATIONS  ====
+
+void    wt_init (void);
+float*  wt_get  (t_wave_type wave, t_double harm_max);
+
+// ========  END OF HEADER FILE  ========
+
+#endif